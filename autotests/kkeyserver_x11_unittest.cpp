@@ -18,10 +18,15 @@
     Boston, MA 02110-1301, USA.
 */
 
+#include <QAbstractEventDispatcher>
+#include <QMetaEnum>
 #include <QTest>
+#include <QThread>
+#include <QVector>
 #include "kkeyserver_x11.h"
 #include <X11/keysym.h>
 #include <xcb/xcb_keysyms.h>
+#include <string.h>
 #include <QX11Info>
 
 class KKeyServerTest : public QObject
@@ -131,6 +136,70 @@ private Q_SLOTS:
         QCOMPARE(decodedKeyQt, keyQt);
     }
 
+    void translateFromThreads()
+    {
+        // Translation has to work from other threads while the keymap gets replaced
+        int expectedKeyQt;
+        QVERIFY(KKeyServer::symXModXToKeyQt(XK_F1, KKeyServer::modXAlt(), &expectedKeyQt));
+        QAtomicInt failures;
+        QAtomicInt stop;
+        QVector<QThread *> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads << QThread::create([&]() {
+                while (!stop.loadAcquire()) {
+                    int keyQt;
+                    uint modX;
+                    if (!KKeyServer::symXModXToKeyQt(XK_F1, KKeyServer::modXAlt(), &keyQt) || keyQt != expectedKeyQt
+                            || !KKeyServer::keyQtToModX(Qt::AltModifier, &modX) || modX != KKeyServer::modXAlt()) {
+                        failures.ref();
+                    }
+                }
+            });
+            threads.last()->start();
+        }
+        // Pretend the server changed the modifier mapping, so that the keymap
+        // gets rebuilt and replaced while the threads use it
+        xcb_mapping_notify_event_t mapping;
+        memset(&mapping, 0, sizeof(mapping));
+        mapping.response_type = XCB_MAPPING_NOTIFY;
+        mapping.request = XCB_MAPPING_MODIFIER;
+        QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+        QVERIFY(dispatcher);
+        for (int i = 0; i < 200; ++i) {
+            long result = 0;
+            dispatcher->filterNativeEvent(QByteArrayLiteral("xcb_generic_event_t"), &mapping, &result);
+            QVERIFY(KKeyServer::initializeMods());
+            if (i % 20 == 0) {
+                QThread::msleep(1);
+            }
+        }
+        stop.storeRelease(1);
+        for (QThread *thread : qAsConst(threads)) {
+            QVERIFY(thread->wait());
+        }
+        qDeleteAll(threads);
+        QCOMPARE(failures.loadAcquire(), 0);
+    }
+
+    void benchmarkTranslateAllKeys()
+    {
+        const QMetaEnum keys = QMetaEnum::fromType<Qt::Key>();
+        QVector<int> keysQt;
+        for (int i = 0; i < keys.keyCount(); ++i) {
+            keysQt << keys.value(i) << (keys.value(i) | Qt::KeypadModifier);
+        }
+
+        QBENCHMARK {
+            for (int keyQt : qAsConst(keysQt)) {
+                int sym;
+                if (KKeyServer::keyQtToSymX(keyQt, &sym)) {
+                    int translated;
+                    KKeyServer::symXModXToKeyQt(sym, 0, &translated);
+                }
+            }
+        }
+    }
+
 private:
     xcb_key_symbols_t *m_keySymbols;
 
@@ -29,6 +29,39 @@
 
 using namespace QTest;
 
+static xcb_atom_t internAtom(xcb_connection_t *c, const char *name)
+{
+    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> reply(
+        xcb_intern_atom_reply(c, xcb_intern_atom(c, false, strlen(name), name), nullptr));
+    return reply ? reply->atom : XCB_ATOM_NONE;
+}
+
+// Serves a large blob for a single target through replyData()
+class LargeReplyOwner : public KSelectionOwner
+{
+public:
+    LargeReplyOwner(const char *selection, xcb_atom_t target, const QByteArray &data)
+        : KSelectionOwner(selection)
+        , m_target(target)
+        , m_data(data)
+    {
+    }
+
+protected:
+    bool genericReply(xcb_atom_t target, xcb_atom_t property, xcb_window_t requestor) override
+    {
+        if (target != m_target) {
+            return false;
+        }
+        replyData(property, requestor, XCB_ATOM_STRING, 8, m_data);
+        return true;
+    }
+
+private:
+    xcb_atom_t m_target;
+    QByteArray m_data;
+};
+
 void KManagerSelectionTest::xSync()
 {
     xcb_connection_t *c = QX11Info::connection();
@@ -116,6 +149,8 @@ void KManagerSelectionTest::testWatching()
         QVERIFY(newOwnerSpy.wait());
     }
     QCOMPARE(newOwnerSpy.count(), 1);
+    QCOMPARE(newOwnerSpy.first().first().value<xcb_window_t>(), owner1.ownerWindow());
+    QCOMPARE(watcher.owner(), owner1.ownerWindow());
     QVERIFY(sw.newowner == true);
     QVERIFY(sw.lostowner == false);
     sw.newowner = sw.lostowner = false;
@@ -134,6 +169,7 @@ void KManagerSelectionTest::testWatching()
     owner2.release();
     xSync();
     QVERIFY(lostOwnerSpy.wait());
+    QCOMPARE(watcher.owner(), xcb_window_t(XCB_WINDOW_NONE));
     QVERIFY(sw.newowner == false);
     QVERIFY(sw.lostowner == true);
     sw.newowner = sw.lostowner = false;
@@ -143,6 +179,120 @@ void KManagerSelectionTest::testWatching()
     QVERIFY(sw.lostowner == false);
 }
 
+void KManagerSelectionTest::testIncrementalReply()
+{
+    // test that replies larger than the chunk size are sent using INCR
+    xcb_connection_t *c = QX11Info::connection();
+    const xcb_atom_t target = internAtom(c, "_KDE_KMANAGERSELECTIONTEST_DATA");
+    QByteArray data(100000, Qt::Uninitialized);
+    for (int i = 0; i < data.size(); ++i) {
+        data[i] = char(i % 251);
+    }
+    LargeReplyOwner owner(SNAME, target, data);
+    owner.setIncrementalChunkSize(4096);
+    QCOMPARE(owner.incrementalChunkSize(), 4096u);
+    claim(&owner);
+
+    // the requestor uses its own connection, so that its events don't end up in Qt
+    xcb_connection_t *requestorConnection = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(requestorConnection));
+    const xcb_atom_t selection = internAtom(requestorConnection, SNAME);
+    const xcb_atom_t property = internAtom(requestorConnection, "_KDE_KMANAGERSELECTIONTEST_PROPERTY");
+    const xcb_atom_t incr = internAtom(requestorConnection, "INCR");
+    const xcb_window_t requestor = xcb_generate_id(requestorConnection);
+    const xcb_setup_t *setup = xcb_get_setup(requestorConnection);
+    const uint32_t values[] = { XCB_EVENT_MASK_PROPERTY_CHANGE };
+    xcb_create_window(requestorConnection, XCB_COPY_FROM_PARENT, requestor, xcb_setup_roots_iterator(setup).data->root,
+                      0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, values);
+    xcb_convert_selection(requestorConnection, requestor, selection, target, property, XCB_CURRENT_TIME);
+    xcb_flush(requestorConnection);
+
+    QByteArray received;
+    int chunks = 0;
+    int largestChunk = 0;
+    uint32_t announcedSize = 0;
+    xcb_atom_t notifiedProperty = XCB_ATOM_NONE;
+    bool incremental = false;
+    bool done = false;
+    // reads what arrived for the requestor, the owner answers from Qt's event loop
+    auto readEvents = [&]() {
+        while (xcb_generic_event_t *event = xcb_poll_for_event(requestorConnection)) {
+            const uint8_t type = event->response_type & ~0x80;
+            bool readProperty = false;
+            if (type == XCB_SELECTION_NOTIFY) {
+                notifiedProperty = reinterpret_cast<xcb_selection_notify_event_t *>(event)->property;
+                readProperty = notifiedProperty == property;
+            } else if (type == XCB_PROPERTY_NOTIFY && incremental) {
+                xcb_property_notify_event_t *ev = reinterpret_cast<xcb_property_notify_event_t *>(event);
+                readProperty = ev->atom == property && ev->state == XCB_PROPERTY_NEW_VALUE;
+            }
+            free(event);
+            if (!readProperty) {
+                continue;
+            }
+            // deleting the property asks the owner for the next chunk
+            QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> reply(xcb_get_property_reply(requestorConnection,
+                xcb_get_property(requestorConnection, true, requestor, property, XCB_GET_PROPERTY_TYPE_ANY, 0, 1 << 20), nullptr));
+            xcb_flush(requestorConnection);
+            if (!reply) {
+                continue;
+            }
+            if (reply->type == incr) {
+                incremental = true;
+                announcedSize = *reinterpret_cast<uint32_t *>(xcb_get_property_value(reply.data()));
+                continue;
+            }
+            const int length = xcb_get_property_value_length(reply.data());
+            if (length == 0) {
+                done = incremental;
+                continue;
+            }
+            largestChunk = qMax(largestChunk, length);
+            received.append(reinterpret_cast<const char *>(xcb_get_property_value(reply.data())), length);
+            ++chunks;
+        }
+        return done;
+    };
+    QTRY_VERIFY_WITH_TIMEOUT(readEvents(), 5000);
+    xcb_disconnect(requestorConnection);
+
+    QCOMPARE(notifiedProperty, property);
+    QVERIFY(incremental);
+    QCOMPARE(announcedSize, uint32_t(data.size()));
+    QVERIFY(largestChunk <= 4096);
+    QCOMPARE(chunks, (data.size() + 4095) / 4096);
+    QCOMPARE(received, data);
+}
+
+void KManagerSelectionTest::testClaimAll()
+{
+    // test that a group of selections is claimed together and already owned ones fail
+    KSelectionOwner taken(SNAME "_2");
+    claim(&taken);
+
+    KSelectionOwner owner0(SNAME "_0");
+    KSelectionOwner owner1(SNAME "_1");
+    KSelectionOwner owner2(SNAME "_2");
+    QCOMPARE(owner0.claimLatency(), qint64(-1));
+    QSignalSpy claimed0(&owner0, SIGNAL(claimedOwnership()));
+    QSignalSpy claimed1(&owner1, SIGNAL(claimedOwnership()));
+    QSignalSpy failed2(&owner2, SIGNAL(failedToClaimOwnership()));
+
+    KSelectionOwner::claimAll({&owner0, &owner1, &owner2}, false);
+    // owner2 knows right away that the selection is taken
+    QCOMPARE(failed2.count(), 1);
+    QVERIFY(owner2.claimLatency() >= 0);
+    xSync();
+    QTRY_COMPARE(claimed0.count(), 1);
+    QTRY_COMPARE(claimed1.count(), 1);
+
+    QVERIFY(owner0.ownerWindow() != XCB_WINDOW_NONE);
+    QVERIFY(owner1.ownerWindow() != XCB_WINDOW_NONE);
+    QVERIFY(owner2.ownerWindow() == XCB_WINDOW_NONE);
+    QVERIFY(owner0.claimLatency() >= 0);
+    QVERIFY(owner1.claimLatency() >= 0);
+}
+
 SigCheckOwner::SigCheckOwner(const KSelectionOwner &owner)
     : lostownership(false)
 {
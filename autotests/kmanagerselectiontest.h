@@ -34,6 +34,8 @@ private Q_SLOTS:
     void testInitiallyOwned();
     void testLostOwnership();
     void testWatching();
+    void testIncrementalReply();
+    void testClaimAll();
 private:
     void claim(KSelectionOwner *owner, bool force = false, bool forceKill = true);
     void xSync();
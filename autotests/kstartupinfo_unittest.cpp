@@ -23,6 +23,7 @@
 #include <qtest_widgets.h>
 #include <QX11Info>
 #include <QWidget>
+#include <QRandomGenerator>
 
 #include <xcb/xcb.h>
 
@@ -64,6 +65,8 @@ private Q_SLOTS:
     void createNewStartupIdTest();
     void createNewStartupIdForTimestampTest();
     void setNewStartupIdTest();
+    void parseMessageFuzzTest();
+    void benchmarkParseMessage();
 
 private:
     KStartupInfo m_listener;
@@ -326,6 +329,169 @@ void KStartupInfo_UnitTest::setNewStartupIdTest()
 #endif
 }
 
+// The message parser as it was before it was rewritten as a single pass tokenizer,
+// kept as the reference for parseMessageFuzzTest()
+namespace ReferenceParser
+{
+static long get_num(const QString &item)
+{
+    unsigned int pos = item.indexOf(QLatin1Char('='));
+    return item.mid(pos + 1).toLong();
+}
+
+static QString get_str(const QString &item)
+{
+    int pos = item.indexOf(QLatin1Char('='));
+    return item.mid(pos + 1);
+}
+
+static QStringList get_fields(const QString &txt_P)
+{
+    QString txt = txt_P.simplified();
+    QStringList ret;
+    QString item;
+    bool in = false;
+    bool escape = false;
+    for (int pos = 0; pos < txt.length(); ++pos) {
+        if (escape) {
+            item += txt[ pos ];
+            escape = false;
+        } else if (txt[ pos ] == QLatin1Char('\\')) {
+            escape = true;
+        } else if (txt[ pos ] == QLatin1Char('\"')) {
+            in = !in;
+        } else if (txt[ pos ] == QLatin1Char(' ') && !in) {
+            ret.append(item);
+            item = QString();
+        } else {
+            item += txt[ pos ];
+        }
+    }
+    ret.append(item);
+    return ret;
+}
+
+struct Result {
+    QByteArray id;
+    QString bin;
+    QString name;
+    QString description;
+    QString icon;
+    int desktop = 0;
+    QByteArray wmclass;
+    QByteArray hostname;
+    QList<pid_t> pids;
+    KStartupInfoData::TriState silent = KStartupInfoData::Unknown;
+    int screen = -1;
+    int xinerama = -1;
+    WId launchedBy = 0;
+    QString applicationId;
+};
+
+static Result parse(const QString &msg)
+{
+    Result r;
+    const QStringList items = get_fields(msg);
+    for (const QString &item : items) {
+        if (item.startsWith(QLatin1String("ID="))) {
+            r.id = get_str(item).toUtf8();
+        } else if (item.startsWith(QLatin1String("BIN="))) {
+            r.bin = get_str(item);
+        } else if (item.startsWith(QLatin1String("NAME="))) {
+            r.name = get_str(item);
+        } else if (item.startsWith(QLatin1String("DESCRIPTION="))) {
+            r.description = get_str(item);
+        } else if (item.startsWith(QLatin1String("ICON="))) {
+            r.icon = get_str(item);
+        } else if (item.startsWith(QLatin1String("DESKTOP="))) {
+            r.desktop = get_num(item);
+            if (r.desktop != NET::OnAllDesktops) {
+                ++r.desktop;
+            }
+        } else if (item.startsWith(QLatin1String("WMCLASS="))) {
+            r.wmclass = get_str(item).toUtf8();
+        } else if (item.startsWith(QLatin1String("HOSTNAME="))) {
+            r.hostname = get_str(item).toUtf8();
+        } else if (item.startsWith(QLatin1String("PID="))) {
+            const pid_t pid = get_num(item);
+            if (!r.pids.contains(pid)) {
+                r.pids.append(pid);
+            }
+        } else if (item.startsWith(QLatin1String("SILENT="))) {
+            r.silent = get_num(item) != 0 ? KStartupInfoData::Yes : KStartupInfoData::No;
+        } else if (item.startsWith(QLatin1String("SCREEN="))) {
+            r.screen = get_num(item);
+        } else if (item.startsWith(QLatin1String("XINERAMA="))) {
+            r.xinerama = get_num(item);
+        } else if (item.startsWith(QLatin1String("LAUNCHED_BY="))) {
+            r.launchedBy = (WId) get_num(item);
+        } else if (item.startsWith(QLatin1String("APPLICATION_ID="))) {
+            r.applicationId = get_str(item);
+        }
+    }
+    return r;
+}
+}
+
+void KStartupInfo_UnitTest::parseMessageFuzzTest()
+{
+    static const char *const pieces[] = {
+        "ID=", "BIN=", "NAME=", "DESCRIPTION=", "ICON=", "DESKTOP=", "WMCLASS=", "HOSTNAME=",
+        "PID=", "SILENT=", "SCREEN=", "XINERAMA=", "LAUNCHED_BY=", "APPLICATION_ID=", "new:",
+        " ", "  ", "\t", "\n", "\"", "\\", "=", "-", "+", "0", "1", "42", "-7",
+        "99999999999999999999", "9223372036854775807", "-9223372036854775808", "abc", "k",
+    };
+    const int pieceCount = sizeof(pieces) / sizeof(pieces[0]);
+    const QString specials = QStringLiteral("\u00e9\u00a0\u2003\u4e2d");
+
+    QRandomGenerator random(4711);
+    for (int round = 0; round < 20000; ++round) {
+        QString msg;
+        const int length = random.bounded(1, 24);
+        for (int i = 0; i < length; ++i) {
+            const int choice = random.bounded(pieceCount + 1);
+            if (choice == pieceCount) {
+                msg += specials.at(random.bounded(specials.size()));
+            } else {
+                msg += QLatin1String(pieces[choice]);
+            }
+        }
+
+        const ReferenceParser::Result expected = ReferenceParser::parse(msg);
+        const KStartupInfoId id(msg);
+        const KStartupInfoData data(msg);
+        QCOMPARE(id.id(), expected.id);
+        QCOMPARE(data.bin(), expected.bin);
+        QCOMPARE(data.name(), expected.name);
+        QCOMPARE(data.description(), expected.description);
+        QCOMPARE(data.icon(), expected.icon);
+        QCOMPARE(data.desktop(), expected.desktop);
+        QCOMPARE(data.WMClass(), expected.wmclass);
+        QCOMPARE(data.hostname(), expected.hostname);
+        QCOMPARE(data.pids(), expected.pids);
+        QCOMPARE(data.silent(), expected.silent);
+        QCOMPARE(data.screen(), expected.screen);
+        QCOMPARE(data.xinerama(), expected.xinerama);
+        QCOMPARE(data.launchedBy(), expected.launchedBy);
+        QCOMPARE(data.applicationId(), expected.applicationId);
+    }
+}
+
+void KStartupInfo_UnitTest::benchmarkParseMessage()
+{
+    const QString msg = QStringLiteral("new: ID=\"kstartupinfo_unittest;1571323456;123456;4242_TIME12345678\" "
+                                       "BIN=\"/usr/bin/kwrite\" NAME=\"KWrite\" "
+                                       "DESCRIPTION=\"Launching KWrite, a \\\"text\\\" editor\" ICON=\"accessories-text-editor\" "
+                                       "DESKTOP=2 WMCLASS=\"kwrite\" HOSTNAME=somehost PID=4242 SCREEN=0 "
+                                       "APPLICATION_ID=\"/usr/share/applications/org.kde.kwrite.desktop\"");
+    QBENCHMARK {
+        KStartupInfoId id(msg);
+        KStartupInfoData data(msg);
+        QVERIFY(!id.isNull());
+        QCOMPARE(data.desktop(), 3);
+    }
+}
+
 QTEST_MAIN(KStartupInfo_UnitTest)
 
 #include "kstartupinfo_unittest.moc"
@@ -49,7 +49,13 @@ private Q_SLOTS:
     void testBlur_data();
     void testBlur();
     void testBlurDisable();
+    void testBlurUnchanged();
+    void testBlurForeignWindow();
+    void testBlurSimplified();
+    void testBlurRoundedRegion();
     void testMarkAsDashboard();
+    void testBatch();
+    void testWindowSizes();
     void testEffectAvailable_data();
     void testEffectAvailable();
 
@@ -60,6 +66,7 @@ private:
     void performWindowsOnPropertyTest(xcb_atom_t atom, const QList<WId> &windows);
     void performAtomIsRemoveTest(xcb_window_t window, xcb_atom_t atom);
     void getHelperAtom(const QByteArray &name, xcb_atom_t *atom) const;
+    QVector<uint32_t> readBlurProperty(xcb_window_t window) const;
     xcb_atom_t m_slide;
     xcb_atom_t m_presentWindows;
     xcb_atom_t m_presentWindowsGroup;
@@ -72,6 +79,7 @@ private:
 
 void KWindowEffectsTest::initTestCase()
 {
+    qRegisterMetaType<KWindowEffects::Effect>();
     m_window.reset(new QWindow());
     QVERIFY(m_window->winId() != XCB_WINDOW_NONE);
     m_widget.reset(new QWidget());
@@ -362,6 +370,141 @@ void KWindowEffectsTest::testBlurDisable()
     performAtomIsRemoveTest(m_window->winId(), m_blur);
 }
 
+QVector<uint32_t> KWindowEffectsTest::readBlurProperty(xcb_window_t window) const
+{
+    xcb_connection_t *c = QX11Info::connection();
+    xcb_get_property_cookie_t cookie = xcb_get_property_unchecked(c, false, window,
+                                       m_blur, XCB_ATOM_CARDINAL, 0, 4096);
+    QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> reply(xcb_get_property_reply(c, cookie, nullptr));
+    if (reply.isNull() || reply->type != XCB_ATOM_CARDINAL) {
+        return QVector<uint32_t>();
+    }
+    const uint32_t *data = static_cast<uint32_t *>(xcb_get_property_value(reply.data()));
+    QVector<uint32_t> values;
+    for (uint32_t i = 0; i < reply->value_len; ++i) {
+        values << data[i];
+    }
+    return values;
+}
+
+void KWindowEffectsTest::testBlurUnchanged()
+{
+    // this test verifies that setting the same blur region again doesn't touch the property
+    QWindow window;
+    QVERIFY(window.winId() != XCB_WINDOW_NONE);
+    const QRegion region(0, 0, 10, 10);
+    KWindowEffects::enableBlurBehind(window.winId(), true, region);
+    QCOMPARE(readBlurProperty(window.winId()), QVector<uint32_t>({0, 0, 10, 10}));
+
+    // change the property behind our back
+    xcb_connection_t *c = QX11Info::connection();
+    const uint32_t other[] = {1, 2, 3, 4};
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, window.winId(), m_blur, XCB_ATOM_CARDINAL, 32, 4, other);
+    QCOMPARE(readBlurProperty(window.winId()), QVector<uint32_t>({1, 2, 3, 4}));
+
+    // once the change is noticed, the same region has to be sent again
+    QTRY_VERIFY([&] {
+        KWindowEffects::enableBlurBehind(window.winId(), true, region);
+        return readBlurProperty(window.winId()) == QVector<uint32_t>({0, 0, 10, 10});
+    }());
+
+    // a different one is sent right away
+    KWindowEffects::enableBlurBehind(window.winId(), true, QRegion(0, 0, 20, 20));
+    QCOMPARE(readBlurProperty(window.winId()), QVector<uint32_t>({0, 0, 20, 20}));
+
+    // once somebody else removed the property, it has to be set again
+    xcb_delete_property(c, window.winId(), m_blur);
+    xcb_flush(c);
+    QTRY_VERIFY([&] {
+        KWindowEffects::enableBlurBehind(window.winId(), true, QRegion(0, 0, 20, 20));
+        return !readBlurProperty(window.winId()).isEmpty();
+    }());
+    QCOMPARE(readBlurProperty(window.winId()), QVector<uint32_t>({0, 0, 20, 20}));
+}
+
+void KWindowEffectsTest::testBlurForeignWindow()
+{
+    // changes on windows of other clients are not noticed, so nothing is skipped for them
+    xcb_connection_t *c = QX11Info::connection();
+    const xcb_window_t window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, QX11Info::appRootWindow(), 0, 0, 10, 10, 0,
+                      XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, nullptr);
+    const QRegion region(0, 0, 10, 10);
+    KWindowEffects::enableBlurBehind(window, true, region);
+    QCOMPARE(readBlurProperty(window), QVector<uint32_t>({0, 0, 10, 10}));
+
+    const uint32_t other[] = {1, 2, 3, 4};
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, window, m_blur, XCB_ATOM_CARDINAL, 32, 4, other);
+    KWindowEffects::enableBlurBehind(window, true, region);
+    QCOMPARE(readBlurProperty(window), QVector<uint32_t>({0, 0, 10, 10}));
+
+    xcb_destroy_window(c, window);
+    xcb_flush(c);
+}
+
+void KWindowEffectsTest::testBlurSimplified()
+{
+    QWindow window;
+    QVERIFY(window.winId() != XCB_WINDOW_NONE);
+
+    // rects differing by a pixel are merged
+    QRegion region(0, 0, 10, 5);
+    region += QRect(0, 5, 11, 5);
+    QCOMPARE(region.rectCount(), 2);
+    KWindowEffects::enableBlurBehind(window.winId(), true, region);
+    QCOMPARE(readBlurProperty(window.winId()), QVector<uint32_t>({0, 0, 11, 10}));
+
+    // a huge number of rects is limited, but everything stays covered
+    region = QRegion();
+    for (int i = 0; i < 1000; ++i) {
+        region += QRect(i * 3, 0, 1, 1);
+    }
+    QCOMPARE(region.rectCount(), 1000);
+    KWindowEffects::enableBlurBehind(window.winId(), true, region);
+    const QVector<uint32_t> data = readBlurProperty(window.winId());
+    QVERIFY(!data.isEmpty());
+    QVERIFY(data.count() < region.rectCount() * 4);
+    QRegion sent;
+    for (int i = 0; i + 3 < data.count(); i += 4) {
+        sent += QRect(data.at(i), data.at(i + 1), data.at(i + 2), data.at(i + 3));
+    }
+    QCOMPARE(sent.intersected(region), region);
+    // the added area is bounded by that of the region
+    int sentArea = 0;
+    for (const QRect &r : sent) {
+        sentArea += r.width() * r.height();
+    }
+    QVERIFY(sentArea <= 2 * region.rectCount());
+}
+
+void KWindowEffectsTest::testBlurRoundedRegion()
+{
+    // the corners of a rounded region change by a pixel from row to row,
+    // merging them must not turn the region into its bounding rect
+    QWindow window;
+    QVERIFY(window.winId() != XCB_WINDOW_NONE);
+    const QRegion region(0, 0, 64, 64, QRegion::Ellipse);
+    QVERIFY(region.rectCount() > 10);
+    KWindowEffects::enableBlurBehind(window.winId(), true, region);
+    const QVector<uint32_t> data = readBlurProperty(window.winId());
+    QVERIFY(!data.isEmpty());
+    QVERIFY(data.count() < region.rectCount() * 4);
+    QRegion sent;
+    for (int i = 0; i + 3 < data.count(); i += 4) {
+        sent += QRect(data.at(i), data.at(i + 1), data.at(i + 2), data.at(i + 3));
+    }
+    QCOMPARE(sent.intersected(region), region);
+    // in every row at most a pixel is added on either side
+    for (int y = 0; y < 64; ++y) {
+        const QRegion row(0, y, 64, 1);
+        const QRegion added = sent.intersected(row).subtracted(region.intersected(row));
+        QVERIFY(added.rectCount() <= 2);
+        for (const QRect &r : added) {
+            QVERIFY(r.width() <= 1);
+        }
+    }
+}
+
 void KWindowEffectsTest::testMarkAsDashboard()
 {
     const QByteArray className = QByteArrayLiteral("dashboard");
@@ -391,6 +534,58 @@ void KWindowEffectsTest::testMarkAsDashboard()
     QCOMPARE(QByteArray(data), className);
 }
 
+void KWindowEffectsTest::testBatch()
+{
+    QWindow window;
+    QVERIFY(window.winId() != XCB_WINDOW_NONE);
+
+    KWindowEffects::Batch batch;
+    QVERIFY(batch.isEmpty());
+    batch.slideWindow(window.winId(), KWindowEffects::TopEdge, 10);
+    batch.enableBlurBehind(window.winId(), true, QRegion(0, 0, 10, 10));
+    QVERIFY(!batch.isEmpty());
+
+    // nothing happens before the commit
+    QVERIFY(readBlurProperty(window.winId()).isEmpty());
+    performSlideWindowRemoveTest(window.winId());
+
+    batch.commit();
+    QVERIFY(batch.isEmpty());
+    QCOMPARE(readBlurProperty(window.winId()), QVector<uint32_t>({0, 0, 10, 10}));
+    performSlideWindowTest(window.winId(), 10, KWindowEffects::TopEdge);
+
+    // a batch which isn't committed is dropped
+    {
+        KWindowEffects::Batch dropped;
+        dropped.enableBlurBehind(window.winId(), false);
+    }
+    QCOMPARE(readBlurProperty(window.winId()), QVector<uint32_t>({0, 0, 10, 10}));
+}
+
+void KWindowEffectsTest::testWindowSizes()
+{
+    QWindow window;
+    window.resize(100, 50);
+    QVERIFY(window.winId() != XCB_WINDOW_NONE);
+    xcb_connection_t *c = QX11Info::connection();
+    xcb_flush(c);
+
+    // no window manager, so there are no frame extents
+    QList<QSize> sizes = KWindowEffects::windowSizes({window.winId(), 0});
+    QCOMPARE(sizes.count(), 2);
+    QCOMPARE(sizes.at(0), QSize(100, 50) * window.devicePixelRatio());
+    QCOMPARE(sizes.at(1), QSize());
+
+    // frame extents are added to the size: left, right, top, bottom
+    const uint32_t extents[] = {1, 2, 3, 4};
+    xcb_atom_t frameExtents;
+    getHelperAtom(QByteArrayLiteral("_NET_FRAME_EXTENTS"), &frameExtents);
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, window.winId(), frameExtents, XCB_ATOM_CARDINAL, 32, 4, extents);
+    sizes = KWindowEffects::windowSizes({window.winId()});
+    QCOMPARE(sizes.count(), 1);
+    QCOMPARE(sizes.at(0), QSize(100, 50) * window.devicePixelRatio() + QSize(3, 7));
+}
+
 void KWindowEffectsTest::testEffectAvailable_data()
 {
     QTest::addColumn<KWindowEffects::Effect>("effect");
@@ -433,6 +628,9 @@ void KWindowEffectsTest::testEffectAvailable()
     // but not yet available
     QVERIFY(!KWindowEffects::isEffectAvailable(effect));
 
+    QSignalSpy availabilityChangedSpy(KWindowSystem::self(), &KWindowSystem::effectAvailabilityChanged);
+    QVERIFY(availabilityChangedSpy.isValid());
+
     // set the atom
     QFETCH(QByteArray, propertyName);
     xcb_connection_t *c = QX11Info::connection();
@@ -443,21 +641,41 @@ void KWindowEffectsTest::testEffectAvailable()
     xcb_change_property(c, XCB_PROP_MODE_REPLACE, QX11Info::appRootWindow(), atom->atom, atom->atom, 8, 1, &dummy);
     xcb_flush(c);
 
-    // now the effect should be available
+    // now the effect should be available, as soon as the property change arrived
+    QVERIFY(availabilityChangedSpy.wait());
+    QCOMPARE(availabilityChangedSpy.count(), 1);
+    QCOMPARE(availabilityChangedSpy.first().at(0).value<KWindowEffects::Effect>(), effect);
+    QCOMPARE(availabilityChangedSpy.first().at(1).toBool(), true);
     QVERIFY(KWindowEffects::isEffectAvailable(effect));
 
     // delete the property again
     xcb_delete_property(c, QX11Info::appRootWindow(), atom->atom);
     xcb_flush(c);
     // which means it's no longer available
+    QVERIFY(availabilityChangedSpy.wait());
+    QCOMPARE(availabilityChangedSpy.count(), 2);
+    QCOMPARE(availabilityChangedSpy.last().at(1).toBool(), false);
     QVERIFY(!KWindowEffects::isEffectAvailable(effect));
 
+    // set the property again, the effect has to go away together with compositing
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, QX11Info::appRootWindow(), atom->atom, atom->atom, 8, 1, &dummy);
+    xcb_flush(c);
+    QVERIFY(availabilityChangedSpy.wait());
+    QCOMPARE(availabilityChangedSpy.count(), 3);
+
     // remove compositing selection
     compositorSelection.release();
     QVERIFY(compositingChangedSpy.wait());
     QCOMPARE(compositingChangedSpy.count(), 2);
     QCOMPARE(compositingChangedSpy.last().first().toBool(), false);
     QVERIFY(!KWindowSystem::compositingActive());
+    // makes the effect unavailable
+    QCOMPARE(availabilityChangedSpy.count(), 4);
+    QCOMPARE(availabilityChangedSpy.last().at(1).toBool(), false);
+    QVERIFY(!KWindowEffects::isEffectAvailable(effect));
+
+    xcb_delete_property(c, QX11Info::appRootWindow(), atom->atom);
+    xcb_flush(c);
 }
 
 QTEST_MAIN(KWindowEffectsTest)
@@ -45,6 +45,22 @@ private Q_SLOTS:
     void testWindowTitleChanged();
     void testMinimizeWindow();
     void testPlatformX11();
+    void testIconFromWMHints_data();
+    void testIconFromWMHints();
+    void testSetIcons();
+};
+
+// This struct is defined here to avoid a dependency on xcb-icccm
+struct kde_wm_hints {
+    uint32_t      flags;
+    uint32_t      input;
+    int32_t       initial_state;
+    xcb_pixmap_t  icon_pixmap;
+    xcb_window_t  icon_window;
+    int32_t       icon_x;
+    int32_t       icon_y;
+    xcb_pixmap_t  icon_mask;
+    xcb_window_t  window_group;
 };
 
 void KWindowSystemX11Test::initTestCase()
@@ -394,6 +410,107 @@ void KWindowSystemX11Test::testPlatformX11()
     QCOMPARE(KWindowSystem::isPlatformWayland(), false);
 }
 
+void KWindowSystemX11Test::testIconFromWMHints_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<bool>("withMask");
+
+    QTest::newRow("small") << QSize(16, 16) << false;
+    QTest::newRow("small with mask") << QSize(16, 16) << true;
+    QTest::newRow("large") << QSize(512, 300) << false;
+    QTest::newRow("large with mask") << QSize(512, 300) << true;
+}
+
+void KWindowSystemX11Test::testIconFromWMHints()
+{
+    // this test verifies that a legacy icon pixmap and its mask are read correctly
+    QFETCH(QSize, size);
+    QFETCH(bool, withMask);
+    xcb_connection_t *c = QX11Info::connection();
+    const xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    if (screen->root_depth != 24) {
+        QSKIP("Test requires a root window of depth 24");
+    }
+
+    QWidget widget;
+    QVERIFY(widget.winId() != XCB_WINDOW_NONE);
+
+    // a red icon
+    const xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, pixmap, screen->root, size.width(), size.height());
+    const xcb_gcontext_t gc = xcb_generate_id(c);
+    const uint32_t red = 0xff0000;
+    xcb_create_gc(c, gc, pixmap, XCB_GC_FOREGROUND, &red);
+    const xcb_rectangle_t whole = {0, 0, uint16_t(size.width()), uint16_t(size.height())};
+    xcb_poly_fill_rectangle(c, pixmap, gc, 1, &whole);
+
+    // with only the left half being visible
+    xcb_pixmap_t mask = XCB_PIXMAP_NONE;
+    xcb_gcontext_t maskGc = XCB_NONE;
+    if (withMask) {
+        mask = xcb_generate_id(c);
+        xcb_create_pixmap(c, 1, mask, screen->root, size.width(), size.height());
+        maskGc = xcb_generate_id(c);
+        uint32_t value = 0;
+        xcb_create_gc(c, maskGc, mask, XCB_GC_FOREGROUND, &value);
+        xcb_poly_fill_rectangle(c, mask, maskGc, 1, &whole);
+        value = 1;
+        xcb_change_gc(c, maskGc, XCB_GC_FOREGROUND, &value);
+        const xcb_rectangle_t left = {0, 0, uint16_t(size.width() / 2), uint16_t(size.height())};
+        xcb_poly_fill_rectangle(c, mask, maskGc, 1, &left);
+    }
+
+    kde_wm_hints hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.flags = (1 << 2) | (withMask ? (1 << 5) : 0); // IconPixmapHint | IconMaskHint
+    hints.icon_pixmap = pixmap;
+    hints.icon_mask = mask;
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, widget.winId(),
+                        XCB_ATOM_WM_HINTS, XCB_ATOM_WM_HINTS, 32, 9, &hints);
+
+    const QImage icon = KWindowSystem::icon(widget.winId(), -1, -1, false, KWindowSystem::WMHints).toImage();
+    QCOMPARE(icon.size(), size);
+    QCOMPARE(QColor(icon.pixel(0, 0)), QColor(Qt::red));
+    QCOMPARE(qAlpha(icon.pixel(0, 0)), 255);
+    if (withMask) {
+        QCOMPARE(qAlpha(icon.pixel(size.width() - 1, size.height() - 1)), 0);
+    } else {
+        QCOMPARE(QColor(icon.pixel(size.width() - 1, size.height() - 1)), QColor(Qt::red));
+    }
+
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, pixmap);
+    if (withMask) {
+        xcb_free_gc(c, maskGc);
+        xcb_free_pixmap(c, mask);
+    }
+}
+
+void KWindowSystemX11Test::testSetIcons()
+{
+    // this test verifies that both sizes end up in _NET_WM_ICON, not premultiplied
+    QWidget widget;
+    QVERIFY(widget.winId() != XCB_WINDOW_NONE);
+
+    QImage icon(32, 32, QImage::Format_ARGB32);
+    icon.fill(qRgba(255, 0, 0, 128));
+    QImage miniIcon(16, 16, QImage::Format_ARGB32);
+    miniIcon.fill(qRgba(0, 0, 255, 255));
+    KWindowSystem::setIcons(widget.winId(), QPixmap::fromImage(icon), QPixmap::fromImage(miniIcon));
+
+    NETWinInfo info(QX11Info::connection(), widget.winId(), QX11Info::appRootWindow(), NET::WMIcon, NET::Properties2());
+    const int *sizes = info.iconSizes();
+    QCOMPARE(sizes[0], 32);
+    QCOMPARE(sizes[1], 32);
+    QCOMPARE(sizes[2], 16);
+    QCOMPARE(sizes[3], 16);
+    QCOMPARE(sizes[4], 0);
+    const NETIcon large = info.icon(32, 32);
+    QCOMPARE(reinterpret_cast<const uint32_t *>(large.data)[0], uint32_t(qRgba(255, 0, 0, 128)));
+    const NETIcon small = info.icon(16, 16);
+    QCOMPARE(reinterpret_cast<const uint32_t *>(small.data)[0], uint32_t(qRgba(0, 0, 255, 255)));
+}
+
 QTEST_MAIN(KWindowSystemX11Test)
 
 #include "kwindowsystemx11test.moc"
@@ -0,0 +1,118 @@
+/* This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <kxmessages.h>
+#include <QAbstractEventDispatcher>
+#include <QX11Info>
+#include <qtest_widgets.h>
+
+#include <xcb/xcb.h>
+
+// Feeds synthetic message fragments from N interleaved senders through the
+// native event filter of a KXMessages receiver. Fragments per second are the
+// number of fragments in the row name divided by the reported time.
+// The reassembled messages are verified by kxmessages_unittest.
+class KXMessagesBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void benchmarkReassembly_data();
+    void benchmarkReassembly();
+
+private:
+    xcb_atom_t intern(const QByteArray &name);
+    xcb_atom_t m_leadingAtom = XCB_ATOM_NONE;
+    xcb_atom_t m_followingAtom = XCB_ATOM_NONE;
+};
+
+static const char s_messageType[] = "kxmessages_benchmark";
+
+xcb_atom_t KXMessagesBenchmark::intern(const QByteArray &name)
+{
+    xcb_connection_t *c = QX11Info::connection();
+    const xcb_intern_atom_cookie_t cookie = xcb_intern_atom(c, false, name.length(), name.constData());
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(c, cookie, nullptr);
+    if (!reply) {
+        return XCB_ATOM_NONE;
+    }
+    const xcb_atom_t atom = reply->atom;
+    free(reply);
+    return atom;
+}
+
+void KXMessagesBenchmark::initTestCase()
+{
+    m_leadingAtom = intern(QByteArray(s_messageType) + "_BEGIN");
+    m_followingAtom = intern(QByteArray(s_messageType));
+    QVERIFY(m_leadingAtom != XCB_ATOM_NONE);
+    QVERIFY(m_followingAtom != XCB_ATOM_NONE);
+}
+
+void KXMessagesBenchmark::benchmarkReassembly_data()
+{
+    QTest::addColumn<int>("senders");
+    QTest::addColumn<int>("messageLength");
+
+    QTest::newRow("1 sender, 6 fragments") << 1 << 100;
+    QTest::newRow("10 senders, 60 fragments") << 10 << 100;
+    QTest::newRow("100 senders, 600 fragments") << 100 << 100;
+    QTest::newRow("1000 senders, 6000 fragments") << 1000 << 100;
+    QTest::newRow("1000 senders, 21000 fragments") << 1000 << 400;
+}
+
+void KXMessagesBenchmark::benchmarkReassembly()
+{
+    QFETCH(int, senders);
+    QFETCH(int, messageLength);
+
+    KXMessages receiver(s_messageType);
+    connect(&receiver, &KXMessages::gotRawMessage, this, []() {});
+
+    const QByteArray message(messageLength, 'a');
+    // including the terminating null byte
+    const int fragmentCount = messageLength / 20 + 1;
+
+    QVector<xcb_client_message_event_t> fragments;
+    fragments.reserve(senders * fragmentCount);
+    for (int fragment = 0; fragment < fragmentCount; ++fragment) {
+        for (int sender = 0; sender < senders; ++sender) {
+            xcb_client_message_event_t event;
+            memset(&event, 0, sizeof(event));
+            event.response_type = XCB_CLIENT_MESSAGE;
+            event.format = 8;
+            event.window = 0x1000000 + sender;
+            event.type = fragment == 0 ? m_leadingAtom : m_followingAtom;
+            const int offset = fragment * 20;
+            memcpy(event.data.data8, message.constData() + offset, qMin(20, messageLength - offset));
+            fragments << event;
+        }
+    }
+
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    const QByteArray eventType = QByteArrayLiteral("xcb_generic_event_t");
+    long result = 0;
+    QBENCHMARK {
+        for (int i = 0; i < fragments.size(); ++i) {
+            xcb_client_message_event_t event = fragments.at(i);
+            dispatcher->filterNativeEvent(eventType, &event, &result);
+        }
+    }
+}
+
+QTEST_MAIN(KXMessagesBenchmark)
+
+#include "kxmessages_benchmark.moc"
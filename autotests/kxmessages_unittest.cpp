@@ -17,10 +17,13 @@
 */
 
 #include <kxmessages.h>
+#include <QAbstractEventDispatcher>
 #include <QSignalSpy>
 #include <QX11Info>
 #include <qtest_widgets.h>
 
+#include <xcb/xcb.h>
+
 class KXMessages_UnitTest : public QObject
 {
     Q_OBJECT
@@ -30,7 +33,9 @@ public:
 #if KWINDOWSYSTEM_ENABLE_DEPRECATED_SINCE(5, 0)
         BroadcastStaticDisplay,
 #endif
-        BroadcastStaticConnection
+        BroadcastStaticConnection,
+        BroadcastSender,
+        BroadcastSenderProperty
     };
     enum ReceiverType {
         ReceiverTypeDefault,
@@ -44,6 +49,11 @@ public:
 private Q_SLOTS:
     void testStart_data();
     void testStart();
+    void testPropertyTransportNotAdvertised();
+    void testPropertySlotsInUse();
+    void testPropertyTransportNotClaimed_data();
+    void testPropertyTransportNotClaimed();
+    void testInterleavedFragments();
 
 private:
     KXMessages m_msgs;
@@ -62,11 +72,15 @@ void KXMessages_UnitTest::testStart_data()
     QTest::newRow("display")    << BroadcastStaticDisplay << ReceiverTypeDefault;
 #endif
     QTest::newRow("connection") << BroadcastStaticConnection << ReceiverTypeDefault;
+    QTest::newRow("sender")     << BroadcastSender << ReceiverTypeDefault;
+    QTest::newRow("property")   << BroadcastSenderProperty << ReceiverTypeDefault;
     QTest::newRow("object/xcb")     << BroadcastMessageObject << ReceiverTypeConnection;
 #if KWINDOWSYSTEM_ENABLE_DEPRECATED_SINCE(5, 0)
     QTest::newRow("display/xcb")    << BroadcastStaticDisplay << ReceiverTypeConnection;
 #endif
     QTest::newRow("connection/xcb") << BroadcastStaticConnection << ReceiverTypeConnection;
+    QTest::newRow("sender/xcb")     << BroadcastSender << ReceiverTypeConnection;
+    QTest::newRow("property/xcb")   << BroadcastSenderProperty << ReceiverTypeConnection;
 }
 
 void KXMessages_UnitTest::testStart()
@@ -87,11 +101,23 @@ void KXMessages_UnitTest::testStart()
         break;
     }
 
+    QScopedPointer<KXMessagesSender> sender;
+    if (broadcastType == BroadcastSender || broadcastType == BroadcastSenderProperty) {
+        sender.reset(new KXMessagesSender(QX11Info::connection(), QX11Info::appScreen()));
+        QVERIFY(sender->isValid());
+        if (broadcastType == BroadcastSenderProperty) {
+            receiver->advertisePropertyTransport();
+            receiver->claimPropertyTransport();
+            sender->setTransport(KXMessagesSender::AutoTransport);
+        }
+    }
+
     // Check that all message sizes work, i.e. no bug when exactly 20 or 40 bytes,
     // despite the internal splitting.
     QString message;
     for (int i = 1; i < 50; ++i) {
         QSignalSpy spy(receiver.data(), SIGNAL(gotMessage(QString)));
+        QSignalSpy rawSpy(receiver.data(), SIGNAL(gotRawMessage(QByteArray)));
         message += "a";
         switch (broadcastType) {
         case KXMessages_UnitTest::BroadcastMessageObject:
@@ -105,11 +131,197 @@ void KXMessages_UnitTest::testStart()
         case KXMessages_UnitTest::BroadcastStaticConnection:
             QVERIFY(KXMessages::broadcastMessageX(QX11Info::connection(), type.constData(), message, QX11Info::appScreen()));
             break;
+        case KXMessages_UnitTest::BroadcastSender:
+        case KXMessages_UnitTest::BroadcastSenderProperty:
+            QVERIFY(sender->broadcastMessage(type.constData(), message));
+            break;
         }
 
         QVERIFY(spy.wait());
         QCOMPARE(spy.count(), 1);
         QCOMPARE(spy.at(0).at(0).toString(), message);
+        QCOMPARE(rawSpy.count(), 1);
+        QCOMPARE(rawSpy.at(0).at(0).toByteArray(), message.toUtf8());
+    }
+}
+
+void KXMessages_UnitTest::testPropertyTransportNotAdvertised()
+{
+    // without an advertising receiver, messages have to be sent fragmented
+    const QByteArray type = "kxmessage_unittest_legacy";
+    KXMessages receiver(type);
+    KXMessagesSender sender(QX11Info::connection(), QX11Info::appScreen());
+    sender.setTransport(KXMessagesSender::AutoTransport);
+    QCOMPARE(sender.transport(), KXMessagesSender::AutoTransport);
+
+    // the transport belongs to the sender object, not to the shared handle
+    KXMessagesSender other(QX11Info::connection(), QX11Info::appScreen());
+    QCOMPARE(other.transport(), KXMessagesSender::FragmentedTransport);
+
+    QSignalSpy spy(&receiver, SIGNAL(gotMessage(QString)));
+    const QString message(100, QLatin1Char('b'));
+    QVERIFY(sender.broadcastMessage(type.constData(), message));
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), message);
+}
+
+void KXMessages_UnitTest::testPropertySlotsInUse()
+{
+    // more messages than payload slots before the receiver gets to read any of
+    // them, the sender has to fall back to fragments instead of reusing slots
+    const QByteArray type = "kxmessage_unittest_slots";
+    KXMessages receiver(type);
+    receiver.advertisePropertyTransport();
+    receiver.claimPropertyTransport();
+    KXMessagesSender sender(QX11Info::connection(), QX11Info::appScreen());
+    sender.setTransport(KXMessagesSender::AutoTransport);
+
+    QSignalSpy spy(&receiver, SIGNAL(gotMessage(QString)));
+    QStringList messages;
+    for (int i = 0; i < 20; ++i) {
+        messages << QString(100, QLatin1Char('c')) + QString::number(i);
+        QVERIFY(sender.broadcastMessage(type.constData(), messages.last()));
+    }
+    QTRY_COMPARE(spy.count(), messages.count());
+    for (int i = 0; i < messages.count(); ++i) {
+        QCOMPARE(spy.at(i).at(0).toString(), messages.at(i));
+    }
+}
+
+static xcb_atom_t internAtom(const QByteArray &name)
+{
+    xcb_connection_t *c = QX11Info::connection();
+    const xcb_intern_atom_cookie_t cookie = xcb_intern_atom(c, false, name.length(), name.constData());
+    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> reply(xcb_intern_atom_reply(c, cookie, nullptr));
+    return reply.isNull() ? XCB_ATOM_NONE : reply->atom;
+}
+
+// Counts the messages of one type that start with a leading fragment, the
+// only kind of message KXMessages from before the property transport gets
+class LegacyReceiver : public QAbstractNativeEventFilter
+{
+public:
+    explicit LegacyReceiver(const QByteArray &type)
+        : m_leading(internAtom(type + QByteArrayLiteral("_BEGIN")))
+    {
+        QCoreApplication::instance()->installNativeEventFilter(this);
+    }
+    ~LegacyReceiver() override
+    {
+        QCoreApplication::instance()->removeNativeEventFilter(this);
+    }
+
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override
+    {
+        Q_UNUSED(result)
+        if (eventType != "xcb_generic_event_t") {
+            return false;
+        }
+        xcb_generic_event_t *event = reinterpret_cast<xcb_generic_event_t *>(message);
+        if ((event->response_type & ~0x80) == XCB_CLIENT_MESSAGE
+                && reinterpret_cast<xcb_client_message_event_t *>(event)->type == m_leading) {
+            ++messages;
+        }
+        return false;
+    }
+
+    int messages = 0;
+
+private:
+    xcb_atom_t m_leading;
+};
+
+void KXMessages_UnitTest::testPropertyTransportNotClaimed_data()
+{
+    QTest::addColumn<bool>("claimed");
+
+    QTest::newRow("not claimed") << false;
+    QTest::newRow("claimed") << true;
+}
+
+void KXMessages_UnitTest::testPropertyTransportNotClaimed()
+{
+    // an advertising receiver alone must not cut off receivers which only
+    // understand fragments, the transport has to be claimed for the type
+    QFETCH(bool, claimed);
+    const QByteArray type = claimed ? "kxmessage_unittest_claimed" : "kxmessage_unittest_unclaimed";
+    LegacyReceiver legacy(type);
+    KXMessages receiver(type);
+    receiver.advertisePropertyTransport();
+    if (claimed) {
+        receiver.claimPropertyTransport();
+    }
+    KXMessagesSender sender(QX11Info::connection(), QX11Info::appScreen());
+    sender.setTransport(KXMessagesSender::AutoTransport);
+
+    QSignalSpy spy(&receiver, SIGNAL(gotMessage(QString)));
+    const QString message(100, QLatin1Char('d'));
+    QVERIFY(sender.broadcastMessage(type.constData(), message));
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), message);
+    QCOMPARE(legacy.messages, claimed ? 0 : 1);
+}
+
+void KXMessages_UnitTest::testInterleavedFragments()
+{
+    // fragments of many senders arriving interleaved have to be put together
+    // per sender, also while the table of partial messages grows and reuses
+    // the buffers of finished ones
+    const QByteArray type = "kxmessage_unittest_interleaved";
+    const xcb_atom_t leadingAtom = internAtom(type + "_BEGIN");
+    const xcb_atom_t followingAtom = internAtom(type);
+    QVERIFY(leadingAtom != XCB_ATOM_NONE);
+    QVERIFY(followingAtom != XCB_ATOM_NONE);
+
+    KXMessages receiver(type);
+    QHash<xcb_window_t, QByteArray> received;
+    xcb_window_t window = XCB_WINDOW_NONE;
+    connect(&receiver, &KXMessages::gotRawMessage, this, [&received, &window](const QByteArray &message) {
+        QVERIFY(!received.contains(window));
+        received.insert(window, message);
+    });
+
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    const auto send = [&](xcb_window_t sender, xcb_atom_t atom, const QByteArray &fragment) {
+        xcb_client_message_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.response_type = XCB_CLIENT_MESSAGE;
+        event.format = 8;
+        event.window = sender;
+        event.type = atom;
+        memcpy(event.data.data8, fragment.constData(), qMin(20, fragment.length()));
+        long result = 0;
+        window = sender;
+        dispatcher->filterNativeEvent(QByteArrayLiteral("xcb_generic_event_t"), &event, &result);
+    };
+
+    const int senders = 300;
+    QVector<QByteArray> messages;
+    for (int i = 0; i < senders; ++i) {
+        // lengths of up to a few fragments, including exact multiples of 20
+        messages << QByteArray::number(i).leftJustified(i % 75, 'x');
+    }
+    // a message which is started again before it was completed is dropped
+    for (int i = 0; i < senders; i += 7) {
+        send(0x1000000 + i, leadingAtom, QByteArray(20, 'z'));
+    }
+    // a fragment without the beginning is ignored
+    send(0x2000000, followingAtom, QByteArray("lost"));
+
+    for (int offset = 0; received.count() < senders; offset += 20) {
+        QVERIFY(offset <= 80);
+        for (int i = 0; i < senders; ++i) {
+            // including the terminating null byte
+            if (offset <= messages.at(i).length()) {
+                send(0x1000000 + i, offset == 0 ? leadingAtom : followingAtom, messages.at(i).mid(offset, 20));
+            }
+        }
+    }
+    QCOMPARE(received.count(), senders);
+    for (int i = 0; i < senders; ++i) {
+        QCOMPARE(received.value(0x1000000 + i), messages.at(i));
     }
 }
 
@@ -0,0 +1,168 @@
+/* This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kxpixelconversion_p.h"
+
+#include <QImage>
+#include <QVector>
+#include <QtTest>
+
+Q_DECLARE_METATYPE(const KXUtils::PixelKernels *)
+
+// Compares the speed of the vectorized pixel kernels with the portable ones and with
+// the code paths they replaced: the per pixel depth 30 loop and QImage::convertToFormat.
+// Their results are verified by kxpixelconversion_unittest.
+class KXPixelConversionBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void benchmarkDepth30_data();
+    void benchmarkDepth30();
+    void benchmarkPremultiply_data();
+    void benchmarkPremultiply();
+    void benchmarkUnpremultiply_data();
+    void benchmarkUnpremultiply();
+    void benchmarkNetWmIcon_data();
+    void benchmarkNetWmIcon();
+
+private:
+    void addKernelRows();
+    QVector<uint32_t> m_pixels;
+};
+
+// a 256x256 icon
+static const int s_pixelCount = 256 * 256;
+
+void KXPixelConversionBenchmark::initTestCase()
+{
+    qsrand(42);
+    m_pixels.resize(s_pixelCount);
+    for (int i = 0; i < s_pixelCount; ++i) {
+        // every combination of alpha and a color value, some are invalid when premultiplied
+        m_pixels[i] = (uint32_t(i & 0xff) << 24) | (uint32_t(i >> 8) << 16) | (qrand() & 0xffff);
+    }
+    qDebug() << "Using" << KXUtils::pixelKernels().name << "pixel kernels";
+}
+
+void KXPixelConversionBenchmark::addKernelRows()
+{
+    QTest::addColumn<const KXUtils::PixelKernels *>("kernels");
+    const auto kernels = KXUtils::supportedPixelKernels();
+    for (const KXUtils::PixelKernels *k : kernels) {
+        QTest::newRow(k->name) << k;
+    }
+}
+
+void KXPixelConversionBenchmark::benchmarkDepth30_data()
+{
+    addKernelRows();
+    QTest::newRow("per pixel loop") << static_cast<const KXUtils::PixelKernels *>(nullptr);
+}
+
+void KXPixelConversionBenchmark::benchmarkDepth30()
+{
+    QFETCH(const KXUtils::PixelKernels *, kernels);
+    QVector<uint32_t> pixels = m_pixels;
+    QBENCHMARK {
+        if (kernels) {
+            kernels->convertDepth30ToArgb32(pixels.data(), pixels.count());
+        } else {
+            // what KXUtils::createPixmapFromHandle used to do
+            for (int i = 0; i < pixels.count(); ++i) {
+                int r = (pixels[i] >> 22) & 0xff;
+                int g = (pixels[i] >> 12) & 0xff;
+                int b = (pixels[i] >>  2) & 0xff;
+
+                pixels[i] = qRgba(r, g, b, 0xff);
+            }
+        }
+    }
+}
+
+void KXPixelConversionBenchmark::benchmarkPremultiply_data()
+{
+    addKernelRows();
+    QTest::newRow("QImage::convertToFormat") << static_cast<const KXUtils::PixelKernels *>(nullptr);
+}
+
+void KXPixelConversionBenchmark::benchmarkPremultiply()
+{
+    QFETCH(const KXUtils::PixelKernels *, kernels);
+    const QImage source(reinterpret_cast<const uchar *>(m_pixels.constData()), 256, 256, QImage::Format_ARGB32);
+    QImage result(256, 256, QImage::Format_ARGB32_Premultiplied);
+    QBENCHMARK {
+        if (kernels) {
+            kernels->premultiply(m_pixels.constData(), reinterpret_cast<uint32_t *>(result.bits()), m_pixels.count());
+        } else {
+            result = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        }
+    }
+}
+
+void KXPixelConversionBenchmark::benchmarkUnpremultiply_data()
+{
+    addKernelRows();
+    QTest::newRow("QImage::convertToFormat") << static_cast<const KXUtils::PixelKernels *>(nullptr);
+}
+
+void KXPixelConversionBenchmark::benchmarkUnpremultiply()
+{
+    QFETCH(const KXUtils::PixelKernels *, kernels);
+    const QImage source = QImage(reinterpret_cast<const uchar *>(m_pixels.constData()), 256, 256, QImage::Format_ARGB32)
+                          .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const uint32_t *sourcePixels = reinterpret_cast<const uint32_t *>(source.constBits());
+    QImage result(256, 256, QImage::Format_ARGB32);
+    QBENCHMARK {
+        if (kernels) {
+            kernels->unpremultiply(sourcePixels, reinterpret_cast<uint32_t *>(result.bits()), m_pixels.count());
+        } else {
+            result = source.convertToFormat(QImage::Format_ARGB32);
+        }
+    }
+}
+
+void KXPixelConversionBenchmark::benchmarkNetWmIcon_data()
+{
+    QTest::addColumn<bool>("direct");
+
+    QTest::newRow("writeNetWmIcon") << true;
+    QTest::newRow("convertToFormat and copy") << false;
+}
+
+void KXPixelConversionBenchmark::benchmarkNetWmIcon()
+{
+    QFETCH(bool, direct);
+    // icons set through KWindowSystem::setIcons are usually premultiplied
+    const QImage source = QImage(reinterpret_cast<const uchar *>(m_pixels.constData()), 256, 256, QImage::Format_ARGB32)
+                          .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QVector<uint32_t> data(KXUtils::netWmIconLength(source));
+    QBENCHMARK {
+        if (direct) {
+            KXUtils::writeNetWmIcon(source, data.data());
+        } else {
+            // what KWindowSystem::setIcons and NETWinInfo::setIcon used to do
+            const QImage converted = source.convertToFormat(QImage::Format_ARGB32);
+            data[0] = converted.width();
+            data[1] = converted.height();
+            memcpy(data.data() + 2, converted.constBits(), converted.width() * converted.height() * sizeof(uint32_t));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(KXPixelConversionBenchmark)
+
+#include "kxpixelconversion_benchmark.moc"
@@ -0,0 +1,147 @@
+/* This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kxpixelconversion_p.h"
+
+#include <QImage>
+#include <QVector>
+#include <QtTest>
+
+Q_DECLARE_METATYPE(const KXUtils::PixelKernels *)
+
+// Verifies that all pixel kernels give the same results as the portable ones and Qt.
+class KXPixelConversionTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void testKernels_data();
+    void testKernels();
+    void testWriteNetWmIcon_data();
+    void testWriteNetWmIcon();
+
+private:
+    void addKernelRows();
+    QVector<uint32_t> m_pixels;
+};
+
+// a 256x256 icon
+static const int s_pixelCount = 256 * 256;
+
+void KXPixelConversionTest::initTestCase()
+{
+    qsrand(42);
+    m_pixels.resize(s_pixelCount);
+    for (int i = 0; i < s_pixelCount; ++i) {
+        // every combination of alpha and a color value, some are invalid when premultiplied
+        m_pixels[i] = (uint32_t(i & 0xff) << 24) | (uint32_t(i >> 8) << 16) | (qrand() & 0xffff);
+    }
+    qDebug() << "Using" << KXUtils::pixelKernels().name << "pixel kernels";
+}
+
+void KXPixelConversionTest::addKernelRows()
+{
+    QTest::addColumn<const KXUtils::PixelKernels *>("kernels");
+    const auto kernels = KXUtils::supportedPixelKernels();
+    for (const KXUtils::PixelKernels *k : kernels) {
+        QTest::newRow(k->name) << k;
+    }
+}
+
+void KXPixelConversionTest::testKernels_data()
+{
+    addKernelRows();
+}
+
+void KXPixelConversionTest::testKernels()
+{
+    QFETCH(const KXUtils::PixelKernels *, kernels);
+    const KXUtils::PixelKernels *scalar = KXUtils::supportedPixelKernels().first();
+    // an odd count to also cover the pixels left over by the vector loops
+    const int count = m_pixels.count() - 3;
+    QVector<uint32_t> expected(count);
+    QVector<uint32_t> actual(count);
+
+    scalar->premultiply(m_pixels.constData(), expected.data(), count);
+    kernels->premultiply(m_pixels.constData(), actual.data(), count);
+    QCOMPARE(actual, expected);
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(actual.at(i), qPremultiply(m_pixels.at(i)));
+    }
+
+    scalar->unpremultiply(m_pixels.constData(), expected.data(), count);
+    kernels->unpremultiply(m_pixels.constData(), actual.data(), count);
+    QCOMPARE(actual, expected);
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(actual.at(i), qUnpremultiply(m_pixels.at(i)));
+    }
+
+    scalar->setOpaque(m_pixels.constData(), expected.data(), count);
+    kernels->setOpaque(m_pixels.constData(), actual.data(), count);
+    QCOMPARE(actual, expected);
+
+    expected = m_pixels.mid(0, count);
+    actual = expected;
+    scalar->convertDepth30ToArgb32(expected.data(), count);
+    kernels->convertDepth30ToArgb32(actual.data(), count);
+    QCOMPARE(actual, expected);
+    for (int i = 0; i < count; ++i) {
+        const uint32_t p = m_pixels.at(i);
+        QCOMPARE(actual.at(i), qRgba((p >> 22) & 0xff, (p >> 12) & 0xff, (p >> 2) & 0xff, 0xff));
+    }
+
+    // premultiplying and back keeps opaque pixels
+    for (int i = 0; i < count; ++i) {
+        expected[i] = m_pixels.at(i) | 0xff000000;
+    }
+    kernels->premultiply(expected.constData(), actual.data(), count);
+    kernels->unpremultiply(actual.constData(), actual.data(), count);
+    QCOMPARE(actual, expected);
+}
+
+void KXPixelConversionTest::testWriteNetWmIcon_data()
+{
+    QTest::addColumn<QImage::Format>("format");
+
+    QTest::newRow("ARGB32") << QImage::Format_ARGB32;
+    QTest::newRow("ARGB32_Premultiplied") << QImage::Format_ARGB32_Premultiplied;
+    QTest::newRow("RGB32") << QImage::Format_RGB32;
+    QTest::newRow("RGB888") << QImage::Format_RGB888;
+}
+
+void KXPixelConversionTest::testWriteNetWmIcon()
+{
+    QFETCH(QImage::Format, format);
+    QImage source(reinterpret_cast<const uchar *>(m_pixels.constData()), 37, 23, QImage::Format_ARGB32);
+    source = source.convertToFormat(format);
+    const QImage expected = source.convertToFormat(QImage::Format_ARGB32);
+
+    QVector<uint32_t> data(KXUtils::netWmIconLength(source));
+    QCOMPARE(data.count(), 2 + 37 * 23);
+    KXUtils::writeNetWmIcon(source, data.data());
+    QCOMPARE(data.at(0), uint32_t(37));
+    QCOMPARE(data.at(1), uint32_t(23));
+    for (int y = 0; y < expected.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(expected.constScanLine(y));
+        for (int x = 0; x < expected.width(); ++x) {
+            QCOMPARE(data.at(2 + y * 37 + x), line[x]);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(KXPixelConversionTest)
+
+#include "kxpixelconversion_unittest.moc"
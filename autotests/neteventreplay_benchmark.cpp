@@ -0,0 +1,105 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "neteventsession.h"
+
+#include <kwindowsystem.h>
+
+#include <QAbstractEventDispatcher>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QX11Info>
+#include <QtTest>
+
+// Replays recorded X event streams through the native event filter of
+// KWindowSystem. Recordings made with KWINDOWSYSTEM_RECORD_EVENTS can be
+// added to the benchmark by listing them in KWINDOWSYSTEM_REPLAY_EVENTS.
+// The properties the filter reads still come from the X server, so the
+// results include those round trips.
+class NetEventReplayBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkReplay_data();
+    void benchmarkReplay();
+
+private:
+    QTemporaryDir m_dir;
+    QString m_sessionFile;
+    QScopedPointer<NetEventSession> m_session;
+};
+
+void NetEventReplayBenchmark::initTestCase()
+{
+    if (!QX11Info::isPlatformX11()) {
+        QSKIP("The replay goes through the X11 backend of KWindowSystem");
+    }
+    QVERIFY(m_dir.isValid());
+    m_session.reset(new NetEventSession);
+    QVERIFY(m_session->isValid());
+    m_sessionFile = m_dir.filePath(QStringLiteral("session.kxer"));
+    QVERIFY(m_session->record(m_sessionFile));
+    m_session->clearRootProperties();
+
+    // from now on KWindowSystem keeps track of the windows
+    KWindowSystem::windows();
+}
+
+void NetEventReplayBenchmark::benchmarkReplay_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("session") << m_sessionFile;
+    const QStringList recordings = QString::fromLocal8Bit(qgetenv("KWINDOWSYSTEM_REPLAY_EVENTS")).split(QDir::listSeparator(), QString::SkipEmptyParts);
+    for (const QString &fileName : recordings) {
+        QTest::newRow(qPrintable(QFileInfo(fileName).fileName())) << fileName;
+    }
+}
+
+void NetEventReplayBenchmark::benchmarkReplay()
+{
+    QFETCH(QString, fileName);
+    KXUtils::EventRecording recording;
+    QVERIFY(recording.load(fileName));
+    KXUtils::EventReplayer replayer(QX11Info::connection(), QX11Info::appRootWindow(), recording);
+    // the server is only read from while timing
+    replayer.applyProperties();
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+
+    QElapsedTimer timer;
+    qint64 elapsed = 0;
+    qint64 events = 0;
+    QBENCHMARK {
+        timer.start();
+        replayer.replay([dispatcher](xcb_generic_event_t *event) {
+            long result = 0;
+            dispatcher->filterNativeEvent(QByteArrayLiteral("xcb_generic_event_t"), event, &result);
+        });
+        elapsed += timer.nsecsElapsed();
+        events += replayer.count();
+    }
+    if (elapsed > 0) {
+        qDebug("%s: %.0f events per second", qPrintable(fileName), events * 1e9 / elapsed);
+    }
+}
+
+QTEST_MAIN(NetEventReplayBenchmark)
+
+#include "neteventreplay_benchmark.moc"
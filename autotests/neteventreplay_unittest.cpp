@@ -0,0 +1,170 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "neteventsession.h"
+
+#include <kwindowinfo.h>
+#include <kwindowsystem.h>
+#include <netwm.h>
+
+#include <QAbstractEventDispatcher>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QX11Info>
+#include <QtTest>
+
+class NetEventReplayTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+
+    void testRecording();
+    void testBrokenRecording();
+    void testRecorderInstance();
+    void testReplay();
+
+private:
+    QTemporaryDir m_dir;
+    QString m_sessionFile;
+    QScopedPointer<NetEventSession> m_session;
+};
+
+void NetEventReplayTest::initTestCase()
+{
+    if (!QX11Info::isPlatformX11()) {
+        QSKIP("The replay goes through the X11 backend of KWindowSystem");
+    }
+    QVERIFY(m_dir.isValid());
+    m_session.reset(new NetEventSession);
+    QVERIFY(m_session->isValid());
+    m_sessionFile = m_dir.filePath(QStringLiteral("session.kxer"));
+    QVERIFY(m_session->record(m_sessionFile));
+}
+
+void NetEventReplayTest::testRecording()
+{
+    KXUtils::EventRecording recording;
+    QVERIFY(recording.load(m_sessionFile));
+    QCOMPARE(recording.rootWindow, QX11Info::appRootWindow());
+    QVERIFY(recording.events.count() > s_sessionChanges);
+    QVERIFY(recording.atomNames.values().contains(QByteArrayLiteral("_NET_CLIENT_LIST")));
+    QVERIFY(recording.atomNames.values().contains(QByteArrayLiteral("_NET_WM_STATE_MAXIMIZED_VERT")));
+
+    quint32 time = 0;
+    int properties = 0;
+    for (const KXUtils::RecordedEvent &event : qAsConst(recording.events)) {
+        QVERIFY(event.time >= time);
+        time = event.time;
+        if ((event.event.response_type & ~0x80) == XCB_PROPERTY_NOTIFY) {
+            QCOMPARE(event.properties.count(), 1);
+            const xcb_property_notify_event_t *e = reinterpret_cast<const xcb_property_notify_event_t *>(&event.event);
+            QCOMPARE(event.properties.first().window, e->window);
+            QCOMPARE(event.properties.first().atom, e->atom);
+            ++properties;
+        } else {
+            QVERIFY(event.properties.isEmpty());
+        }
+    }
+    QVERIFY(properties >= s_sessionChanges * 4 / 6);
+}
+
+void NetEventReplayTest::testBrokenRecording()
+{
+    QFile broken(m_dir.filePath(QStringLiteral("broken.kxer")));
+    QVERIFY(broken.open(QIODevice::WriteOnly));
+    broken.write("KXER and something else");
+    broken.close();
+
+    KXUtils::EventRecording recording;
+    QVERIFY(recording.load(m_sessionFile));
+    QVERIFY(!recording.load(broken.fileName()));
+    QVERIFY(recording.events.isEmpty());
+    QVERIFY(!recording.load(m_dir.filePath(QStringLiteral("missing.kxer"))));
+}
+
+void NetEventReplayTest::testRecorderInstance()
+{
+    // KWindowSystem recreates its event filter when switching from desktop
+    // to window information, the recording has to go on in the same file
+    const QString fileName = m_dir.filePath(QStringLiteral("instance.kxer"));
+    qputenv("KWINDOWSYSTEM_RECORD_EVENTS", QFile::encodeName(fileName));
+    KXUtils::EventRecorder *recorder = KXUtils::EventRecorder::fromEnvironment(QX11Info::connection(), QX11Info::appRootWindow());
+    qunsetenv("KWINDOWSYSTEM_RECORD_EVENTS");
+    QVERIFY(recorder);
+    QVERIFY(recorder->isRecording());
+    QVERIFY(QFile::exists(fileName));
+
+    QCOMPARE(KXUtils::EventRecorder::fromEnvironment(QX11Info::connection(), QX11Info::appRootWindow()), recorder);
+    qputenv("KWINDOWSYSTEM_RECORD_EVENTS", QFile::encodeName(m_dir.filePath(QStringLiteral("other.kxer"))));
+    QCOMPARE(KXUtils::EventRecorder::fromEnvironment(QX11Info::connection(), QX11Info::appRootWindow()), recorder);
+    qunsetenv("KWINDOWSYSTEM_RECORD_EVENTS");
+    QVERIFY(!QFile::exists(m_dir.filePath(QStringLiteral("other.kxer"))));
+}
+
+void NetEventReplayTest::testReplay()
+{
+    KXUtils::EventRecording recording;
+    QVERIFY(recording.load(m_sessionFile));
+
+    // start from an empty root window, the recording sets everything
+    m_session->clearRootProperties();
+    QCoreApplication::processEvents();
+    QVERIFY(KWindowSystem::windows().isEmpty());
+
+    QSignalSpy addedSpy(KWindowSystem::self(), SIGNAL(windowAdded(WId)));
+    QSignalSpy changedSpy(KWindowSystem::self(), SIGNAL(windowChanged(WId)));
+    QSignalSpy activeSpy(KWindowSystem::self(), SIGNAL(activeWindowChanged(WId)));
+    QSignalSpy desktopSpy(KWindowSystem::self(), SIGNAL(currentDesktopChanged(int)));
+
+    // the events go through the native event filter of KWindowSystem, as if
+    // they came from the X server, which has the final state of the session
+    KXUtils::EventReplayer replayer(QX11Info::connection(), QX11Info::appRootWindow(), recording);
+    QCOMPARE(replayer.count(), recording.events.count());
+    replayer.applyProperties();
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    QVERIFY(dispatcher);
+    replayer.replay([dispatcher](xcb_generic_event_t *event) {
+        long result = 0;
+        dispatcher->filterNativeEvent(QByteArrayLiteral("xcb_generic_event_t"), event, &result);
+    });
+
+    QCOMPARE(KWindowSystem::numberOfDesktops(), 4);
+    QCOMPARE(KWindowSystem::currentDesktop(), m_session->finalDesktop);
+    QCOMPARE(KWindowSystem::activeWindow(), WId(replayer.window(m_session->finalActiveWindow)));
+    QCOMPARE(KWindowSystem::windows().count(), s_sessionWindows);
+    for (xcb_window_t window : qAsConst(m_session->windows)) {
+        QVERIFY(KWindowSystem::hasWId(replayer.window(window)));
+    }
+    QCOMPARE(KWindowSystem::stackingOrder().count(), s_sessionWindows);
+    QCOMPARE(KWindowSystem::stackingOrder().last(), WId(replayer.window(m_session->finalActiveWindow)));
+
+    QCOMPARE(addedSpy.count(), s_sessionWindows);
+    QVERIFY(changedSpy.count() > s_sessionChanges / 2);
+    QVERIFY(activeSpy.count() > 0);
+    QVERIFY(desktopSpy.count() > 0);
+
+    const xcb_window_t first = m_session->windows.first();
+    const KWindowInfo info(replayer.window(first), NET::WMName | NET::WMDesktop);
+    const NETWinInfo original(m_session->connection(), first, QX11Info::appRootWindow(), NET::WMName | NET::WMDesktop, NET::Properties2());
+    QCOMPARE(info.name(), QString::fromUtf8(original.name()));
+    QCOMPARE(info.desktop(), original.desktop());
+}
+
+QTEST_MAIN(NetEventReplayTest)
+
+#include "neteventreplay_unittest.moc"
@@ -0,0 +1,221 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef NETEVENTSESSION_H
+#define NETEVENTSESSION_H
+
+#include "nettesthelper.h"
+#include "kxeventrecording_p.h"
+
+#include <QString>
+#include <QVector>
+
+#include <xcb/xcb.h>
+
+static const int s_sessionWindows = 50;
+static const int s_sessionChanges = 2000;
+
+/**
+ * Records a small window manager session for the replay tests: windows get
+ * mapped, renamed, moved, activated and sent to other desktops. Like
+ * NETEventFilter, a second connection records the events and the property
+ * values right when it gets them.
+ *
+ * The windows stay around until the session is destroyed.
+ */
+class NetEventSession
+{
+public:
+    NetEventSession()
+        : m_connection(xcb_connect(nullptr, &m_screen))
+    {
+    }
+    ~NetEventSession()
+    {
+        xcb_disconnect(m_connection);
+    }
+
+    bool isValid() const
+    {
+        return !xcb_connection_has_error(m_connection);
+    }
+    xcb_connection_t *connection() const
+    {
+        return m_connection;
+    }
+
+    /**
+     * Runs the session and records it to @p fileName.
+     * @return @c false if the recording could not be written
+     */
+    bool record(const QString &fileName);
+
+    /**
+     * Deletes the root window properties the session set, so that a replay
+     * starts from scratch.
+     */
+    void clearRootProperties();
+
+    /// The windows of the session in the order they got mapped
+    QVector<xcb_window_t> windows;
+    xcb_window_t finalActiveWindow = XCB_WINDOW_NONE;
+    /// The current desktop at the end, counting from 1
+    int finalDesktop = 0;
+
+private:
+    static void sync(xcb_connection_t *c)
+    {
+        free(xcb_get_input_focus_reply(c, xcb_get_input_focus_unchecked(c), nullptr));
+    }
+
+    int m_screen = 0;
+    xcb_connection_t *m_connection;
+};
+
+inline bool NetEventSession::record(const QString &fileName)
+{
+    xcb_connection_t *c = m_connection;
+    const xcb_window_t root = KXUtils::rootWindow(c, m_screen);
+    KXUtils::Atom clientList(c, QByteArrayLiteral("_NET_CLIENT_LIST"));
+    KXUtils::Atom clientListStacking(c, QByteArrayLiteral("_NET_CLIENT_LIST_STACKING"));
+    KXUtils::Atom numberOfDesktops(c, QByteArrayLiteral("_NET_NUMBER_OF_DESKTOPS"));
+    KXUtils::Atom currentDesktop(c, QByteArrayLiteral("_NET_CURRENT_DESKTOP"));
+    KXUtils::Atom activeWindow(c, QByteArrayLiteral("_NET_ACTIVE_WINDOW"));
+    KXUtils::Atom wmName(c, QByteArrayLiteral("_NET_WM_NAME"));
+    KXUtils::Atom wmDesktop(c, QByteArrayLiteral("_NET_WM_DESKTOP"));
+    KXUtils::Atom wmState(c, QByteArrayLiteral("_NET_WM_STATE"));
+    KXUtils::Atom maxVert(c, QByteArrayLiteral("_NET_WM_STATE_MAXIMIZED_VERT"));
+    KXUtils::Atom maxHorz(c, QByteArrayLiteral("_NET_WM_STATE_MAXIMIZED_HORZ"));
+    KXUtils::Atom utf8String(c, QByteArrayLiteral("UTF8_STRING"));
+
+    // the observer is gone after the recording, so it does not queue up
+    // events during the replays
+    xcb_connection_t *observer = xcb_connect(nullptr, nullptr);
+    if (xcb_connection_has_error(observer)) {
+        xcb_disconnect(observer);
+        return false;
+    }
+    KXUtils::EventRecorder recorder(observer, root, fileName);
+    if (!recorder.isRecording()) {
+        xcb_disconnect(observer);
+        return false;
+    }
+
+    const uint32_t mask[] = { XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY };
+    xcb_change_window_attributes(observer, root, XCB_CW_EVENT_MASK, mask);
+    sync(observer);
+
+    auto step = [this, c, observer, root, &recorder]() {
+        sync(c);
+        sync(observer);
+        while (xcb_generic_event_t *event = xcb_poll_for_event(observer)) {
+            recorder.record(event);
+            if ((event->response_type & ~0x80) == XCB_PROPERTY_NOTIFY) {
+                xcb_property_notify_event_t *e = reinterpret_cast<xcb_property_notify_event_t *>(event);
+                if (e->window == root || windows.contains(e->window)) {
+                    recorder.recordProperty(e);
+                }
+            }
+            free(event);
+        }
+    };
+
+    uint32_t desktops = 4;
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, numberOfDesktops, XCB_ATOM_CARDINAL, 32, 1, &desktops);
+    step();
+
+    for (int i = 0; i < s_sessionWindows; ++i) {
+        const xcb_window_t w = xcb_generate_id(c);
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, w, root, 0, 0, 100, 100, 0,
+                          XCB_COPY_FROM_PARENT, XCB_COPY_FROM_PARENT, 0, nullptr);
+        sync(c);
+        xcb_change_window_attributes(observer, w, XCB_CW_EVENT_MASK, mask);
+        sync(observer);
+        windows << w;
+        const QByteArray name = QByteArrayLiteral("Window ") + QByteArray::number(i);
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, w, wmName, utf8String, 8, name.length(), name.constData());
+        const uint32_t desktop = i % desktops;
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, w, wmDesktop, XCB_ATOM_CARDINAL, 32, 1, &desktop);
+        xcb_map_window(c, w);
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, clientList, XCB_ATOM_WINDOW, 32, windows.count(), windows.constData());
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, clientListStacking, XCB_ATOM_WINDOW, 32, windows.count(), windows.constData());
+        step();
+    }
+
+    QVector<xcb_window_t> stacking = windows;
+    for (int i = 0; i < s_sessionChanges; ++i) {
+        const xcb_window_t w = windows.at((i * 7) % s_sessionWindows);
+        switch (i % 6) {
+        case 0: {
+            const QByteArray name = QByteArrayLiteral("Title ") + QByteArray::number(i);
+            xcb_change_property(c, XCB_PROP_MODE_REPLACE, w, wmName, utf8String, 8, name.length(), name.constData());
+            break;
+        }
+        case 1: {
+            const xcb_atom_t state[] = { maxVert, maxHorz };
+            xcb_change_property(c, XCB_PROP_MODE_REPLACE, w, wmState, XCB_ATOM_ATOM, 32, (i / 6) % 2 ? 2 : 0, state);
+            break;
+        }
+        case 2: {
+            const uint32_t desktop = (i / 6) % desktops;
+            xcb_change_property(c, XCB_PROP_MODE_REPLACE, w, wmDesktop, XCB_ATOM_CARDINAL, 32, 1, &desktop);
+            break;
+        }
+        case 3: {
+            const uint32_t position[] = { uint32_t(i % 1000), uint32_t(i % 700) };
+            xcb_configure_window(c, w, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, position);
+            break;
+        }
+        case 4:
+            // activate and raise
+            finalActiveWindow = w;
+            xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, activeWindow, XCB_ATOM_WINDOW, 32, 1, &w);
+            stacking.removeOne(w);
+            stacking.append(w);
+            xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, clientListStacking, XCB_ATOM_WINDOW, 32, stacking.count(), stacking.constData());
+            break;
+        case 5: {
+            const uint32_t desktop = (i / 6) % desktops;
+            finalDesktop = desktop + 1;
+            xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, currentDesktop, XCB_ATOM_CARDINAL, 32, 1, &desktop);
+            break;
+        }
+        }
+        step();
+    }
+
+    xcb_disconnect(observer);
+    return true;
+}
+
+inline void NetEventSession::clearRootProperties()
+{
+    const QByteArray names[] = {
+        QByteArrayLiteral("_NET_CLIENT_LIST"),
+        QByteArrayLiteral("_NET_CLIENT_LIST_STACKING"),
+        QByteArrayLiteral("_NET_NUMBER_OF_DESKTOPS"),
+        QByteArrayLiteral("_NET_CURRENT_DESKTOP"),
+        QByteArrayLiteral("_NET_ACTIVE_WINDOW")
+    };
+    const xcb_window_t root = KXUtils::rootWindow(m_connection, m_screen);
+    for (const QByteArray &name : names) {
+        KXUtils::Atom atom(m_connection, name);
+        xcb_delete_property(m_connection, root, atom);
+    }
+    sync(m_connection);
+}
+
+#endif
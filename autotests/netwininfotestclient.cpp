@@ -72,6 +72,7 @@ private Q_SLOTS:
 #endif
     void testExtendedStrut();
     void testIconGeometry();
+    void testIcons();
     void testWindowType_data();
     void testWindowType();
 
@@ -577,6 +578,90 @@ void NetWinInfoTestClient::testIconGeometry()
     QCOMPARE(geo.size.height, newGeo.size.height);
 }
 
+void NetWinInfoTestClient::testIcons()
+{
+    QVERIFY(connection());
+    ATOM(_NET_WM_ICON)
+    INFO
+
+    QVERIFY(!info.icon().data);
+
+    uint32_t pixels[] = {
+        0xff000001, 0xff000002, 0xff000003, 0xff000004,
+        0x80000005,
+        0x00000006, 0x40000007
+    };
+    NETIcon icons[3];
+    icons[0].size.width = 2;
+    icons[0].size.height = 2;
+    icons[0].data = reinterpret_cast<unsigned char *>(pixels);
+    icons[1].size.width = 1;
+    icons[1].size.height = 1;
+    icons[1].data = reinterpret_cast<unsigned char *>(pixels + 4);
+    icons[2].size.width = 2;
+    icons[2].size.height = 1;
+    icons[2].data = reinterpret_cast<unsigned char *>(pixels + 5);
+    info.setIcons(icons, 3);
+
+    // the icons got copied
+    pixels[0] = 0;
+    NETIcon icon = info.icon(2, 2);
+    QCOMPARE(icon.size.width, 2);
+    QCOMPARE(icon.size.height, 2);
+    QCOMPARE(reinterpret_cast<uint32_t *>(icon.data)[0], uint32_t(0xff000001));
+    icon = info.icon(1, 1);
+    QCOMPARE(icon.size.width, 1);
+    QCOMPARE(icon.size.height, 1);
+    const int *sizes = info.iconSizes();
+    QCOMPARE(sizes[0], 2);
+    QCOMPARE(sizes[1], 2);
+    QCOMPARE(sizes[2], 1);
+    QCOMPARE(sizes[3], 1);
+    QCOMPARE(sizes[4], 2);
+    QCOMPARE(sizes[5], 1);
+    QCOMPARE(sizes[6], 0);
+    QCOMPARE(sizes[7], 0);
+
+    // all sizes are in the X property
+    const uint32_t expected[] = {
+        2, 2, 0xff000001, 0xff000002, 0xff000003, 0xff000004,
+        1, 1, 0x80000005,
+        2, 1, 0x00000006, 0x40000007
+    };
+    {
+        GETPROP(XCB_ATOM_CARDINAL, 13, 32)
+        const uint32_t *data = reinterpret_cast<uint32_t *>(xcb_get_property_value(reply.data()));
+        for (int i = 0; i < 13; ++i) {
+            QCOMPARE(data[i], expected[i]);
+        }
+    }
+
+    // setIcons replaces all previous icons
+    info.setIcons(icons + 1, 1);
+    QCOMPARE(info.iconSizes()[0], 1);
+    QCOMPARE(info.iconSizes()[2], 0);
+    {
+        GETPROP(XCB_ATOM_CARDINAL, 3, 32)
+        const uint32_t *data = reinterpret_cast<uint32_t *>(xcb_get_property_value(reply.data()));
+        QCOMPARE(data[0], uint32_t(1));
+        QCOMPARE(data[1], uint32_t(1));
+        QCOMPARE(data[2], uint32_t(0x80000005));
+    }
+
+    // while setIcon can still append
+    info.setIcon(icons[2], false);
+    QCOMPARE(info.iconSizes()[2], 2);
+    QCOMPARE(info.iconSizes()[3], 1);
+    QCOMPARE(info.iconSizes()[4], 0);
+
+    // and wait for our event
+    waitForPropertyChange(&info, atom, NET::WMIcon);
+    icon = info.icon(2, 1);
+    QCOMPARE(icon.size.width, 2);
+    QCOMPARE(icon.size.height, 1);
+    QCOMPARE(reinterpret_cast<uint32_t *>(icon.data)[1], uint32_t(0x40000007));
+}
+
 Q_DECLARE_METATYPE(NET::WindowType)
 void NetWinInfoTestClient::testWindowType_data()
 {
@@ -0,0 +1,125 @@
+/* This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pluginindex_p.h"
+
+#include <QDir>
+#include <QFile>
+#include <QLibrary>
+#include <QPluginLoader>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// Compares looking up the installed platform plugins through KWindowSystemPluginIndex
+// with reading the metadata of every plugin, as KWindowSystem used to do on startup.
+// The lookup itself is verified by pluginindex_unittest.
+class PluginIndexBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void benchmarkLookup_data();
+    void benchmarkLookup();
+
+private:
+    QString indexFile() const
+    {
+        return m_tempDir.path() + QStringLiteral("/index.json");
+    }
+
+    QStringList m_directories;
+    QTemporaryDir m_tempDir;
+};
+
+// what KWindowSystemPluginWrapper used to do, read the metadata of all plugins
+static QStringList scanCandidates(const QStringList &directories, const QString &platformName)
+{
+    QStringList ret;
+    for (const QString &directory : directories) {
+        const QDir pluginDir(directory);
+        const auto entries = pluginDir.entryList(QDir::Files | QDir::NoDotAndDotDot);
+        for (const QString &entry : entries) {
+            const QString candidate = pluginDir.absoluteFilePath(entry);
+            if (!QLibrary::isLibrary(candidate)) {
+                continue;
+            }
+            QPluginLoader loader(candidate);
+            if (KWindowSystemPluginIndex::providesPlatform(loader.metaData(), platformName)) {
+                ret << candidate;
+            }
+        }
+    }
+    return ret;
+}
+
+void PluginIndexBenchmark::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+    m_directories = KWindowSystemPluginIndex::defaultDirectories();
+    if (m_directories.isEmpty()) {
+        QSKIP("No platform plugins found in the library paths");
+    }
+    qDebug() << "Plugin directories" << m_directories;
+}
+
+void PluginIndexBenchmark::benchmarkLookup_data()
+{
+    QTest::addColumn<QString>("platformName");
+    QTest::addColumn<QString>("method");
+
+    QTest::newRow("xcb, metadata of all plugins") << QStringLiteral("xcb") << QStringLiteral("scan");
+    QTest::newRow("xcb, index") << QStringLiteral("xcb") << QStringLiteral("index");
+    QTest::newRow("xcb, file name") << QStringLiteral("xcb") << QStringLiteral("preferred");
+    QTest::newRow("wayland, metadata of all plugins") << QStringLiteral("wayland") << QStringLiteral("scan");
+    QTest::newRow("wayland, index") << QStringLiteral("wayland") << QStringLiteral("index");
+    QTest::newRow("wayland, file name") << QStringLiteral("wayland") << QStringLiteral("preferred");
+    // e.g. the offscreen platform used by tests, there's no plugin to find
+    QTest::newRow("offscreen, metadata of all plugins") << QStringLiteral("offscreen") << QStringLiteral("scan");
+    QTest::newRow("offscreen, index") << QStringLiteral("offscreen") << QStringLiteral("index");
+}
+
+void PluginIndexBenchmark::benchmarkLookup()
+{
+    QFETCH(QString, platformName);
+    QFETCH(QString, method);
+
+    QFile::remove(indexFile());
+    // warm up the index
+    KWindowSystemPluginIndex(m_directories, indexFile()).candidates(platformName);
+
+    QBENCHMARK {
+        QStringList candidates;
+        if (method == QLatin1String("scan")) {
+            candidates = scanCandidates(m_directories, platformName);
+        } else {
+            KWindowSystemPluginIndex index(m_directories, indexFile());
+            if (method == QLatin1String("preferred")) {
+                candidates = index.preferredCandidates(platformName);
+            } else {
+                candidates = index.candidates(platformName);
+            }
+        }
+        // the metadata of the plugin to load is checked in any case
+        if (!candidates.isEmpty()) {
+            QPluginLoader loader(candidates.first());
+            QVERIFY(KWindowSystemPluginIndex::providesPlatform(loader.metaData(), platformName));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(PluginIndexBenchmark)
+
+#include "pluginindex_benchmark.moc"
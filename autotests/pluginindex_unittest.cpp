@@ -0,0 +1,342 @@
+/* This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pluginindex_p.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QLibrary>
+#include <QPluginLoader>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// Checks KWindowSystemPluginIndex on plugin directories set up in a temporary
+// directory, with a metadata only plugin copied in under several names.
+class PluginIndexTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void testCandidates_data();
+    void testCandidates();
+    void testPreferredCandidates();
+    void testIndexUsed();
+    void testPluginInstalled();
+    void testPluginRemoved();
+    void testPluginOverwritten();
+    void testOtherVersion();
+    void testDirectoryPruned();
+
+private:
+    QString indexFile() const
+    {
+        return m_tempDir.path() + QStringLiteral("/index.json");
+    }
+    QString installPlugin(const QString &directory, const QString &fileName);
+    QJsonObject readIndex() const;
+    void writeIndex(const QJsonObject &index);
+
+    QStringList m_directories;
+    QTemporaryDir m_tempDir;
+};
+
+// reads the metadata of all plugins, what the index has to give the same result as
+static QStringList scanCandidates(const QStringList &directories, const QString &platformName)
+{
+    QStringList ret;
+    for (const QString &directory : directories) {
+        const QDir pluginDir(directory);
+        const auto entries = pluginDir.entryList(QDir::Files | QDir::NoDotAndDotDot);
+        for (const QString &entry : entries) {
+            const QString candidate = pluginDir.absoluteFilePath(entry);
+            if (!QLibrary::isLibrary(candidate)) {
+                continue;
+            }
+            QPluginLoader loader(candidate);
+            if (KWindowSystemPluginIndex::providesPlatform(loader.metaData(), platformName)) {
+                ret << candidate;
+            }
+        }
+    }
+    return ret;
+}
+
+QString PluginIndexTest::installPlugin(const QString &directory, const QString &fileName)
+{
+    const QString path = directory + QLatin1Char('/') + fileName;
+    QFile::remove(path);
+    return QFile::copy(QStringLiteral(PLUGININDEX_TESTPLUGIN), path) ? path : QString();
+}
+
+void PluginIndexTest::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+    QVERIFY(QFile::exists(QStringLiteral(PLUGININDEX_TESTPLUGIN)));
+    for (const char *prefix : {"/first", "/second"}) {
+        const QString directory = m_tempDir.path() + QLatin1String(prefix) + QLatin1String("/kf5/org.kde.kwindowsystem.platforms");
+        QVERIFY(QDir().mkpath(directory));
+        m_directories << directory;
+    }
+    QVERIFY(!installPlugin(m_directories.at(0), QStringLiteral("KF5WindowSystemWaylandPlugin.so")).isEmpty());
+    QVERIFY(!installPlugin(m_directories.at(0), QStringLiteral("KF5WindowSystemX11Plugin.so")).isEmpty());
+    QVERIFY(!installPlugin(m_directories.at(0), QStringLiteral("other.so")).isEmpty());
+    QVERIFY(!installPlugin(m_directories.at(1), QStringLiteral("KF5WindowSystemKWaylandPlugin.so")).isEmpty());
+    QVERIFY(!installPlugin(m_directories.at(1), QStringLiteral("KF5WindowSystemX11Plugin.so")).isEmpty());
+
+    // files which are not plugins or no libraries at all
+    QFile notAPlugin(m_directories.at(0) + QStringLiteral("/notaplugin.so"));
+    QVERIFY(notAPlugin.open(QIODevice::WriteOnly));
+    notAPlugin.write("not a plugin");
+    notAPlugin.close();
+    QFile readme(m_directories.at(1) + QStringLiteral("/README"));
+    QVERIFY(readme.open(QIODevice::WriteOnly));
+    readme.close();
+}
+
+void PluginIndexTest::init()
+{
+    QFile::remove(indexFile());
+}
+
+QJsonObject PluginIndexTest::readIndex() const
+{
+    QFile file(indexFile());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void PluginIndexTest::writeIndex(const QJsonObject &index)
+{
+    QFile file(indexFile());
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(QJsonDocument(index).toJson());
+}
+
+void PluginIndexTest::testCandidates_data()
+{
+    QTest::addColumn<QString>("platformName");
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("xcb") << QStringLiteral("xcb") << 5;
+    QTest::newRow("XCB") << QStringLiteral("XCB") << 5;
+    QTest::newRow("wayland") << QStringLiteral("wayland") << 5;
+    QTest::newRow("offscreen") << QStringLiteral("offscreen") << 0;
+}
+
+void PluginIndexTest::testCandidates()
+{
+    QFETCH(QString, platformName);
+    QFETCH(int, count);
+    const QStringList expected = scanCandidates(m_directories, platformName);
+    QCOMPARE(expected.count(), count);
+
+    // without index
+    KWindowSystemPluginIndex withoutIndex(m_directories, QString());
+    QCOMPARE(withoutIndex.candidates(platformName), expected);
+    QVERIFY(!QFile::exists(indexFile()));
+
+    // creates the index
+    KWindowSystemPluginIndex index(m_directories, indexFile());
+    QCOMPARE(index.candidates(platformName), expected);
+    QVERIFY(QFile::exists(indexFile()));
+    QCOMPARE(readIndex().value(QStringLiteral("directories")).toObject().keys().count(), m_directories.count());
+
+    // and uses it
+    KWindowSystemPluginIndex cached(m_directories, indexFile());
+    QCOMPARE(cached.candidates(platformName), expected);
+}
+
+void PluginIndexTest::testPreferredCandidates()
+{
+    KWindowSystemPluginIndex index(m_directories, indexFile());
+    QCOMPARE(index.preferredCandidates(QStringLiteral("xcb")),
+             QStringList({m_directories.at(0) + QStringLiteral("/KF5WindowSystemX11Plugin.so"),
+                          m_directories.at(1) + QStringLiteral("/KF5WindowSystemX11Plugin.so")}));
+    // in the order of the directories, within one in the order of a listing
+    QCOMPARE(index.preferredCandidates(QStringLiteral("wayland")),
+             QStringList({m_directories.at(0) + QStringLiteral("/KF5WindowSystemWaylandPlugin.so"),
+                          m_directories.at(1) + QStringLiteral("/KF5WindowSystemKWaylandPlugin.so")}));
+    QVERIFY(index.preferredCandidates(QStringLiteral("offscreen")).isEmpty());
+    // no metadata was read for that
+    QVERIFY(!QFile::exists(indexFile()));
+
+    // the same order as the full lookup
+    for (const QString &platformName : {QStringLiteral("xcb"), QStringLiteral("wayland")}) {
+        const QStringList candidates = index.candidates(platformName);
+        int last = -1;
+        const auto preferred = index.preferredCandidates(platformName);
+        for (const QString &candidate : preferred) {
+            const int position = candidates.indexOf(candidate);
+            QVERIFY(position > last);
+            last = position;
+        }
+    }
+}
+
+void PluginIndexTest::testIndexUsed()
+{
+    KWindowSystemPluginIndex index(m_directories, indexFile());
+    const QStringList expected = scanCandidates(m_directories, QStringLiteral("xcb"));
+    QCOMPARE(index.candidates(QStringLiteral("xcb")), expected);
+
+    // an unchanged directory is not read again, so what the index says counts
+    QJsonObject contents = readIndex();
+    QJsonObject directories = contents.value(QStringLiteral("directories")).toObject();
+    QJsonObject entry = directories.value(m_directories.first()).toObject();
+    QJsonArray plugins = entry.value(QStringLiteral("plugins")).toArray();
+    QVERIFY(!plugins.isEmpty());
+    QJsonObject plugin = plugins.first().toObject();
+    plugin.insert(QStringLiteral("platforms"), QJsonArray{QStringLiteral("fake")});
+    plugins.replace(0, plugin);
+    entry.insert(QStringLiteral("plugins"), plugins);
+    directories.insert(m_directories.first(), entry);
+    contents.insert(QStringLiteral("directories"), directories);
+    writeIndex(contents);
+    const QString fake = m_directories.first() + QLatin1Char('/') + plugin.value(QStringLiteral("file")).toString();
+    QCOMPARE(index.candidates(QStringLiteral("fake")), QStringList{fake});
+
+    // as well as once a plugin looks different
+    plugin.insert(QStringLiteral("size"), 0);
+    plugins.replace(0, plugin);
+    entry.insert(QStringLiteral("plugins"), plugins);
+    directories.insert(m_directories.first(), entry);
+    contents.insert(QStringLiteral("directories"), directories);
+    writeIndex(contents);
+    QVERIFY(index.candidates(QStringLiteral("fake")).isEmpty());
+    QCOMPARE(index.candidates(QStringLiteral("xcb")), expected);
+
+    plugin.insert(QStringLiteral("size"), double(QFileInfo(fake).size()));
+    plugins.replace(0, plugin);
+    entry.insert(QStringLiteral("plugins"), plugins);
+    directories.insert(m_directories.first(), entry);
+    contents.insert(QStringLiteral("directories"), directories);
+    writeIndex(contents);
+    QCOMPARE(index.candidates(QStringLiteral("fake")), QStringList{fake});
+
+    // once the modification time differs the directory is read again
+    entry.insert(QStringLiteral("modified"), 0);
+    directories.insert(m_directories.first(), entry);
+    contents.insert(QStringLiteral("directories"), directories);
+    writeIndex(contents);
+    QVERIFY(index.candidates(QStringLiteral("fake")).isEmpty());
+    QCOMPARE(index.candidates(QStringLiteral("xcb")), expected);
+}
+
+void PluginIndexTest::testPluginInstalled()
+{
+    KWindowSystemPluginIndex index(m_directories, indexFile());
+    const QStringList before = index.candidates(QStringLiteral("xcb"));
+    QCOMPARE(before, scanCandidates(m_directories, QStringLiteral("xcb")));
+
+    // installing changes the modification time of the directory, which may
+    // have a coarse resolution
+    const QString directory = m_directories.at(1);
+    const QDateTime modified = QFileInfo(directory).lastModified();
+    const QString path = directory + QStringLiteral("/installed.so");
+    QTRY_VERIFY_WITH_TIMEOUT(!installPlugin(directory, QStringLiteral("installed.so")).isEmpty()
+                             && QFileInfo(directory).lastModified() != modified, 5000);
+
+    const QStringList after = index.candidates(QStringLiteral("xcb"));
+    QCOMPARE(after, scanCandidates(m_directories, QStringLiteral("xcb")));
+    QVERIFY(after.contains(path));
+    QCOMPARE(after.count(), before.count() + 1);
+}
+
+void PluginIndexTest::testPluginRemoved()
+{
+    const QString directory = m_directories.at(1);
+    const QString path = directory + QStringLiteral("/removed.so");
+    QVERIFY(!installPlugin(directory, QStringLiteral("removed.so")).isEmpty());
+    KWindowSystemPluginIndex index(m_directories, indexFile());
+    QVERIFY(index.candidates(QStringLiteral("xcb")).contains(path));
+
+    const QDateTime modified = QFileInfo(directory).lastModified();
+    const auto remove = [&]() {
+        if (!QFile::exists(path)) {
+            installPlugin(directory, QStringLiteral("removed.so"));
+        }
+        return QFile::remove(path) && QFileInfo(directory).lastModified() != modified;
+    };
+    QTRY_VERIFY_WITH_TIMEOUT(remove(), 5000);
+
+    const QStringList candidates = index.candidates(QStringLiteral("xcb"));
+    QVERIFY(!candidates.contains(path));
+    QCOMPARE(candidates, scanCandidates(m_directories, QStringLiteral("xcb")));
+}
+
+void PluginIndexTest::testPluginOverwritten()
+{
+    // a file which is no plugin, replaced by one in place
+    const QString directory = m_directories.at(0);
+    const QString path = directory + QStringLiteral("/overwritten.so");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("not a plugin yet");
+    file.close();
+    KWindowSystemPluginIndex index(m_directories, indexFile());
+    QVERIFY(!index.candidates(QStringLiteral("xcb")).contains(path));
+
+    const QDateTime modified = QFileInfo(directory).lastModified();
+    QFile plugin(QStringLiteral(PLUGININDEX_TESTPLUGIN));
+    QVERIFY(plugin.open(QIODevice::ReadOnly));
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QVERIFY(file.write(plugin.readAll()) > 0);
+    file.close();
+    // the directory does not tell about it
+    QCOMPARE(QFileInfo(directory).lastModified(), modified);
+
+    const QStringList candidates = index.candidates(QStringLiteral("xcb"));
+    QVERIFY(candidates.contains(path));
+    QCOMPARE(candidates, scanCandidates(m_directories, QStringLiteral("xcb")));
+    QVERIFY(QFile::remove(path));
+}
+
+void PluginIndexTest::testOtherVersion()
+{
+    KWindowSystemPluginIndex index(m_directories, indexFile());
+    const QStringList expected = index.candidates(QStringLiteral("xcb"));
+
+    // everything is read again with an index from another version
+    QJsonObject contents = readIndex();
+    contents.insert(QStringLiteral("version"), 0);
+    contents.insert(QStringLiteral("directories"), QJsonObject());
+    writeIndex(contents);
+    QCOMPARE(index.candidates(QStringLiteral("xcb")), expected);
+    QCOMPARE(readIndex().value(QStringLiteral("version")).toInt(), 2);
+    QCOMPARE(readIndex().value(QStringLiteral("directories")).toObject().keys().count(), m_directories.count());
+}
+
+void PluginIndexTest::testDirectoryPruned()
+{
+    KWindowSystemPluginIndex both(m_directories, indexFile());
+    both.candidates(QStringLiteral("xcb"));
+    QCOMPARE(readIndex().value(QStringLiteral("directories")).toObject().keys().count(), 2);
+
+    // e.g. after the library paths changed
+    KWindowSystemPluginIndex first(QStringList{m_directories.at(0)}, indexFile());
+    QCOMPARE(first.candidates(QStringLiteral("xcb")), scanCandidates(QStringList{m_directories.at(0)}, QStringLiteral("xcb")));
+    QCOMPARE(readIndex().value(QStringLiteral("directories")).toObject().keys(), QStringList{m_directories.at(0)});
+}
+
+QTEST_GUILESS_MAIN(PluginIndexTest)
+
+#include "pluginindex_unittest.moc"
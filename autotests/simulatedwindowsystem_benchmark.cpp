@@ -0,0 +1,197 @@
+/* This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kwindowsystemsimulation.h"
+
+#include <kwindowinfo.h>
+#include <kwindowsystem.h>
+
+#include <QGuiApplication>
+#include <QtPlugin>
+#include <QtTest>
+
+Q_IMPORT_PLUGIN(SimulatedPlugin)
+
+// the simulated backend is used on the offscreen platform
+static void useOffscreenPlatform()
+{
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+}
+Q_CONSTRUCTOR_FUNCTION(useOffscreenPlatform)
+
+Q_DECLARE_METATYPE(NET::Properties)
+Q_DECLARE_METATYPE(NET::Properties2)
+
+static const NET::Properties s_taskManagerProperties = NET::WMName | NET::WMVisibleName | NET::WMDesktop
+                                                       | NET::WMState | NET::XAWMState | NET::WMWindowType;
+static const NET::Properties2 s_taskManagerProperties2 = NET::WM2WindowClass | NET::WM2DesktopFileName | NET::WM2TransientFor;
+
+// Uses KWindowSystem the way task managers and pagers do, against thousands
+// of simulated windows instead of an X server.
+class SimulatedWindowSystemBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void benchmarkTaskManager_data();
+    void benchmarkTaskManager();
+    void benchmarkPager_data();
+    void benchmarkPager();
+    void benchmarkWindowStorm_data();
+    void benchmarkWindowStorm();
+    void benchmarkPropertyChurn_data();
+    void benchmarkPropertyChurn();
+
+private:
+    KWindowSystemSimulation *m_simulation = nullptr;
+};
+
+void SimulatedWindowSystemBenchmark::initTestCase()
+{
+    qRegisterMetaType<NET::Properties>();
+    qRegisterMetaType<NET::Properties2>();
+    QCOMPARE(QGuiApplication::platformName(), QStringLiteral("offscreen"));
+    m_simulation = KWindowSystemSimulation::self();
+}
+
+void SimulatedWindowSystemBenchmark::init()
+{
+    m_simulation->reset();
+}
+
+static void addWindowCountRows()
+{
+    QTest::addColumn<int>("windows");
+
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkTaskManager_data()
+{
+    addWindowCountRows();
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkTaskManager()
+{
+    QFETCH(int, windows);
+    m_simulation->windowStorm(windows);
+
+    // rebuilding the list of tasks on the current desktop
+    QBENCHMARK {
+        QList<WId> tasks;
+        const auto ids = KWindowSystem::windows();
+        for (WId id : ids) {
+            KWindowInfo info(id, s_taskManagerProperties, s_taskManagerProperties2);
+            if (!info.valid() || !info.isOnCurrentDesktop() || info.hasState(NET::SkipTaskbar)) {
+                continue;
+            }
+            if (info.windowType(NET::NormalMask | NET::DialogMask) == NET::Dialog && info.transientFor()) {
+                continue;
+            }
+            if (!info.visibleNameWithState().isEmpty() && !info.desktopFileName().isEmpty()) {
+                tasks << id;
+            }
+        }
+    }
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkPager_data()
+{
+    addWindowCountRows();
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkPager()
+{
+    QFETCH(int, windows);
+    m_simulation->windowStorm(windows);
+
+    // laying out the windows of all desktops, from bottom to top
+    QBENCHMARK {
+        QVector<QList<QRect>> desktops(KWindowSystem::numberOfDesktops());
+        const auto ids = KWindowSystem::stackingOrder();
+        for (WId id : ids) {
+            KWindowInfo info(id, NET::WMDesktop | NET::WMFrameExtents | NET::WMState | NET::XAWMState | NET::WMWindowType);
+            if (info.isMinimized() || info.windowType(NET::NormalMask | NET::DialogMask) == NET::Unknown) {
+                continue;
+            }
+            for (int desktop = 1; desktop <= desktops.count(); ++desktop) {
+                if (info.isOnDesktop(desktop)) {
+                    desktops[desktop - 1] << info.frameGeometry();
+                }
+            }
+        }
+    }
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkWindowStorm_data()
+{
+    addWindowCountRows();
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkWindowStorm()
+{
+    QFETCH(int, windows);
+
+    // a task manager looking at every new window
+    QHash<WId, QString> tasks;
+    QMetaObject::Connection connection = connect(KWindowSystem::self(), &KWindowSystem::windowAdded, this, [&tasks](WId id) {
+        KWindowInfo info(id, s_taskManagerProperties, s_taskManagerProperties2);
+        if (info.valid()) {
+            tasks.insert(id, info.visibleNameWithState());
+        }
+    });
+    QBENCHMARK {
+        m_simulation->reset();
+        m_simulation->windowStorm(windows);
+    }
+    disconnect(connection);
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkPropertyChurn_data()
+{
+    addWindowCountRows();
+}
+
+void SimulatedWindowSystemBenchmark::benchmarkPropertyChurn()
+{
+    QFETCH(int, windows);
+    m_simulation->windowStorm(windows);
+
+    // a task manager updating the changed properties of its tasks
+    QHash<WId, QString> tasks;
+    QMetaObject::Connection connection = connect(KWindowSystem::self(), static_cast<void (KWindowSystem::*)(WId, NET::Properties, NET::Properties2)>(&KWindowSystem::windowChanged),
+                                                 this, [&tasks](WId id, NET::Properties properties, NET::Properties2 properties2) {
+        if ((properties & s_taskManagerProperties) || (properties2 & s_taskManagerProperties2)) {
+            KWindowInfo info(id, properties & s_taskManagerProperties, properties2 & s_taskManagerProperties2);
+            if (info.valid() && (properties & NET::WMVisibleName)) {
+                tasks.insert(id, info.visibleName());
+            }
+        }
+    });
+    quint32 seed = 0;
+    QBENCHMARK {
+        m_simulation->propertyChurn(10000, seed++);
+    }
+    disconnect(connection);
+}
+
+QTEST_MAIN(SimulatedWindowSystemBenchmark)
+
+#include "simulatedwindowsystem_benchmark.moc"
@@ -0,0 +1,259 @@
+/* This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kwindowsystemsimulation.h"
+
+#include <kwindowinfo.h>
+#include <kwindowsystem.h>
+
+#include <QGuiApplication>
+#include <QSignalSpy>
+#include <QtPlugin>
+#include <QtTest>
+
+Q_IMPORT_PLUGIN(SimulatedPlugin)
+
+// the simulated backend is used on the offscreen platform
+static void useOffscreenPlatform()
+{
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+}
+Q_CONSTRUCTOR_FUNCTION(useOffscreenPlatform)
+
+Q_DECLARE_METATYPE(NET::Properties)
+Q_DECLARE_METATYPE(NET::Properties2)
+
+static const NET::Properties s_taskManagerProperties = NET::WMName | NET::WMVisibleName | NET::WMDesktop
+                                                       | NET::WMState | NET::XAWMState | NET::WMWindowType;
+static const NET::Properties2 s_taskManagerProperties2 = NET::WM2WindowClass | NET::WM2DesktopFileName | NET::WM2TransientFor;
+
+// Checks that the simulation behaves like a window manager would, see
+// simulatedwindowsystem_benchmark.cpp for using it under load.
+class SimulatedWindowSystemTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void testWindows();
+    void testStackingOrder();
+    void testDesktops();
+    void testStruts();
+    void testDeterministicLoad();
+
+private:
+    KWindowSystemSimulation *m_simulation = nullptr;
+};
+
+void SimulatedWindowSystemTest::initTestCase()
+{
+    qRegisterMetaType<NET::Properties>();
+    qRegisterMetaType<NET::Properties2>();
+    QCOMPARE(QGuiApplication::platformName(), QStringLiteral("offscreen"));
+    m_simulation = KWindowSystemSimulation::self();
+}
+
+void SimulatedWindowSystemTest::init()
+{
+    m_simulation->reset();
+}
+
+void SimulatedWindowSystemTest::testWindows()
+{
+    QSignalSpy addedSpy(KWindowSystem::self(), &KWindowSystem::windowAdded);
+    QSignalSpy removedSpy(KWindowSystem::self(), &KWindowSystem::windowRemoved);
+    QSignalSpy changedSpy(KWindowSystem::self(), static_cast<void (KWindowSystem::*)(WId, NET::Properties, NET::Properties2)>(&KWindowSystem::windowChanged));
+    QSignalSpy stackingSpy(KWindowSystem::self(), &KWindowSystem::stackingOrderChanged);
+    QSignalSpy activeSpy(KWindowSystem::self(), &KWindowSystem::activeWindowChanged);
+
+    KWindowSystemSimulation::Window window;
+    window.name = QStringLiteral("foo");
+    window.windowClassClass = QByteArrayLiteral("Bar");
+    const WId first = m_simulation->addWindow(window);
+    window.name = QStringLiteral("bar");
+    const WId second = m_simulation->addWindow(window);
+    QCOMPARE(addedSpy.count(), 2);
+    QCOMPARE(addedSpy.first().first().value<WId>(), first);
+    QCOMPARE(stackingSpy.count(), 2);
+    QCOMPARE(KWindowSystem::windows(), QList<WId>({first, second}));
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({first, second}));
+    QVERIFY(KWindowSystem::hasWId(first));
+
+    KWindowInfo info(first, NET::WMName | NET::WMVisibleName, NET::WM2WindowClass);
+    QVERIFY(info.valid());
+    QCOMPARE(info.name(), QStringLiteral("foo"));
+    QCOMPARE(info.visibleName(), QStringLiteral("foo"));
+    QCOMPARE(info.windowClassClass(), QByteArrayLiteral("Bar"));
+
+    // changes through KWindowSystem are announced like on X11
+    KWindowSystem::setOnDesktop(first, 2);
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.last().at(0).value<WId>(), first);
+    QCOMPARE(changedSpy.last().at(1).value<NET::Properties>(), NET::Properties(NET::WMDesktop));
+    QCOMPARE(KWindowInfo(first, NET::WMDesktop).desktop(), 2);
+
+    KWindowSystem::minimizeWindow(first);
+    QCOMPARE(changedSpy.count(), 2);
+    QVERIFY(KWindowInfo(first, NET::WMState | NET::XAWMState).isMinimized());
+    QCOMPARE(KWindowInfo(first, NET::WMState | NET::XAWMState | NET::WMVisibleName).visibleNameWithState(), QStringLiteral("(foo)"));
+
+    // activating unminimizes and raises
+    KWindowSystem::activateWindow(first);
+    QCOMPARE(KWindowSystem::activeWindow(), first);
+    QCOMPARE(activeSpy.count(), 1);
+    QVERIFY(!KWindowInfo(first, NET::WMState | NET::XAWMState).isMinimized());
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({second, first}));
+    QCOMPARE(stackingSpy.count(), 3);
+
+    m_simulation->removeWindow(first);
+    QCOMPARE(removedSpy.count(), 1);
+    QCOMPARE(activeSpy.count(), 2);
+    QCOMPARE(KWindowSystem::activeWindow(), WId(0));
+    QCOMPARE(KWindowSystem::windows(), QList<WId>({second}));
+    QVERIFY(!KWindowInfo(first, NET::WMName).valid());
+}
+
+void SimulatedWindowSystemTest::testStackingOrder()
+{
+    QSignalSpy stackingSpy(KWindowSystem::self(), &KWindowSystem::stackingOrderChanged);
+    const WId first = m_simulation->addWindow();
+    const WId second = m_simulation->addWindow();
+    const WId third = m_simulation->addWindow();
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({first, second, third}));
+    QCOMPARE(stackingSpy.count(), 3);
+
+    // raising the top or lowering the bottom window changes nothing
+    m_simulation->raiseWindow(third);
+    m_simulation->lowerWindow(first);
+    QCOMPARE(stackingSpy.count(), 3);
+
+    m_simulation->lowerWindow(third);
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({third, first, second}));
+    m_simulation->raiseWindow(first);
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({third, second, first}));
+    m_simulation->lowerWindow(second);
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({second, third, first}));
+    QCOMPARE(stackingSpy.count(), 6);
+
+    // new windows go on top, removed ones leave no gap
+    m_simulation->removeWindow(third);
+    const WId fourth = m_simulation->addWindow();
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({second, first, fourth}));
+    m_simulation->lowerWindow(fourth);
+    QCOMPARE(KWindowSystem::stackingOrder(), QList<WId>({fourth, second, first}));
+    QCOMPARE(stackingSpy.count(), 9);
+
+    // the mapping order is independent of the stacking order
+    QCOMPARE(KWindowSystem::windows(), QList<WId>({first, second, fourth}));
+
+    m_simulation->raiseWindow(third);
+    QCOMPARE(stackingSpy.count(), 9);
+}
+
+void SimulatedWindowSystemTest::testDesktops()
+{
+    QSignalSpy currentSpy(KWindowSystem::self(), &KWindowSystem::currentDesktopChanged);
+    QSignalSpy numberSpy(KWindowSystem::self(), &KWindowSystem::numberOfDesktopsChanged);
+    QSignalSpy namesSpy(KWindowSystem::self(), &KWindowSystem::desktopNamesChanged);
+
+    QCOMPARE(KWindowSystem::numberOfDesktops(), 4);
+    QCOMPARE(KWindowSystem::currentDesktop(), 1);
+    QCOMPARE(KWindowSystem::desktopName(3), QStringLiteral("Desktop 3"));
+
+    KWindowSystem::setCurrentDesktop(4);
+    QCOMPARE(currentSpy.count(), 1);
+    QCOMPARE(KWindowSystem::currentDesktop(), 4);
+
+    KWindowSystem::setDesktopName(2, QStringLiteral("Mail"));
+    QCOMPARE(namesSpy.count(), 1);
+    QCOMPARE(KWindowSystem::desktopName(2), QStringLiteral("Mail"));
+
+    KWindowSystemSimulation::Window window;
+    window.desktop = 4;
+    const WId id = m_simulation->addWindow(window);
+    window.desktop = NET::OnAllDesktops;
+    const WId sticky = m_simulation->addWindow(window);
+
+    // removing desktops moves their windows and the current desktop
+    m_simulation->setNumberOfDesktops(2);
+    QCOMPARE(numberSpy.count(), 1);
+    QCOMPARE(currentSpy.count(), 2);
+    QCOMPARE(KWindowSystem::currentDesktop(), 2);
+    QCOMPARE(KWindowInfo(id, NET::WMDesktop).desktop(), 2);
+    QVERIFY(KWindowInfo(sticky, NET::WMDesktop).onAllDesktops());
+    QVERIFY(KWindowInfo(sticky, NET::WMDesktop).isOnCurrentDesktop());
+}
+
+void SimulatedWindowSystemTest::testStruts()
+{
+    QSignalSpy strutSpy(KWindowSystem::self(), &KWindowSystem::strutChanged);
+    QSignalSpy workAreaSpy(KWindowSystem::self(), &KWindowSystem::workAreaChanged);
+    QCOMPARE(KWindowSystem::workArea(), QRect(0, 0, 1920, 1080));
+
+    KWindowSystemSimulation::Window panel;
+    panel.windowType = NET::Dock;
+    panel.desktop = NET::OnAllDesktops;
+    const WId id = m_simulation->addWindow(panel);
+    KWindowSystem::setStrut(id, 0, 0, 0, 40);
+    QCOMPARE(strutSpy.count(), 1);
+    QCOMPARE(workAreaSpy.count(), 1);
+    QCOMPARE(KWindowSystem::workArea(), QRect(0, 0, 1920, 1040));
+    QCOMPARE(KWindowSystem::workArea(QList<WId>({id})), QRect(0, 0, 1920, 1080));
+    QCOMPARE(KWindowInfo(id, NET::Properties(), NET::WM2ExtendedStrut).extendedStrut().bottom_width, 40);
+
+    KWindowSystemSimulation::Window sidebar;
+    sidebar.desktop = 2;
+    const WId sidebarId = m_simulation->addWindow(sidebar);
+    KWindowSystem::setExtendedStrut(sidebarId, 100, 0, 1079, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    QCOMPARE(KWindowSystem::workArea(1), QRect(0, 0, 1920, 1040));
+    QCOMPARE(KWindowSystem::workArea(2), QRect(100, 0, 1820, 1040));
+
+    m_simulation->removeWindow(id);
+    QCOMPARE(strutSpy.count(), 3);
+    QCOMPARE(KWindowSystem::workArea(2), QRect(100, 0, 1820, 1080));
+}
+
+void SimulatedWindowSystemTest::testDeterministicLoad()
+{
+    auto snapshot = [this]() {
+        QStringList ret;
+        const auto windows = KWindowSystem::windows();
+        for (WId id : windows) {
+            KWindowInfo info(id, s_taskManagerProperties | NET::WMGeometry, s_taskManagerProperties2);
+            ret << QStringLiteral("%1 %2 %3 %4").arg(info.name()).arg(info.desktop()).arg(int(info.state())).arg(info.geometry().x());
+        }
+        return ret;
+    };
+
+    m_simulation->windowStorm(200, 42);
+    m_simulation->propertyChurn(1000, 7);
+    const QStringList first = snapshot();
+    QCOMPARE(first.count(), 200);
+
+    m_simulation->reset();
+    m_simulation->windowStorm(200, 42);
+    m_simulation->propertyChurn(1000, 7);
+    QCOMPARE(snapshot(), first);
+
+    m_simulation->reset();
+    m_simulation->windowStorm(200, 43);
+    QVERIFY(snapshot() != first);
+}
+
+QTEST_MAIN(SimulatedWindowSystemTest)
+
+#include "simulatedwindowsystem_unittest.moc"
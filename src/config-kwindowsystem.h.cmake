@@ -9,5 +9,14 @@
 /* Define to 1 if you have the Xrender library */
 #cmakedefine01 KWINDOWSYSTEM_HAVE_XRENDER
 
+/* Define to 1 if you have the xcb-xfixes library */
+#cmakedefine01 KWINDOWSYSTEM_HAVE_XCB_XFIXES
+
+/* Define to 1 if you have the xcb-shm library */
+#cmakedefine01 KWINDOWSYSTEM_HAVE_XCB_SHM
+
+/* Define to 1 if the X11 platform plugin is built into the library */
+#cmakedefine01 KWINDOWSYSTEM_BUILTIN_X11_PLUGIN
+
 /* Path to xcb plugin */
 #define XCB_PLUGIN_PATH "${KDE_INSTALL_FULL_PLUGINDIR}/kf5/org.kde.kwindowsystem.platforms/KF5WindowSystemX11Plugin.so"
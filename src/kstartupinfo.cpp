@@ -42,6 +42,11 @@ DEALINGS IN THE SOFTWARE.
 #include <QWidget>
 #endif
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringView>
+
+#include <limits>
 
 #include <config-kwindowsystem.h> // KWINDOWSYSTEM_HAVE_X11
 
@@ -83,20 +88,196 @@ static const char NET_STARTUP_ENV[] = "DESKTOP_STARTUP_ID";
 
 static QByteArray s_startup_id;
 
-static long get_num(const QString &item_P);
-static QString get_str(const QString &item_P);
-static QByteArray get_cstr(const QString &item_P);
-static QStringList get_fields(const QString &txt_P);
 static QString escape_str(const QString &str_P);
+#if KWINDOWSYSTEM_HAVE_X11
+static QByteArray window_startup_id(const NETWinInfo &info);
+#endif
+
+namespace
+{
+/**
+ * Single pass tokenizer for the KEY=VALUE fields of startup notification messages.
+ *
+ * Fields are separated by whitespace outside of quotes, quotes are removed and
+ * a backslash escapes the next character. As the message used to be simplified()
+ * before splitting it, whitespace runs also collapse into one space inside quotes.
+ *
+ * Keys and values are views into the message whenever a field contains neither
+ * quotes nor escapes, otherwise into a buffer that is reused for all fields.
+ */
+class StartupInfoTokenizer
+{
+public:
+    explicit StartupInfoTokenizer(QStringView text)
+        : m_text(text)
+        , m_pos(0)
+        , m_end(text.size())
+    {
+        while (m_pos < m_end && m_text[m_pos].isSpace()) {
+            ++m_pos;
+        }
+        while (m_end > m_pos && m_text[m_end - 1].isSpace()) {
+            --m_end;
+        }
+    }
+
+    /**
+     * Advances to the next field, returns false when all fields have been read.
+     */
+    bool next()
+    {
+        if (m_pos > m_end) {
+            return false;
+        }
+        const int start = m_pos;
+        bool plain = true;
+        bool in = false;
+        bool escape = false;
+        auto unplain = [this, &plain, start]() {
+            if (plain) {
+                m_buffer.resize(0);
+                m_buffer.append(m_text.data() + start, m_pos - start);
+                plain = false;
+            }
+        };
+        while (m_pos < m_end) {
+            const QChar c = m_text[m_pos];
+            if (c.isSpace()) {
+                int runEnd = m_pos + 1;
+                while (runEnd < m_end && m_text[runEnd].isSpace()) {
+                    ++runEnd;
+                }
+                if (!escape && !in) {
+                    setField(plain ? m_text.mid(start, m_pos - start) : QStringView(m_buffer));
+                    m_pos = runEnd;
+                    return true;
+                }
+                // escaped or quoted, fields with either are never plain
+                m_buffer += QLatin1Char(' ');
+                escape = false;
+                m_pos = runEnd;
+                continue;
+            }
+            if (escape) {
+                if (!plain) {
+                    m_buffer += c;
+                }
+                escape = false;
+            } else if (c == QLatin1Char('\\')) {
+                unplain();
+                escape = true;
+            } else if (c == QLatin1Char('\"')) {
+                unplain();
+                in = !in;
+            } else if (!plain) {
+                m_buffer += c;
+            }
+            ++m_pos;
+        }
+        setField(plain ? m_text.mid(start, m_pos - start) : QStringView(m_buffer));
+        m_pos = m_end + 1;
+        return true;
+    }
+
+    /**
+     * The part of the current field before the first '=', empty if there is none.
+     */
+    QStringView key() const
+    {
+        return m_key;
+    }
+
+    /**
+     * The part of the current field after the first '='.
+     */
+    QStringView value() const
+    {
+        return m_value;
+    }
+
+    bool keyIs(const char *name) const
+    {
+        int i = 0;
+        for (; name[i] != '\0'; ++i) {
+            if (i >= m_key.size() || m_key[i] != QLatin1Char(name[i])) {
+                return false;
+            }
+        }
+        return i == m_key.size();
+    }
+
+    /**
+     * The value as a number, like QString::toLong() would parse it.
+     */
+    long number() const
+    {
+        int pos = 0;
+        int end = m_value.size();
+        while (pos < end && m_value[pos].isSpace()) {
+            ++pos;
+        }
+        while (end > pos && m_value[end - 1].isSpace()) {
+            --end;
+        }
+        bool negative = false;
+        if (pos < end && (m_value[pos] == QLatin1Char('-') || m_value[pos] == QLatin1Char('+'))) {
+            negative = m_value[pos] == QLatin1Char('-');
+            ++pos;
+        }
+        if (pos == end) {
+            return 0;
+        }
+        // accumulate negatively, so that the minimum value does not overflow
+        const long limit = std::numeric_limits<long>::min();
+        long result = 0;
+        for (; pos < end; ++pos) {
+            const ushort digit = m_value[pos].unicode() - '0';
+            if (digit > 9 || result < (limit + long(digit)) / 10) {
+                return 0;
+            }
+            result = result * 10 - digit;
+        }
+        if (!negative) {
+            if (result == limit) {
+                return 0;
+            }
+            result = -result;
+        }
+        return result;
+    }
+
+private:
+    void setField(QStringView field)
+    {
+        for (int i = 0; i < field.size(); ++i) {
+            if (field[i] == QLatin1Char('=')) {
+                m_key = field.left(i);
+                m_value = field.mid(i + 1);
+                return;
+            }
+        }
+        m_key = QStringView();
+        m_value = QStringView();
+    }
+
+    QStringView m_text;
+    int m_pos;
+    int m_end;
+    QString m_buffer;
+    QStringView m_key;
+    QStringView m_value;
+};
+}
 
 class Q_DECL_HIDDEN KStartupInfo::Data
     : public KStartupInfoData
 {
 public:
-    Data() : age(0) {} // just because it's in a QMap
+    Data() : touched(0), deadline(-1) {} // just because it's in a QMap
     Data(const QString &txt_P)
-        : KStartupInfoData(txt_P), age(0) {}
-    unsigned int age;
+        : KStartupInfoData(txt_P), touched(0), deadline(-1) {}
+    qint64 touched; // when the info was last updated, in msecs of Private::clock
+    qint64 deadline; // key in Private::deadlines, -1 if not scheduled
 };
 
 struct Q_DECL_HIDDEN KStartupInfoId::Private
@@ -104,6 +285,7 @@ struct Q_DECL_HIDDEN KStartupInfoId::Private
     Private() : id("") {}
 
     QString to_text() const;
+    void set_field(const StartupInfoTokenizer &field);
 
     QByteArray id; // id
 };
@@ -114,6 +296,7 @@ struct Q_DECL_HIDDEN KStartupInfoData::Private
         silent(KStartupInfoData::Unknown), screen(-1), xinerama(-1), launched_by(0) {}
 
     QString to_text() const;
+    void set_field(const StartupInfoTokenizer &field);
     void remove_pid(pid_t pid);
 
     QString bin;
@@ -154,6 +337,17 @@ public:
     QMap< KStartupInfoId, Data >::iterator removeStartupInfoInternal(QMap< KStartupInfoId, Data >::iterator it);
     void remove_startup_pids(const KStartupInfoId &id, const KStartupInfoData &data);
     void remove_startup_pids(const KStartupInfoData &data);
+    /**
+     * Adds or removes an entry of the startups map to or from the secondary
+     * indexes. Must be called around every change of its pids, hostname,
+     * WM_CLASS or binary.
+     **/
+    void index_startup(const KStartupInfoId &id, const KStartupInfoData &data);
+    void unindex_startup(const KStartupInfoId &id, const KStartupInfoData &data);
+    /**
+     * @returns The first of the given startups in the order of the startups map.
+     **/
+    static KStartupInfoId first_startup(const QList<KStartupInfoId> &ids);
     startup_t check_startup_internal(WId w, KStartupInfoId *id, KStartupInfoData *data);
     bool find_id(const QByteArray &id_P, KStartupInfoId *id_O,
                  KStartupInfoData *data_O);
@@ -161,7 +355,13 @@ public:
                   KStartupInfoData *data_O);
     bool find_wclass(const QByteArray &res_name_P, const QByteArray &res_class_P,
                      KStartupInfoId *id_O, KStartupInfoData *data_O);
-    void startups_cleanup_internal(bool age_P);
+    /**
+     * (Re)computes when the info expires, after it has been added or updated.
+     **/
+    void schedule_expiry(const KStartupInfoId &id, Data &data);
+    void unschedule_expiry(const KStartupInfoId &id, const Data &data);
+    void arm_cleanup();
+    qint64 timeout_msecs(const Data &data) const;
     void clean_all_noncompliant();
     static QString check_required_startup_fields(const QString &msg,
             const KStartupInfoData &data, int screen);
@@ -173,8 +373,17 @@ public:
     QMap< KStartupInfoId, KStartupInfo::Data > silent_startups;
     // contains ASN's that had change: but no new: yet
     QMap< KStartupInfoId, KStartupInfo::Data > uninited_startups;
+    // secondary indexes into startups, by (hostname, pid) and by lower-cased WM_CLASS
+    QMultiHash< QPair< QByteArray, pid_t >, KStartupInfoId > startups_by_pid;
+    QMultiHash< QByteArray, KStartupInfoId > startups_by_wmclass;
+    // absolute expiry times of the infos in all three maps, the earliest arms cleanup
+    QMultiMap< qint64, KStartupInfoId > deadlines;
+    QElapsedTimer clock;
+    qint64 timeout_override;
 #if KWINDOWSYSTEM_HAVE_X11
     KXMessages msgs;
+    // keeps the handle window used by the static send functions alive
+    QScopedPointer<KXMessagesSender> sender;
 #endif
     QTimer *cleanup;
     int flags;
@@ -185,9 +394,11 @@ public:
 #if KWINDOWSYSTEM_HAVE_X11
           msgs(NET_STARTUP_MSG),
 #endif
+          timeout_override(-1),
           cleanup(nullptr),
           flags(flags_P)
     {
+        clock.start();
     }
 
     void createConnections()
@@ -206,7 +417,9 @@ public:
             //QObject::connect( KWindowSystem::self(), SIGNAL(systemTrayWindowAdded(WId)), q, SLOT(slot_window_added(WId)));
         }
         QObject::connect(&msgs, SIGNAL(gotMessage(QString)), q, SLOT(got_message(QString)));
+        sender.reset(new KXMessagesSender(QX11Info::connection(), QX11Info::appScreen()));
         cleanup = new QTimer(q);
+        cleanup->setSingleShot(true);
         QObject::connect(cleanup, SIGNAL(timeout()), q, SLOT(startups_cleanup()));
 #endif
     }
@@ -313,11 +526,17 @@ void KStartupInfo::Private::window_added(WId w_P)
 
 void KStartupInfo::Private::got_startup_info(const QString &msg_P, bool update_P)
 {
-    KStartupInfoId id(msg_P);
+    // tokenize only once for both the id and the data
+    KStartupInfoId id;
+    KStartupInfo::Data data;
+    StartupInfoTokenizer tokenizer(msg_P);
+    while (tokenizer.next()) {
+        id.d->set_field(tokenizer);
+        data.d->set_field(tokenizer);
+    }
     if (id.isNull()) {
         return;
     }
-    KStartupInfo::Data data(msg_P);
     new_startup_info_internal(id, data, update_P);
 }
 
@@ -327,32 +546,40 @@ void KStartupInfo::Private::new_startup_info_internal(const KStartupInfoId &id_P
     if (id_P.isNull()) {
         return;
     }
+    const qint64 now = clock.elapsed();
     if (startups.contains(id_P)) {
         // already reported, update
+        unindex_startup(id_P, startups[ id_P ]);
         startups[ id_P ].update(data_P);
-        startups[ id_P ].age = 0; // CHECKME
+        startups[ id_P ].touched = now; // CHECKME
         //qCDebug(LOG_KWINDOWSYSTEM) << "updating";
         if (startups[ id_P ].silent() == KStartupInfo::Data::Yes
                 && !(flags & AnnounceSilenceChanges)) {
             silent_startups[ id_P ] = startups[ id_P ];
             startups.remove(id_P);
+            schedule_expiry(id_P, silent_startups[ id_P ]);
             emit q->gotRemoveStartup(id_P, silent_startups[ id_P ]);
             return;
         }
+        index_startup(id_P, startups[ id_P ]);
+        schedule_expiry(id_P, startups[ id_P ]);
         emit q->gotStartupChange(id_P, startups[ id_P ]);
         return;
     }
     if (silent_startups.contains(id_P)) {
         // already reported, update
         silent_startups[ id_P ].update(data_P);
-        silent_startups[ id_P ].age = 0; // CHECKME
+        silent_startups[ id_P ].touched = now; // CHECKME
         //qCDebug(LOG_KWINDOWSYSTEM) << "updating silenced";
         if (silent_startups[ id_P ].silent() != Data::Yes) {
             startups[ id_P ] = silent_startups[ id_P ];
             silent_startups.remove(id_P);
+            index_startup(id_P, startups[ id_P ]);
+            schedule_expiry(id_P, startups[ id_P ]);
             q->emit gotNewStartup(id_P, startups[ id_P ]);
             return;
         }
+        schedule_expiry(id_P, silent_startups[ id_P ]);
         emit q->gotStartupChange(id_P, silent_startups[ id_P ]);
         return;
     }
@@ -362,24 +589,28 @@ void KStartupInfo::Private::new_startup_info_internal(const KStartupInfoId &id_P
         if (!update_P) { // uninited finally got new:
             startups[ id_P ] = uninited_startups[ id_P ];
             uninited_startups.remove(id_P);
+            index_startup(id_P, startups[ id_P ]);
+            schedule_expiry(id_P, startups[ id_P ]);
             emit q->gotNewStartup(id_P, startups[ id_P ]);
             return;
         }
-        // no change announce, it's still uninited
+        // no change announce, it's still uninited, but the silence affects the timeout
+        schedule_expiry(id_P, uninited_startups[ id_P ]);
         return;
     }
+    data_P.touched = now;
     if (update_P) { // change: without any new: first
         //qCDebug(LOG_KWINDOWSYSTEM) << "adding uninited";
-        uninited_startups.insert(id_P, data_P);
+        schedule_expiry(id_P, *uninited_startups.insert(id_P, data_P));
     } else if (data_P.silent() != Data::Yes || flags & AnnounceSilenceChanges) {
         //qCDebug(LOG_KWINDOWSYSTEM) << "adding";
-        startups.insert(id_P, data_P);
+        schedule_expiry(id_P, *startups.insert(id_P, data_P));
+        index_startup(id_P, data_P);
         emit q->gotNewStartup(id_P, data_P);
     } else { // new silenced, and silent shouldn't be announced
         //qCDebug(LOG_KWINDOWSYSTEM) << "adding silent";
-        silent_startups.insert(id_P, data_P);
+        schedule_expiry(id_P, *silent_startups.insert(id_P, data_P));
     }
-    cleanup->start(1000);   // 1 sec
 }
 
 void KStartupInfo::Private::got_remove_startup_info(const QString &msg_P)
@@ -403,16 +634,20 @@ void KStartupInfo::Private::removeAllStartupInfoInternal(const KStartupInfoId &i
     if (it != startups.end()) {
         //qCDebug(LOG_KWINDOWSYSTEM) << "removing";
         emit q->gotRemoveStartup(it.key(), it.value());
+        unindex_startup(it.key(), it.value());
+        unschedule_expiry(it.key(), it.value());
         startups.erase(it);
         return;
     }
     it = silent_startups.find(id_P);
     if (it != silent_startups.end()) {
+        unschedule_expiry(it.key(), it.value());
         silent_startups.erase(it);
         return;
     }
     it = uninited_startups.find(id_P);
     if (it != uninited_startups.end()) {
+        unschedule_expiry(it.key(), it.value());
         uninited_startups.erase(it);
     }
 }
@@ -420,23 +655,47 @@ void KStartupInfo::Private::removeAllStartupInfoInternal(const KStartupInfoId &i
 QMap< KStartupInfoId, KStartupInfo::Data >::iterator KStartupInfo::Private::removeStartupInfoInternal(QMap< KStartupInfoId, Data >::iterator it)
 {
     emit q->gotRemoveStartup(it.key(), it.value());
+    unindex_startup(it.key(), it.value());
+    unschedule_expiry(it.key(), it.value());
     return startups.erase(it);
 }
 
+void KStartupInfo::Private::index_startup(const KStartupInfoId &id_P, const KStartupInfoData &data_P)
+{
+    const auto pids = data_P.pids();
+    for (auto pid : pids) {
+        startups_by_pid.insert(qMakePair(data_P.hostname(), pid), id_P);
+    }
+    startups_by_wmclass.insert(data_P.findWMClass().toLower(), id_P);
+}
+
+void KStartupInfo::Private::unindex_startup(const KStartupInfoId &id_P, const KStartupInfoData &data_P)
+{
+    const auto pids = data_P.pids();
+    for (auto pid : pids) {
+        startups_by_pid.remove(qMakePair(data_P.hostname(), pid), id_P);
+    }
+    startups_by_wmclass.remove(data_P.findWMClass().toLower(), id_P);
+}
+
+KStartupInfoId KStartupInfo::Private::first_startup(const QList<KStartupInfoId> &ids_P)
+{
+    // the linear scans this replaces used the first match in map order
+    KStartupInfoId ret;
+    for (const KStartupInfoId &id : ids_P) {
+        if (ret.isNull() || id < ret) {
+            ret = id;
+        }
+    }
+    return ret;
+}
+
 void KStartupInfo::Private::remove_startup_pids(const KStartupInfoData &data_P)
 {
     // first find the matching info
-    for (QMap< KStartupInfoId, KStartupInfo::Data >::Iterator it = startups.begin();
-            it != startups.end();
-            ++it) {
-        if ((*it).hostname() != data_P.hostname()) {
-            continue;
-        }
-        if (!(*it).is_pid(data_P.pids().first())) {
-            continue;    // not the matching info
-        }
-        remove_startup_pids(it.key(), data_P);
-        break;
+    const KStartupInfoId id = first_startup(startups_by_pid.values(qMakePair(data_P.hostname(), data_P.pids().first())));
+    if (!id.isNull()) {
+        remove_startup_pids(id, data_P);
     }
 }
 
@@ -447,8 +706,10 @@ void KStartupInfo::Private::remove_startup_pids(const KStartupInfoId &id_P,
         qFatal("data_P.pids().isEmpty()");
     }
     Data *data = nullptr;
-    if (startups.contains(id_P)) {
+    const bool indexed = startups.contains(id_P);
+    if (indexed) {
         data = &startups[ id_P ];
+        unindex_startup(id_P, *data);
     } else if (silent_startups.contains(id_P)) {
         data = &silent_startups[ id_P ];
     } else if (uninited_startups.contains(id_P)) {
@@ -460,6 +721,9 @@ void KStartupInfo::Private::remove_startup_pids(const KStartupInfoId &id_P,
     for (auto pid : pids) {
         data->d->remove_pid(pid);    // remove all pids from the info
     }
+    if (indexed) {
+        index_startup(id_P, *data);
+    }
     if (data->pids().isEmpty()) { // all pids removed -> remove info
         removeAllStartupInfoInternal(id_P);
     }
@@ -846,22 +1110,24 @@ KStartupInfo::startup_t KStartupInfo::Private::check_startup_internal(WId w_P, K
     //           - Yes - test for pid match
     //           - No - test for WM_CLASS match
     qCDebug(LOG_KWINDOWSYSTEM) << "check_startup";
-    QByteArray id = windowStartupId(w_P);
-    if (!id.isNull()) {
-        if (id.isEmpty() || id == "0") { // means ignore this window
-            qCDebug(LOG_KWINDOWSYSTEM) << "ignore";
-            return NoMatch;
-        }
-        return find_id(id, id_O, data_O) ? Match : NoMatch;
-    }
 #if KWINDOWSYSTEM_HAVE_X11
     if (!QX11Info::isPlatformX11()) {
         qCDebug(LOG_KWINDOWSYSTEM) << "check_startup:cantdetect";
         return CantDetect;
     }
+    // fetch everything needed for matching in one batch of requests,
+    // only the group leader's startup id may need a second one
     NETWinInfo info(QX11Info::connection(),  w_P, QX11Info::appRootWindow(),
                     NET::WMWindowType | NET::WMPid | NET::WMState,
-                    NET::WM2WindowClass | NET::WM2ClientMachine | NET::WM2TransientFor);
+                    NET::WM2StartupId | NET::WM2GroupLeader | NET::WM2WindowClass | NET::WM2ClientMachine | NET::WM2TransientFor);
+    QByteArray id = window_startup_id(info);
+    if (!id.isNull()) {
+        if (id.isEmpty() || id == "0") { // means ignore this window
+            qCDebug(LOG_KWINDOWSYSTEM) << "ignore";
+            return NoMatch;
+        }
+        return find_id(id, id_O, data_O) ? Match : NoMatch;
+    }
     pid_t pid = info.pid();
     if (pid > 0) {
         QByteArray hostname = info.clientMachine();
@@ -892,6 +1158,10 @@ KStartupInfo::startup_t KStartupInfo::Private::check_startup_internal(WId w_P, K
     if (transient_for != QX11Info::appRootWindow() && transient_for != XCB_WINDOW_NONE) {
         return NoMatch;
     }
+#else
+    Q_UNUSED(w_P)
+    Q_UNUSED(id_O)
+    Q_UNUSED(data_O)
 #endif
     qCDebug(LOG_KWINDOWSYSTEM) << "check_startup:cantdetect";
     return CantDetect;
@@ -920,51 +1190,50 @@ bool KStartupInfo::Private::find_pid(pid_t pid_P, const QByteArray &hostname_P,
                                      KStartupInfoId *id_O, KStartupInfoData *data_O)
 {
     //qCDebug(LOG_KWINDOWSYSTEM) << "find_pid:" << pid_P;
-    for (QMap< KStartupInfoId, KStartupInfo::Data >::Iterator it = startups.begin();
-            it != startups.end();
-            ++it) {
-        if ((*it).is_pid(pid_P) && (*it).hostname() == hostname_P) {
-            // Found it !
-            if (id_O != nullptr) {
-                *id_O = it.key();
-            }
-            if (data_O != nullptr) {
-                *data_O = *it;
-            }
-            // non-compliant, remove on first match
-            removeStartupInfoInternal(it);
-            //qCDebug(LOG_KWINDOWSYSTEM) << "check_startup_pid:match";
-            return true;
-        }
+    const KStartupInfoId id = first_startup(startups_by_pid.values(qMakePair(hostname_P, pid_P)));
+    if (id.isNull()) {
+        return false;
     }
-    return false;
+    auto it = startups.find(id);
+    // Found it !
+    if (id_O != nullptr) {
+        *id_O = it.key();
+    }
+    if (data_O != nullptr) {
+        *data_O = *it;
+    }
+    // non-compliant, remove on first match
+    removeStartupInfoInternal(it);
+    //qCDebug(LOG_KWINDOWSYSTEM) << "check_startup_pid:match";
+    return true;
 }
 
 bool KStartupInfo::Private::find_wclass(const QByteArray &_res_name, const QByteArray &_res_class,
                                         KStartupInfoId *id_O, KStartupInfoData *data_O)
 {
-    QByteArray res_name = _res_name.toLower();
-    QByteArray res_class = _res_class.toLower();
+    const QByteArray res_name = _res_name.toLower();
+    const QByteArray res_class = _res_class.toLower();
     //qCDebug(LOG_KWINDOWSYSTEM) << "find_wclass:" << res_name << ":" << res_class;
-    for (QMap< KStartupInfoId, Data >::Iterator it = startups.begin();
-            it != startups.end();
-            ++it) {
-        const QByteArray wmclass = (*it).findWMClass();
-        if (wmclass.toLower() == res_name || wmclass.toLower() == res_class) {
-            // Found it !
-            if (id_O != nullptr) {
-                *id_O = it.key();
-            }
-            if (data_O != nullptr) {
-                *data_O = *it;
-            }
-            // non-compliant, remove on first match
-            removeStartupInfoInternal(it);
-            //qCDebug(LOG_KWINDOWSYSTEM) << "check_startup_wclass:match";
-            return true;
-        }
+    QList<KStartupInfoId> candidates = startups_by_wmclass.values(res_name);
+    if (res_class != res_name) {
+        candidates += startups_by_wmclass.values(res_class);
     }
-    return false;
+    const KStartupInfoId id = first_startup(candidates);
+    if (id.isNull()) {
+        return false;
+    }
+    auto it = startups.find(id);
+    // Found it !
+    if (id_O != nullptr) {
+        *id_O = it.key();
+    }
+    if (data_O != nullptr) {
+        *data_O = *it;
+    }
+    // non-compliant, remove on first match
+    removeStartupInfoInternal(it);
+    //qCDebug(LOG_KWINDOWSYSTEM) << "check_startup_wclass:match";
+    return true;
 }
 
 QByteArray KStartupInfo::windowStartupId(WId w_P)
@@ -974,18 +1243,26 @@ QByteArray KStartupInfo::windowStartupId(WId w_P)
         return QByteArray();
     }
     NETWinInfo info(QX11Info::connection(), w_P, QX11Info::appRootWindow(), NET::Properties(), NET::WM2StartupId | NET::WM2GroupLeader);
+    return window_startup_id(info);
+#else
+    Q_UNUSED(w_P)
+    return QByteArray();
+#endif
+}
+
+#if KWINDOWSYSTEM_HAVE_X11
+// info must have been created with at least NET::WM2StartupId | NET::WM2GroupLeader
+static QByteArray window_startup_id(const NETWinInfo &info)
+{
     QByteArray ret = info.startupId();
     if (ret.isEmpty() && info.groupLeader() != XCB_WINDOW_NONE) {
         // retry with window group leader, as the spec says
-        NETWinInfo groupLeaderInfo(QX11Info::connection(), info.groupLeader(), QX11Info::appRootWindow(), NET::Properties(), NET::Properties2());
+        NETWinInfo groupLeaderInfo(QX11Info::connection(), info.groupLeader(), QX11Info::appRootWindow(), NET::Properties(), NET::WM2StartupId);
         ret = groupLeaderInfo.startupId();
     }
     return ret;
-#else
-    Q_UNUSED(w_P)
-    return QByteArray();
-#endif
 }
+#endif
 
 void KStartupInfo::setWindowStartupId(WId w_P, const QByteArray &id_P)
 {
@@ -1013,49 +1290,84 @@ void KStartupInfo::setTimeout(unsigned int secs_P)
 
 void KStartupInfo::Private::startups_cleanup_no_age()
 {
-    startups_cleanup_internal(false);
+    // the timeout changed, recompute all deadlines and expire what is overdue now
+    deadlines.clear();
+    for (auto *s : {&startups, &silent_startups, &uninited_startups}) {
+        for (auto it = s->begin(); it != s->end(); ++it) {
+            (*it).deadline = -1;
+            schedule_expiry(it.key(), *it);
+        }
+    }
+    startups_cleanup();
 }
 
 void KStartupInfo::Private::startups_cleanup()
 {
-    if (startups.isEmpty() && silent_startups.isEmpty()
-            && uninited_startups.isEmpty()) {
-        cleanup->stop();
-        return;
+    const qint64 now = clock.elapsed();
+    while (!deadlines.isEmpty() && deadlines.firstKey() <= now) {
+        const KStartupInfoId id = deadlines.first();
+        deadlines.erase(deadlines.begin());
+        auto it = startups.find(id);
+        if (it != startups.end()) {
+            const Data data = *it;
+            unindex_startup(id, data);
+            startups.erase(it);
+            emit q->gotRemoveStartup(id, data);
+            continue;
+        }
+        if (!silent_startups.remove(id)) {
+            uninited_startups.remove(id);
+        }
     }
-    startups_cleanup_internal(true);
+    arm_cleanup();
 }
 
-void KStartupInfo::Private::startups_cleanup_internal(bool age_P)
+qint64 KStartupInfo::Private::timeout_msecs(const Data &data_P) const
 {
-    auto checkCleanup = [this, age_P](QMap<KStartupInfoId, KStartupInfo::Data> &s, bool doEmit) {
-        auto it = s.begin();
-        while (it != s.end()) {
-            if (age_P) {
-                (*it).age++;
-            }
-            unsigned int tout = timeout;
-            if ((*it).silent() == KStartupInfo::Data::Yes) {
-                // give kdesu time to get a password
-                tout *= 20;
-            }
-            const QByteArray timeoutEnvVariable = qgetenv("KSTARTUPINFO_TIMEOUT");
-            if (!timeoutEnvVariable.isNull()) {
-                tout = timeoutEnvVariable.toUInt();
-            }
-            if ((*it).age >= tout) {
-                if (doEmit) {
-                    emit q->gotRemoveStartup(it.key(), it.value());
-                }
-                it = s.erase(it);
-            } else {
-                ++it;
-            }
-        }
-    };
-    checkCleanup(startups, true);
-    checkCleanup(silent_startups, false);
-    checkCleanup(uninited_startups, false);
+    if (timeout_override >= 0) {
+        return timeout_override * 1000;
+    }
+    qint64 tout = timeout;
+    if (data_P.silent() == KStartupInfo::Data::Yes) {
+        // give kdesu time to get a password
+        tout *= 20;
+    }
+    return tout * 1000;
+}
+
+void KStartupInfo::Private::schedule_expiry(const KStartupInfoId &id_P, Data &data_P)
+{
+    if (deadlines.isEmpty()) {
+        // only read the environment when the first info becomes pending,
+        // instead of for every info on every check
+        const QByteArray timeoutEnvVariable = qgetenv("KSTARTUPINFO_TIMEOUT");
+        timeout_override = timeoutEnvVariable.isNull() ? -1 : timeoutEnvVariable.toUInt();
+    }
+    unschedule_expiry(id_P, data_P);
+    data_P.deadline = data_P.touched + timeout_msecs(data_P);
+    deadlines.insert(data_P.deadline, id_P);
+    arm_cleanup();
+}
+
+void KStartupInfo::Private::unschedule_expiry(const KStartupInfoId &id_P, const Data &data_P)
+{
+    if (data_P.deadline >= 0) {
+        deadlines.remove(data_P.deadline, id_P);
+    }
+}
+
+void KStartupInfo::Private::arm_cleanup()
+{
+    if (!cleanup) {
+        return;
+    }
+    if (deadlines.isEmpty()) {
+        cleanup->stop();
+        return;
+    }
+    // a single timer for the earliest deadline, nothing wakes up while idle
+    const qint64 remaining = deadlines.firstKey() - clock.elapsed();
+    cleanup->start(int(qBound<qint64>(0, remaining, std::numeric_limits<int>::max())));
 }
 
 void KStartupInfo::Private::clean_all_noncompliant()
@@ -1117,15 +1429,18 @@ QString KStartupInfoId::Private::to_text() const
     return QStringLiteral(" ID=\"%1\" ").arg(escape_str(id));
 }
 
+void KStartupInfoId::Private::set_field(const StartupInfoTokenizer &field)
+{
+    if (field.keyIs("ID")) {
+        id = field.value().toUtf8();
+    }
+}
+
 KStartupInfoId::KStartupInfoId(const QString &txt_P) : d(new Private)
 {
-    const QStringList items = get_fields(txt_P);
-    for (QStringList::ConstIterator it = items.begin();
-            it != items.end();
-            ++it) {
-        if ((*it).startsWith(QLatin1String("ID="))) {
-            d->id = get_cstr(*it);
-        }
+    StartupInfoTokenizer tokenizer(txt_P);
+    while (tokenizer.next()) {
+        d->set_field(tokenizer);
     }
 }
 
@@ -1289,41 +1604,47 @@ QString KStartupInfoData::Private::to_text() const
     return ret;
 }
 
+void KStartupInfoData::Private::set_field(const StartupInfoTokenizer &field)
+{
+    if (field.keyIs("BIN")) {
+        bin = field.value().toString();
+    } else if (field.keyIs("NAME")) {
+        name = field.value().toString();
+    } else if (field.keyIs("DESCRIPTION")) {
+        description = field.value().toString();
+    } else if (field.keyIs("ICON")) {
+        icon = field.value().toString();
+    } else if (field.keyIs("DESKTOP")) {
+        desktop = field.number();
+        if (desktop != NET::OnAllDesktops)
+            ++desktop; // spec counts from 0
+    } else if (field.keyIs("WMCLASS")) {
+        wmclass = field.value().toUtf8();
+    } else if (field.keyIs("HOSTNAME")) { // added to version 1 (2014)
+        hostname = field.value().toUtf8();
+    } else if (field.keyIs("PID")) {  // added to version 1 (2014)
+        const pid_t pid = field.number();
+        if (!pids.contains(pid)) {
+            pids.append(pid);
+        }
+    } else if (field.keyIs("SILENT")) {
+        silent = field.number() != 0 ? KStartupInfoData::Yes : KStartupInfoData::No;
+    } else if (field.keyIs("SCREEN")) {
+        screen = field.number();
+    } else if (field.keyIs("XINERAMA")) {
+        xinerama = field.number();
+    } else if (field.keyIs("LAUNCHED_BY")) {
+        launched_by = (WId) field.number();
+    } else if (field.keyIs("APPLICATION_ID")) {
+        application_id = field.value().toString();
+    }
+}
+
 KStartupInfoData::KStartupInfoData(const QString &txt_P) : d(new Private)
 {
-    const QStringList items = get_fields(txt_P);
-    for (QStringList::ConstIterator it = items.begin();
-            it != items.end();
-            ++it) {
-        if ((*it).startsWith(QLatin1String("BIN="))) {
-            d->bin = get_str(*it);
-        } else if ((*it).startsWith(QLatin1String("NAME="))) {
-            d->name = get_str(*it);
-        } else if ((*it).startsWith(QLatin1String("DESCRIPTION="))) {
-            d->description = get_str(*it);
-        } else if ((*it).startsWith(QLatin1String("ICON="))) {
-            d->icon = get_str(*it);
-        } else if ((*it).startsWith(QLatin1String("DESKTOP="))) {
-            d->desktop = get_num(*it);
-            if (d->desktop != NET::OnAllDesktops)
-                ++d->desktop; // spec counts from 0
-        } else if ((*it).startsWith(QLatin1String("WMCLASS="))) {
-            d->wmclass = get_cstr(*it);
-        } else if ((*it).startsWith(QLatin1String("HOSTNAME="))) { // added to version 1 (2014)
-            d->hostname = get_cstr(*it);
-        } else if ((*it).startsWith(QLatin1String("PID="))) {  // added to version 1 (2014)
-            addPid(get_num(*it));
-        } else if ((*it).startsWith(QLatin1String("SILENT="))) {
-            d->silent = get_num(*it) != 0 ? Yes : No;
-        } else if ((*it).startsWith(QLatin1String("SCREEN="))) {
-            d->screen = get_num(*it);
-        } else if ((*it).startsWith(QLatin1String("XINERAMA="))) {
-            d->xinerama = get_num(*it);
-        } else if ((*it).startsWith(QLatin1String("LAUNCHED_BY="))) {
-            d->launched_by = (WId) get_num(*it);
-        } else if ((*it).startsWith(QLatin1String("APPLICATION_ID="))) {
-            d->application_id = get_str(*it);
-        }
+    StartupInfoTokenizer tokenizer(txt_P);
+    while (tokenizer.next()) {
+        d->set_field(tokenizer);
     }
 }
 
@@ -1589,55 +1910,6 @@ QString KStartupInfoData::applicationId() const
     return d->application_id;
 }
 
-static
-long get_num(const QString &item_P)
-{
-    unsigned int pos = item_P.indexOf(QLatin1Char('='));
-    return item_P.mid(pos + 1).toLong();
-}
-
-static
-QString get_str(const QString &item_P)
-{
-    int pos = item_P.indexOf(QLatin1Char('='));
-    return item_P.mid(pos + 1);
-}
-
-static
-QByteArray get_cstr(const QString &item_P)
-{
-    return get_str(item_P).toUtf8();
-}
-
-static
-QStringList get_fields(const QString &txt_P)
-{
-    QString txt = txt_P.simplified();
-    QStringList ret;
-    QString item;
-    bool in = false;
-    bool escape = false;
-    for (int pos = 0;
-            pos < txt.length();
-            ++pos) {
-        if (escape) {
-            item += txt[ pos ];
-            escape = false;
-        } else if (txt[ pos ] == QLatin1Char('\\')) {
-            escape = true;
-        } else if (txt[ pos ] == QLatin1Char('\"')) {
-            in = !in;
-        } else if (txt[ pos ] == QLatin1Char(' ') && !in) {
-            ret.append(item);
-            item = QString();
-        } else {
-            item += txt[ pos ];
-        }
-    }
-    ret.append(item);
-    return ret;
-}
-
 static QString escape_str(const QString &str_P)
 {
     QString ret;
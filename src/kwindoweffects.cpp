@@ -20,6 +20,8 @@
 #include "kwindoweffects_p.h"
 #include "pluginwrapper_p.h"
 #include <QGuiApplication>
+#include <QVector>
+#include <functional>
 #if KWINDOWSYSTEM_BUILD_DEPRECATED_SINCE(5, 62)
 #include <QWidget>
 #endif
@@ -32,6 +34,15 @@ KWindowEffectsPrivate::~KWindowEffectsPrivate()
 {
 }
 
+KWindowEffectsPrivateV2::KWindowEffectsPrivateV2()
+    : KWindowEffectsPrivate()
+{
+}
+
+KWindowEffectsPrivateV2::~KWindowEffectsPrivateV2()
+{
+}
+
 namespace KWindowEffects
 {
 
@@ -87,4 +98,92 @@ QList< QSize > windowSizes(const QList< WId > &ids)
     return KWindowSystemPluginWrapper::self().effects()->windowSizes(ids);
 }
 
+class Q_DECL_HIDDEN Batch::Private
+{
+public:
+    QVector<std::function<void(KWindowEffectsPrivate *)>> changes;
+};
+
+Batch::Batch()
+    : d(new Private)
+{
+}
+
+Batch::~Batch()
+{
+}
+
+bool Batch::isEmpty() const
+{
+    return d->changes.isEmpty();
+}
+
+void Batch::slideWindow(WId id, SlideFromLocation location, int offset)
+{
+    d->changes << [id, location, offset](KWindowEffectsPrivate *effects) {
+        effects->slideWindow(id, location, offset);
+    };
+}
+
+void Batch::presentWindows(WId controller, const QList<WId> &ids)
+{
+    d->changes << [controller, ids](KWindowEffectsPrivate *effects) {
+        effects->presentWindows(controller, ids);
+    };
+}
+
+void Batch::presentWindows(WId controller, int desktop)
+{
+    d->changes << [controller, desktop](KWindowEffectsPrivate *effects) {
+        effects->presentWindows(controller, desktop);
+    };
+}
+
+void Batch::highlightWindows(WId controller, const QList<WId> &ids)
+{
+    d->changes << [controller, ids](KWindowEffectsPrivate *effects) {
+        effects->highlightWindows(controller, ids);
+    };
+}
+
+void Batch::enableBlurBehind(WId window, bool enable, const QRegion &region)
+{
+    d->changes << [window, enable, region](KWindowEffectsPrivate *effects) {
+        effects->enableBlurBehind(window, enable, region);
+    };
+}
+
+void Batch::enableBackgroundContrast(WId window, bool enable, qreal contrast, qreal intensity, qreal saturation, const QRegion &region)
+{
+    d->changes << [window, enable, contrast, intensity, saturation, region](KWindowEffectsPrivate *effects) {
+        effects->enableBackgroundContrast(window, enable, contrast, intensity, saturation, region);
+    };
+}
+
+void Batch::markAsDashboard(WId window)
+{
+    d->changes << [window](KWindowEffectsPrivate *effects) {
+        effects->markAsDashboard(window);
+    };
+}
+
+void Batch::commit()
+{
+    if (d->changes.isEmpty()) {
+        return;
+    }
+    KWindowEffectsPrivate *effects = KWindowSystemPluginWrapper::self().effects();
+    KWindowEffectsPrivateV2 *effects2 = dynamic_cast<KWindowEffectsPrivateV2 *>(effects);
+    if (effects2) {
+        effects2->beginBatch();
+    }
+    for (const auto &change : qAsConst(d->changes)) {
+        change(effects);
+    }
+    d->changes.clear();
+    if (effects2) {
+        effects2->flush();
+    }
+}
+
 }
@@ -23,6 +23,7 @@
 #include <QWidgetList> // for WId, etc.
 
 #include <QRegion>
+#include <QScopedPointer>
 #include <netwm_def.h>
 
 /**
@@ -50,6 +51,10 @@ enum SlideFromLocation {
 /**
  * @return if an atom property is available
  *
+ * The availability is cached and updated whenever the compositor changes it,
+ * so this is cheap to call. Connect to KWindowSystem::effectAvailabilityChanged()
+ * to be notified of changes instead of polling.
+ *
  * @param effect the effect we want to check
  */
 KWINDOWSYSTEM_EXPORT bool isEffectAvailable(Effect effect);
@@ -161,6 +166,60 @@ KWINDOWSYSTEM_EXPORT void enableBackgroundContrast(WId window, bool enable = tru
  * @param window The window for which to enable the blur effect
  */
 KWINDOWSYSTEM_EXPORT void markAsDashboard(WId window);
+
+/**
+ * Collects effect changes for one or more windows and applies them together.
+ *
+ * Setting up a window often needs several effects, e.g. a popup which slides
+ * in, blurs and modifies its background. Changing them one by one lets the
+ * compositor observe half applied states. Instead, record all changes on a
+ * Batch and commit() them at once:
+ *
+ * @code
+ * KWindowEffects::Batch batch;
+ * batch.slideWindow(popup, KWindowEffects::TopEdge);
+ * batch.enableBlurBehind(popup, true, mask);
+ * batch.enableBackgroundContrast(popup, true, 0.5, 1.5, 1.5, mask);
+ * batch.commit();
+ * @endcode
+ *
+ * The methods take the same arguments as the functions of the same name
+ * in the KWindowEffects namespace. Changes which were not committed when
+ * the Batch is destroyed are dropped.
+ *
+ * @since 5.65
+ */
+class KWINDOWSYSTEM_EXPORT Batch
+{
+public:
+    Batch();
+    ~Batch();
+
+    /**
+     * @return @c true if no changes were recorded since the last commit()
+     */
+    bool isEmpty() const;
+
+    void slideWindow(WId id, SlideFromLocation location, int offset = -1);
+    void presentWindows(WId controller, const QList<WId> &ids);
+    void presentWindows(WId controller, int desktop = NET::OnAllDesktops);
+    void highlightWindows(WId controller, const QList<WId> &ids);
+    void enableBlurBehind(WId window, bool enable = true, const QRegion &region = QRegion());
+    void enableBackgroundContrast(WId window, bool enable = true, qreal contrast = 1, qreal intensity = 1, qreal saturation = 1, const QRegion &region = QRegion());
+    void markAsDashboard(WId window);
+
+    /**
+     * Applies all recorded changes in the order they were recorded and
+     * sends them to the compositor together. Afterwards the Batch is
+     * empty and can be reused.
+     */
+    void commit();
+
+private:
+    Q_DISABLE_COPY(Batch)
+    class Private;
+    QScopedPointer<Private> d;
+};
 }
 
 #endif
@@ -38,4 +38,28 @@ protected:
     KWindowEffectsPrivate();
 };
 
+/**
+ * Extension of KWindowEffectsPrivate for backends which can send a
+ * KWindowEffects::Batch to the compositor in one go.
+ *
+ * @since 5.65
+ */
+class KWINDOWSYSTEM_EXPORT KWindowEffectsPrivateV2 : public KWindowEffectsPrivate
+{
+public:
+    ~KWindowEffectsPrivateV2() override;
+    /**
+     * Called before the changes of a batch are applied, so that the
+     * backend can prepare for sending them with the following flush().
+     */
+    virtual void beginBatch() = 0;
+    /**
+     * Sends all effect changes requested so far to the compositor, and
+     * ends a batch started with beginBatch().
+     */
+    virtual void flush() = 0;
+protected:
+    KWindowEffectsPrivateV2();
+};
+
 #endif
@@ -55,8 +55,11 @@ public:
     }
     KWindowSystemPrivate *xcbPlugin() {
         if (xcbPrivate.isNull()) {
-            QPluginLoader loader(QStringLiteral(XCB_PLUGIN_PATH));
-            QScopedPointer<KWindowSystemPluginInterface> xcbPlugin(qobject_cast< KWindowSystemPluginInterface* >(loader.instance()));
+            QScopedPointer<KWindowSystemPluginInterface> xcbPlugin(KWindowSystemPluginWrapper::loadStaticPlugin(QStringLiteral("xcb")));
+            if (xcbPlugin.isNull()) {
+                QPluginLoader loader(QStringLiteral(XCB_PLUGIN_PATH));
+                xcbPlugin.reset(qobject_cast< KWindowSystemPluginInterface* >(loader.instance()));
+            }
             if (!xcbPlugin.isNull()) {
                 xcbPrivate.reset(xcbPlugin->createWindowSystem());
             }
@@ -27,6 +27,7 @@
 #include <QWidgetList> //For WId
 #include <netwm_def.h>
 #include <kwindowinfo.h>
+#include <kwindoweffects.h>
 
 class KWindowSystemPrivate;
 class NETWinInfo;
@@ -775,6 +776,20 @@ Q_SIGNALS:
      */
     void compositingChanged(bool enabled);
 
+    /**
+     * The availability of a window effect changed, either because the
+     * compositor announced or withdrew its support, or because compositing
+     * was enabled or disabled.
+     *
+     * Connecting to this signal starts tracking the effect availability,
+     * so that KWindowEffects::isEffectAvailable() does not need to be polled.
+     *
+     * @param effect the effect whose availability changed
+     * @param available the new value of KWindowEffects::isEffectAvailable(@p effect)
+     * @since 5.65
+     */
+    void effectAvailabilityChanged(KWindowEffects::Effect effect, bool available);
+
 protected:
     void connectNotify(const QMetaMethod &signal) override;
 
@@ -0,0 +1,207 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kwindowinfo_p_simulated.h"
+
+KWindowInfoPrivateSimulated::KWindowInfoPrivateSimulated(WId window, NET::Properties properties, NET::Properties2 properties2)
+    : KWindowInfoPrivate(window, properties, properties2)
+    , KWindowInfoPrivateDesktopFileNameExtension()
+    , KWindowInfoPrivatePidExtension()
+    , m_valid(false)
+{
+    installDesktopFileNameExtension(this);
+    installPidExtension(this);
+
+    // copy everything, no matter which properties were requested, the members are implicitly shared
+    if (const KWindowSystemSimulation::Window *w = KWindowSystemSimulation::self()->window(window)) {
+        m_window = *w;
+        m_valid = true;
+    }
+}
+
+KWindowInfoPrivateSimulated::~KWindowInfoPrivateSimulated()
+{
+}
+
+bool KWindowInfoPrivateSimulated::valid(bool withdrawn_is_valid) const
+{
+    if (!m_valid) {
+        return false;
+    }
+    if (!withdrawn_is_valid && mappingState() == NET::Withdrawn) {
+        return false;
+    }
+    return true;
+}
+
+NET::States KWindowInfoPrivateSimulated::state() const
+{
+    return m_window.state;
+}
+
+bool KWindowInfoPrivateSimulated::isMinimized() const
+{
+    return m_window.mappingState == NET::Iconic
+           && (m_window.state & NET::Hidden) && !(m_window.state & NET::Shaded);
+}
+
+NET::MappingState KWindowInfoPrivateSimulated::mappingState() const
+{
+    return m_window.mappingState;
+}
+
+NETExtendedStrut KWindowInfoPrivateSimulated::extendedStrut() const
+{
+    return m_window.strut;
+}
+
+NET::WindowType KWindowInfoPrivateSimulated::windowType(NET::WindowTypes supported_types) const
+{
+    const NET::WindowType type = m_window.windowType;
+    if (type == NET::Unknown) { // fallback, per spec recommendation
+        if (m_window.transientFor) {
+            return (supported_types & NET::DialogMask) ? NET::Dialog : NET::Unknown;
+        }
+        return (supported_types & NET::NormalMask) ? NET::Normal : NET::Unknown;
+    }
+    // the mask values follow the order of the types
+    if (type < 0 || !(supported_types & NET::WindowTypeMask(1u << type))) {
+        return NET::Unknown;
+    }
+    return type;
+}
+
+QString KWindowInfoPrivateSimulated::visibleNameWithState() const
+{
+    QString s = visibleName();
+    if (isMinimized()) {
+        s.prepend(QLatin1Char('('));
+        s.append(QLatin1Char(')'));
+    }
+    return s;
+}
+
+QString KWindowInfoPrivateSimulated::visibleName() const
+{
+    return !m_window.visibleName.isEmpty() ? m_window.visibleName : name();
+}
+
+QString KWindowInfoPrivateSimulated::name() const
+{
+    return m_window.name;
+}
+
+QString KWindowInfoPrivateSimulated::visibleIconNameWithState() const
+{
+    QString s = visibleIconName();
+    if (isMinimized()) {
+        s.prepend(QLatin1Char('('));
+        s.append(QLatin1Char(')'));
+    }
+    return s;
+}
+
+QString KWindowInfoPrivateSimulated::visibleIconName() const
+{
+    if (!m_window.visibleIconName.isEmpty()) {
+        return m_window.visibleIconName;
+    }
+    if (!m_window.iconName.isEmpty()) {
+        return m_window.iconName;
+    }
+    return visibleName();
+}
+
+QString KWindowInfoPrivateSimulated::iconName() const
+{
+    return !m_window.iconName.isEmpty() ? m_window.iconName : name();
+}
+
+bool KWindowInfoPrivateSimulated::isOnDesktop(int desktop) const
+{
+    return m_window.desktop == desktop || m_window.desktop == NET::OnAllDesktops;
+}
+
+bool KWindowInfoPrivateSimulated::onAllDesktops() const
+{
+    return m_window.desktop == NET::OnAllDesktops;
+}
+
+int KWindowInfoPrivateSimulated::desktop() const
+{
+    return m_window.desktop;
+}
+
+QStringList KWindowInfoPrivateSimulated::activities() const
+{
+    return m_window.activities;
+}
+
+QRect KWindowInfoPrivateSimulated::geometry() const
+{
+    return m_window.geometry;
+}
+
+QRect KWindowInfoPrivateSimulated::frameGeometry() const
+{
+    return m_window.frameGeometry.isEmpty() ? m_window.geometry : m_window.frameGeometry;
+}
+
+WId KWindowInfoPrivateSimulated::transientFor() const
+{
+    return m_window.transientFor;
+}
+
+WId KWindowInfoPrivateSimulated::groupLeader() const
+{
+    return m_window.groupLeader;
+}
+
+QByteArray KWindowInfoPrivateSimulated::windowClassClass() const
+{
+    return m_window.windowClassClass;
+}
+
+QByteArray KWindowInfoPrivateSimulated::windowClassName() const
+{
+    return m_window.windowClassName;
+}
+
+QByteArray KWindowInfoPrivateSimulated::windowRole() const
+{
+    return m_window.windowRole;
+}
+
+QByteArray KWindowInfoPrivateSimulated::clientMachine() const
+{
+    return m_window.clientMachine;
+}
+
+bool KWindowInfoPrivateSimulated::actionSupported(NET::Action action) const
+{
+    return m_window.allowedActions & action;
+}
+
+QByteArray KWindowInfoPrivateSimulated::desktopFileName() const
+{
+    return m_window.desktopFileName;
+}
+
+int KWindowInfoPrivateSimulated::pid() const
+{
+    return m_window.pid;
+}
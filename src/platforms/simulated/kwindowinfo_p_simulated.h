@@ -0,0 +1,65 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KWINDOWINFO_P_SIMULATED_H
+#define KWINDOWINFO_P_SIMULATED_H
+#include "kwindowinfo_p.h"
+#include "kwindowsystemsimulation.h"
+
+// A snapshot of the simulated window, like the X11 backend reads the properties once
+class KWindowInfoPrivateSimulated : public KWindowInfoPrivate, public KWindowInfoPrivateDesktopFileNameExtension, public KWindowInfoPrivatePidExtension
+{
+public:
+    KWindowInfoPrivateSimulated(WId window, NET::Properties properties, NET::Properties2 properties2);
+    ~KWindowInfoPrivateSimulated() override;
+
+    bool valid(bool withdrawn_is_valid) const override;
+    NET::States state() const override;
+    bool isMinimized() const override;
+    NET::MappingState mappingState() const override;
+    NETExtendedStrut extendedStrut() const override;
+    NET::WindowType windowType(NET::WindowTypes supported_types) const override;
+    QString visibleName() const override;
+    QString visibleNameWithState() const override;
+    QString name() const override;
+    QString visibleIconName() const override;
+    QString visibleIconNameWithState() const override;
+    QString iconName() const override;
+    bool onAllDesktops() const override;
+    bool isOnDesktop(int desktop) const override;
+    int desktop() const override;
+    QStringList activities() const override;
+    QRect geometry() const override;
+    QRect frameGeometry() const override;
+    WId transientFor() const override;
+    WId groupLeader() const override;
+    QByteArray windowClassClass() const override;
+    QByteArray windowClassName() const override;
+    QByteArray windowRole() const override;
+    QByteArray clientMachine() const override;
+    bool actionSupported(NET::Action action) const override;
+
+    QByteArray desktopFileName() const override;
+
+    int pid() const override;
+
+private:
+    KWindowSystemSimulation::Window m_window;
+    bool m_valid;
+};
+
+#endif
@@ -0,0 +1,352 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kwindowsystem_p_simulated.h"
+#include "kwindowsystemsimulation.h"
+
+#include <QPoint>
+
+static KWindowSystemSimulation *simulation()
+{
+    return KWindowSystemSimulation::self();
+}
+
+QList<WId> KWindowSystemPrivateSimulated::windows()
+{
+    return simulation()->windows();
+}
+
+QList<WId> KWindowSystemPrivateSimulated::stackingOrder()
+{
+    return simulation()->stackingOrder();
+}
+
+WId KWindowSystemPrivateSimulated::activeWindow()
+{
+    return simulation()->activeWindow();
+}
+
+void KWindowSystemPrivateSimulated::activateWindow(WId win, long time)
+{
+    Q_UNUSED(time)
+    const KWindowSystemSimulation::Window *window = simulation()->window(win);
+    if (!window) {
+        return;
+    }
+    if (window->state & NET::Hidden) {
+        unminimizeWindow(win);
+    }
+    simulation()->setActiveWindow(win);
+    simulation()->raiseWindow(win);
+}
+
+void KWindowSystemPrivateSimulated::forceActiveWindow(WId win, long time)
+{
+    activateWindow(win, time);
+}
+
+void KWindowSystemPrivateSimulated::demandAttention(WId win, bool set)
+{
+    if (set) {
+        setState(win, NET::DemandsAttention);
+    } else {
+        clearState(win, NET::DemandsAttention);
+    }
+}
+
+bool KWindowSystemPrivateSimulated::compositingActive()
+{
+    return simulation()->compositingActive();
+}
+
+int KWindowSystemPrivateSimulated::currentDesktop()
+{
+    return simulation()->currentDesktop();
+}
+
+int KWindowSystemPrivateSimulated::numberOfDesktops()
+{
+    return simulation()->numberOfDesktops();
+}
+
+void KWindowSystemPrivateSimulated::setCurrentDesktop(int desktop)
+{
+    simulation()->setCurrentDesktop(desktop);
+}
+
+void KWindowSystemPrivateSimulated::setOnAllDesktops(WId win, bool b)
+{
+    const int desktop = b ? int(NET::OnAllDesktops) : simulation()->currentDesktop();
+    simulation()->changeWindow(win, [desktop](KWindowSystemSimulation::Window &window) {
+        window.desktop = desktop;
+    }, NET::WMDesktop);
+}
+
+void KWindowSystemPrivateSimulated::setOnDesktop(WId win, int desktop)
+{
+    if (desktop != NET::OnAllDesktops && (desktop < 1 || desktop > simulation()->numberOfDesktops())) {
+        return;
+    }
+    simulation()->changeWindow(win, [desktop](KWindowSystemSimulation::Window &window) {
+        window.desktop = desktop;
+    }, NET::WMDesktop);
+}
+
+void KWindowSystemPrivateSimulated::setOnActivities(WId win, const QStringList &activities)
+{
+    simulation()->changeWindow(win, [&activities](KWindowSystemSimulation::Window &window) {
+        window.activities = activities;
+    }, NET::Properties(), NET::WM2Activities);
+}
+
+#if KWINDOWSYSTEM_BUILD_DEPRECATED_SINCE(5, 0)
+WId KWindowSystemPrivateSimulated::transientFor(WId window)
+{
+    const KWindowSystemSimulation::Window *w = simulation()->window(window);
+    return w ? w->transientFor : 0;
+}
+
+WId KWindowSystemPrivateSimulated::groupLeader(WId window)
+{
+    const KWindowSystemSimulation::Window *w = simulation()->window(window);
+    return w ? w->groupLeader : 0;
+}
+#endif
+
+QPixmap KWindowSystemPrivateSimulated::icon(WId win, int width, int height, bool scale, int flags)
+{
+    Q_UNUSED(flags)
+    const KWindowSystemSimulation::Window *window = simulation()->window(win);
+    if (!window || window->icon.isNull()) {
+        return QPixmap();
+    }
+    if (scale && width > 0 && height > 0 && window->icon.size() != QSize(width, height)) {
+        return window->icon.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return window->icon;
+}
+
+void KWindowSystemPrivateSimulated::setIcons(WId win, const QPixmap &icon, const QPixmap &miniIcon)
+{
+    Q_UNUSED(miniIcon)
+    simulation()->changeWindow(win, [&icon](KWindowSystemSimulation::Window &window) {
+        window.icon = icon;
+    }, NET::WMIcon);
+}
+
+void KWindowSystemPrivateSimulated::setType(WId win, NET::WindowType windowType)
+{
+    simulation()->changeWindow(win, [windowType](KWindowSystemSimulation::Window &window) {
+        window.windowType = windowType;
+    }, NET::WMWindowType);
+}
+
+void KWindowSystemPrivateSimulated::setState(WId win, NET::States state)
+{
+    const KWindowSystemSimulation::Window *current = simulation()->window(win);
+    if (!current || (current->state & state) == state) {
+        return;
+    }
+    simulation()->changeWindow(win, [state](KWindowSystemSimulation::Window &window) {
+        window.state |= state;
+    }, NET::WMState);
+}
+
+void KWindowSystemPrivateSimulated::clearState(WId win, NET::States state)
+{
+    const KWindowSystemSimulation::Window *current = simulation()->window(win);
+    if (!current || !(current->state & state)) {
+        return;
+    }
+    simulation()->changeWindow(win, [state](KWindowSystemSimulation::Window &window) {
+        window.state &= ~state;
+    }, NET::WMState);
+}
+
+void KWindowSystemPrivateSimulated::minimizeWindow(WId win)
+{
+    const KWindowSystemSimulation::Window *current = simulation()->window(win);
+    if (!current || (current->state & NET::Hidden)) {
+        return;
+    }
+    simulation()->changeWindow(win, [](KWindowSystemSimulation::Window &window) {
+        window.state |= NET::Hidden;
+        window.mappingState = NET::Iconic;
+    }, NET::WMState | NET::XAWMState);
+    if (simulation()->activeWindow() == win) {
+        simulation()->setActiveWindow(0);
+    }
+}
+
+void KWindowSystemPrivateSimulated::unminimizeWindow(WId win)
+{
+    const KWindowSystemSimulation::Window *current = simulation()->window(win);
+    if (!current || !(current->state & NET::Hidden)) {
+        return;
+    }
+    simulation()->changeWindow(win, [](KWindowSystemSimulation::Window &window) {
+        window.state &= ~NET::States(NET::Hidden);
+        window.mappingState = NET::Visible;
+    }, NET::WMState | NET::XAWMState);
+}
+
+void KWindowSystemPrivateSimulated::raiseWindow(WId win)
+{
+    simulation()->raiseWindow(win);
+}
+
+void KWindowSystemPrivateSimulated::lowerWindow(WId win)
+{
+    simulation()->lowerWindow(win);
+}
+
+bool KWindowSystemPrivateSimulated::icccmCompliantMappingState()
+{
+    return true;
+}
+
+QRect KWindowSystemPrivateSimulated::workArea(int desktop)
+{
+    if (desktop <= 0 || desktop > simulation()->numberOfDesktops()) {
+        desktop = simulation()->currentDesktop();
+    }
+    return simulation()->workArea(QList<WId>(), desktop);
+}
+
+QRect KWindowSystemPrivateSimulated::workArea(const QList<WId> &excludes, int desktop)
+{
+    return simulation()->workArea(excludes, desktop);
+}
+
+QString KWindowSystemPrivateSimulated::desktopName(int desktop)
+{
+    return simulation()->desktopName(desktop);
+}
+
+void KWindowSystemPrivateSimulated::setDesktopName(int desktop, const QString &name)
+{
+    simulation()->setDesktopName(desktop, name);
+}
+
+bool KWindowSystemPrivateSimulated::showingDesktop()
+{
+    return simulation()->showingDesktop();
+}
+
+void KWindowSystemPrivateSimulated::setShowingDesktop(bool showing)
+{
+    simulation()->setShowingDesktop(showing);
+}
+
+void KWindowSystemPrivateSimulated::setUserTime(WId win, long time)
+{
+    simulation()->changeWindow(win, [time](KWindowSystemSimulation::Window &window) {
+        window.userTime = time;
+    }, NET::Properties(), NET::WM2UserTime);
+}
+
+void KWindowSystemPrivateSimulated::setExtendedStrut(WId win, int left_width, int left_start, int left_end,
+                                                     int right_width, int right_start, int right_end, int top_width, int top_start, int top_end,
+                                                     int bottom_width, int bottom_start, int bottom_end)
+{
+    NETExtendedStrut strut;
+    strut.left_width = left_width;
+    strut.left_start = left_start;
+    strut.left_end = left_end;
+    strut.right_width = right_width;
+    strut.right_start = right_start;
+    strut.right_end = right_end;
+    strut.top_width = top_width;
+    strut.top_start = top_start;
+    strut.top_end = top_end;
+    strut.bottom_width = bottom_width;
+    strut.bottom_start = bottom_start;
+    strut.bottom_end = bottom_end;
+    simulation()->changeWindow(win, [&strut](KWindowSystemSimulation::Window &window) {
+        window.strut = strut;
+    }, NET::WMStrut, NET::WM2ExtendedStrut);
+}
+
+void KWindowSystemPrivateSimulated::setStrut(WId win, int left, int right, int top, int bottom)
+{
+    // a simple strut spans the whole screen edge, see KWindowInfo::extendedStrut()
+    const QRect screen = simulation()->screenGeometry();
+    setExtendedStrut(win, left, 0, left != 0 ? screen.height() : 0,
+                     right, 0, right != 0 ? screen.height() : 0,
+                     top, 0, top != 0 ? screen.width() : 0,
+                     bottom, 0, bottom != 0 ? screen.width() : 0);
+}
+
+bool KWindowSystemPrivateSimulated::allowedActionsSupported()
+{
+    return true;
+}
+
+QString KWindowSystemPrivateSimulated::readNameProperty(WId window, unsigned long atom)
+{
+    Q_UNUSED(atom)
+    const KWindowSystemSimulation::Window *w = simulation()->window(window);
+    return w ? w->name : QString();
+}
+
+void KWindowSystemPrivateSimulated::allowExternalProcessWindowActivation(int pid)
+{
+    Q_UNUSED(pid)
+}
+
+void KWindowSystemPrivateSimulated::setBlockingCompositing(WId window, bool active)
+{
+    simulation()->changeWindow(window, [active](KWindowSystemSimulation::Window &window) {
+        window.blockingCompositing = active;
+    }, NET::Properties(), NET::WM2BlockCompositing);
+}
+
+bool KWindowSystemPrivateSimulated::mapViewport()
+{
+    return false;
+}
+
+int KWindowSystemPrivateSimulated::viewportToDesktop(const QPoint &pos)
+{
+    Q_UNUSED(pos)
+    return 0;
+}
+
+int KWindowSystemPrivateSimulated::viewportWindowToDesktop(const QRect &r)
+{
+    Q_UNUSED(r)
+    return 0;
+}
+
+QPoint KWindowSystemPrivateSimulated::desktopToViewport(int desktop, bool absolute)
+{
+    Q_UNUSED(desktop)
+    Q_UNUSED(absolute)
+    return QPoint();
+}
+
+QPoint KWindowSystemPrivateSimulated::constrainViewportRelativePosition(const QPoint &pos)
+{
+    Q_UNUSED(pos)
+    return QPoint();
+}
+
+void KWindowSystemPrivateSimulated::connectNotify(const QMetaMethod &signal)
+{
+    // all signals are emitted right away, there's nothing to set up
+    Q_UNUSED(signal)
+}
@@ -0,0 +1,429 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kwindowsystemsimulation.h"
+
+#include <kwindowsystem.h>
+
+#include <QRandomGenerator>
+#include <QVector>
+
+static const int s_initialDesktops = 4;
+
+static QString defaultDesktopName(int desktop)
+{
+    return QStringLiteral("Desktop %1").arg(desktop);
+}
+
+KWindowSystemSimulation::KWindowSystemSimulation()
+{
+    reset();
+}
+
+KWindowSystemSimulation *KWindowSystemSimulation::self()
+{
+    static KWindowSystemSimulation s_simulation;
+    return &s_simulation;
+}
+
+void KWindowSystemSimulation::reset()
+{
+    m_windows.clear();
+    m_stacking.clear();
+    m_stackingPosition.clear();
+    m_activeWindow = 0;
+    m_currentDesktop = 1;
+    m_desktopNames.clear();
+    for (int i = 1; i <= s_initialDesktops; ++i) {
+        m_desktopNames << defaultDesktopName(i);
+    }
+    m_showingDesktop = false;
+    m_compositingActive = true;
+    m_screenGeometry = QRect(0, 0, 1920, 1080);
+}
+
+bool KWindowSystemSimulation::hasStrut(const Window &window)
+{
+    return window.strut.left_width || window.strut.right_width || window.strut.top_width || window.strut.bottom_width;
+}
+
+WId KWindowSystemSimulation::addWindow(const Window &window)
+{
+    const WId id = ++m_nextId;
+    m_windows.insert(id, window);
+    stackAt(id, m_stacking.isEmpty() ? 0 : m_stacking.lastKey() + 1);
+
+    KWindowSystem *s_q = KWindowSystem::self();
+    emit s_q->windowAdded(id);
+    emit s_q->stackingOrderChanged();
+    if (hasStrut(window)) {
+        emit s_q->strutChanged();
+        emit s_q->workAreaChanged();
+    }
+    return id;
+}
+
+void KWindowSystemSimulation::removeWindow(WId id)
+{
+    auto it = m_windows.find(id);
+    if (it == m_windows.end()) {
+        return;
+    }
+    const bool hadStrut = hasStrut(*it);
+    m_windows.erase(it);
+    m_stacking.remove(m_stackingPosition.take(id));
+
+    KWindowSystem *s_q = KWindowSystem::self();
+    if (m_activeWindow == id) {
+        m_activeWindow = 0;
+        emit s_q->activeWindowChanged(0);
+    }
+    emit s_q->windowRemoved(id);
+    emit s_q->stackingOrderChanged();
+    if (hadStrut) {
+        emit s_q->strutChanged();
+        emit s_q->workAreaChanged();
+    }
+}
+
+const KWindowSystemSimulation::Window *KWindowSystemSimulation::window(WId id) const
+{
+    auto it = m_windows.constFind(id);
+    return it != m_windows.constEnd() ? &it.value() : nullptr;
+}
+
+void KWindowSystemSimulation::changeWindow(WId id, const std::function<void(Window &)> &change,
+                                           NET::Properties properties, NET::Properties2 properties2)
+{
+    auto it = m_windows.find(id);
+    if (it == m_windows.end()) {
+        return;
+    }
+    change(*it);
+    emitWindowChanged(id, properties, properties2);
+}
+
+void KWindowSystemSimulation::emitWindowChanged(WId id, NET::Properties properties, NET::Properties2 properties2)
+{
+    if (!properties && !properties2) {
+        return;
+    }
+    KWindowSystem *s_q = KWindowSystem::self();
+    emit s_q->windowChanged(id);
+    emit s_q->windowChanged(id, properties, properties2);
+#if KWINDOWSYSTEM_BUILD_DEPRECATED_SINCE(5, 0)
+    unsigned long dirty[ 2 ] = {properties, properties2};
+    emit s_q->windowChanged(id, dirty);
+    emit s_q->windowChanged(id, properties);
+#endif
+    if (properties & NET::WMStrut) {
+        emit s_q->strutChanged();
+        emit s_q->workAreaChanged();
+    }
+}
+
+QList<WId> KWindowSystemSimulation::windows() const
+{
+    return m_windows.keys();
+}
+
+QList<WId> KWindowSystemSimulation::stackingOrder() const
+{
+    return m_stacking.values();
+}
+
+void KWindowSystemSimulation::stackAt(WId id, qint64 position)
+{
+    auto it = m_stackingPosition.find(id);
+    if (it != m_stackingPosition.end()) {
+        m_stacking.remove(*it);
+        *it = position;
+    } else {
+        m_stackingPosition.insert(id, position);
+    }
+    m_stacking.insert(position, id);
+}
+
+void KWindowSystemSimulation::raiseWindow(WId id)
+{
+    if (!m_windows.contains(id) || m_stacking.last() == id) {
+        return;
+    }
+    stackAt(id, m_stacking.lastKey() + 1);
+    emit KWindowSystem::self()->stackingOrderChanged();
+}
+
+void KWindowSystemSimulation::lowerWindow(WId id)
+{
+    if (!m_windows.contains(id) || m_stacking.first() == id) {
+        return;
+    }
+    stackAt(id, m_stacking.firstKey() - 1);
+    emit KWindowSystem::self()->stackingOrderChanged();
+}
+
+WId KWindowSystemSimulation::activeWindow() const
+{
+    return m_activeWindow;
+}
+
+void KWindowSystemSimulation::setActiveWindow(WId id)
+{
+    if (id && !m_windows.contains(id)) {
+        return;
+    }
+    if (m_activeWindow == id) {
+        return;
+    }
+    m_activeWindow = id;
+    emit KWindowSystem::self()->activeWindowChanged(id);
+}
+
+int KWindowSystemSimulation::numberOfDesktops() const
+{
+    return m_desktopNames.count();
+}
+
+void KWindowSystemSimulation::setNumberOfDesktops(int count)
+{
+    if (count < 1 || count == numberOfDesktops()) {
+        return;
+    }
+    while (m_desktopNames.count() > count) {
+        m_desktopNames.removeLast();
+    }
+    while (m_desktopNames.count() < count) {
+        m_desktopNames << defaultDesktopName(m_desktopNames.count() + 1);
+    }
+
+    KWindowSystem *s_q = KWindowSystem::self();
+    // like the window manager, move the windows of removed desktops to the last one
+    for (auto it = m_windows.begin(); it != m_windows.end(); ++it) {
+        if (it->desktop > count) {
+            it->desktop = count;
+            emitWindowChanged(it.key(), NET::WMDesktop, NET::Properties2());
+        }
+    }
+    if (m_currentDesktop > count) {
+        m_currentDesktop = count;
+        emit s_q->currentDesktopChanged(count);
+    }
+    emit s_q->numberOfDesktopsChanged(count);
+    emit s_q->desktopNamesChanged();
+    emit s_q->workAreaChanged();
+}
+
+int KWindowSystemSimulation::currentDesktop() const
+{
+    return m_currentDesktop;
+}
+
+void KWindowSystemSimulation::setCurrentDesktop(int desktop)
+{
+    if (desktop < 1 || desktop > numberOfDesktops() || desktop == m_currentDesktop) {
+        return;
+    }
+    m_currentDesktop = desktop;
+    emit KWindowSystem::self()->currentDesktopChanged(desktop);
+}
+
+QString KWindowSystemSimulation::desktopName(int desktop) const
+{
+    if (desktop < 1 || desktop > numberOfDesktops()) {
+        desktop = m_currentDesktop;
+    }
+    return m_desktopNames.at(desktop - 1);
+}
+
+void KWindowSystemSimulation::setDesktopName(int desktop, const QString &name)
+{
+    if (desktop < 1 || desktop > numberOfDesktops() || m_desktopNames.at(desktop - 1) == name) {
+        return;
+    }
+    m_desktopNames[desktop - 1] = name;
+    emit KWindowSystem::self()->desktopNamesChanged();
+}
+
+bool KWindowSystemSimulation::showingDesktop() const
+{
+    return m_showingDesktop;
+}
+
+void KWindowSystemSimulation::setShowingDesktop(bool showing)
+{
+    if (m_showingDesktop == showing) {
+        return;
+    }
+    m_showingDesktop = showing;
+    emit KWindowSystem::self()->showingDesktopChanged(showing);
+}
+
+bool KWindowSystemSimulation::compositingActive() const
+{
+    return m_compositingActive;
+}
+
+void KWindowSystemSimulation::setCompositingActive(bool active)
+{
+    if (m_compositingActive == active) {
+        return;
+    }
+    m_compositingActive = active;
+    emit KWindowSystem::self()->compositingChanged(active);
+}
+
+QRect KWindowSystemSimulation::screenGeometry() const
+{
+    return m_screenGeometry;
+}
+
+void KWindowSystemSimulation::setScreenGeometry(const QRect &geometry)
+{
+    if (m_screenGeometry == geometry) {
+        return;
+    }
+    m_screenGeometry = geometry;
+    emit KWindowSystem::self()->workAreaChanged();
+}
+
+QRect KWindowSystemSimulation::workArea(const QList<WId> &excludes, int desktop) const
+{
+    if (desktop == -1) {
+        desktop = m_currentDesktop;
+    }
+
+    const QRect all = m_screenGeometry;
+    QRect a = all;
+    for (auto it = m_windows.constBegin(); it != m_windows.constEnd(); ++it) {
+        const Window &window = it.value();
+        if (!hasStrut(window) || excludes.contains(it.key())) {
+            continue;
+        }
+        if (window.desktop != desktop && window.desktop != NET::OnAllDesktops) {
+            continue;
+        }
+        QRect r = all;
+        if (window.strut.left_width > 0) {
+            r.setLeft(r.left() + window.strut.left_width);
+        }
+        if (window.strut.top_width > 0) {
+            r.setTop(r.top() + window.strut.top_width);
+        }
+        if (window.strut.right_width > 0) {
+            r.setRight(r.right() - window.strut.right_width);
+        }
+        if (window.strut.bottom_width > 0) {
+            r.setBottom(r.bottom() - window.strut.bottom_width);
+        }
+        a = a.intersected(r);
+    }
+    return a;
+}
+
+QList<WId> KWindowSystemSimulation::windowStorm(int count, quint32 seed)
+{
+    QRandomGenerator random(seed);
+    QList<WId> ret;
+    ret.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        Window window;
+        const int application = random.bounded(50);
+        window.name = QStringLiteral("Document %1 - Application %2").arg(i).arg(application);
+        window.iconName = QStringLiteral("Document %1").arg(i);
+        window.windowClassName = QByteArrayLiteral("application") + QByteArray::number(application);
+        window.windowClassClass = QByteArrayLiteral("Application") + QByteArray::number(application);
+        window.desktopFileName = QByteArrayLiteral("org.kde.application") + QByteArray::number(application);
+        window.clientMachine = QByteArrayLiteral("localhost");
+        window.pid = 1000 + application;
+        window.desktop = 1 + random.bounded(numberOfDesktops());
+        const int width = 200 + random.bounded(800);
+        const int height = 150 + random.bounded(600);
+        window.geometry = QRect(m_screenGeometry.x() + random.bounded(qMax(1, m_screenGeometry.width() - width)),
+                                m_screenGeometry.y() + random.bounded(qMax(1, m_screenGeometry.height() - height)),
+                                width, height);
+        window.frameGeometry = window.geometry.adjusted(-2, -24, 2, 2);
+
+        const int kind = random.bounded(20);
+        if (kind < 2 && !ret.isEmpty()) {
+            // a dialog of the previous window
+            const Window *parent = this->window(ret.last());
+            window.windowType = NET::Dialog;
+            window.transientFor = ret.last();
+            window.groupLeader = ret.last();
+            window.desktop = parent->desktop;
+        } else if (kind == 2) {
+            window.desktop = NET::OnAllDesktops;
+            window.state |= NET::Sticky;
+        } else if (kind < 5) {
+            window.state |= NET::Hidden;
+            window.mappingState = NET::Iconic;
+        }
+        ret << addWindow(window);
+    }
+    return ret;
+}
+
+void KWindowSystemSimulation::propertyChurn(int count, quint32 seed)
+{
+    // the churn changes windows, but never maps or unmaps any
+    const QVector<WId> ids = m_windows.keys().toVector();
+    if (ids.isEmpty()) {
+        return;
+    }
+    QRandomGenerator random(seed);
+    for (int i = 0; i < count; ++i) {
+        const WId id = ids.at(random.bounded(ids.count()));
+        switch (random.bounded(6)) {
+        case 0:
+            // e.g. a browser loading a page or a terminal running a command
+            changeWindow(id, [i](Window &window) {
+                window.name = QStringLiteral("Title %1").arg(i);
+            }, NET::WMName | NET::WMVisibleName);
+            break;
+        case 1:
+            changeWindow(id, [](Window &window) {
+                window.state ^= NET::Max;
+            }, NET::WMState);
+            break;
+        case 2: {
+            const int desktop = 1 + random.bounded(numberOfDesktops());
+            changeWindow(id, [desktop](Window &window) {
+                window.desktop = desktop;
+            }, NET::WMDesktop);
+            break;
+        }
+        case 3: {
+            const QPoint offset(random.bounded(-50, 50), random.bounded(-50, 50));
+            changeWindow(id, [offset](Window &window) {
+                window.geometry.translate(offset);
+                window.frameGeometry.translate(offset);
+            }, NET::WMGeometry | NET::WMFrameExtents);
+            break;
+        }
+        case 4:
+            setActiveWindow(id);
+            raiseWindow(id);
+            break;
+        case 5:
+            changeWindow(id, [](Window &window) {
+                window.state ^= NET::Hidden;
+                window.mappingState = (window.state & NET::Hidden) ? NET::Iconic : NET::Visible;
+            }, NET::WMState | NET::XAWMState);
+            break;
+        }
+    }
+}
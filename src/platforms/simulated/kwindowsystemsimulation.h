@@ -0,0 +1,182 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KWINDOWSYSTEMSIMULATION_H
+#define KWINDOWSYSTEMSIMULATION_H
+
+#include <netwm_def.h>
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QPixmap>
+#include <QRect>
+#include <QStringList>
+#include <QWidgetList> //For WId
+
+#include <functional>
+
+/**
+ * An in-memory window system to test and benchmark KWindowSystem consumers
+ * such as task managers and pagers without an X server.
+ *
+ * The simulation is a static plugin which is only installed when
+ * KWindowSystem is configured with KWINDOWSYSTEM_SIMULATED_PLUGIN. Link
+ * KF5::WindowSystemSimulatedPlugin into the executable and import it with
+ * Q_IMPORT_PLUGIN(SimulatedPlugin). It then replaces the dummy backend for
+ * the offscreen and minimal platforms.
+ *
+ * The simulation models windows with their properties, virtual desktops,
+ * the stacking order and struts. Changes made through this class or the
+ * KWindowSystem API immediately emit the same KWindowSystem signals the X11
+ * backend emits for them. Everything is deterministic, the load generators
+ * take a seed.
+ *
+ * @since 5.65
+ */
+class KWindowSystemSimulation
+{
+public:
+    struct Window {
+        QString name;
+        QString visibleName;
+        QString iconName;
+        QString visibleIconName;
+        NET::WindowType windowType = NET::Normal;
+        NET::States state;
+        NET::MappingState mappingState = NET::Visible;
+        int desktop = 1;
+        QStringList activities;
+        QRect geometry = QRect(0, 0, 640, 480);
+        /// An empty rectangle means the same as geometry
+        QRect frameGeometry;
+        WId transientFor = 0;
+        WId groupLeader = 0;
+        QByteArray windowClassClass;
+        QByteArray windowClassName;
+        QByteArray windowRole;
+        QByteArray clientMachine;
+        QByteArray desktopFileName;
+        int pid = 0;
+        NET::Actions allowedActions = NET::ActionMove | NET::ActionResize | NET::ActionMinimize
+                                      | NET::ActionShade | NET::ActionStick | NET::ActionMax
+                                      | NET::ActionFullScreen | NET::ActionChangeDesktop | NET::ActionClose;
+        NETExtendedStrut strut;
+        QPixmap icon;
+        long userTime = 0;
+        bool blockingCompositing = false;
+    };
+
+    static KWindowSystemSimulation *self();
+
+    /**
+     * Removes all windows and restores the initial state: 4 desktops named
+     * "Desktop 1" to "Desktop 4", the first one current, a 1920x1080 screen
+     * and compositing enabled. Emits no signals.
+     */
+    void reset();
+
+    /**
+     * Maps @p window on top of the stacking order and emits windowAdded().
+     * @return the id of the new window
+     */
+    WId addWindow(const Window &window = Window());
+    /**
+     * Unmaps the window and emits windowRemoved().
+     */
+    void removeWindow(WId id);
+    /**
+     * @return the window with @p id, or @c nullptr if there is none
+     */
+    const Window *window(WId id) const;
+    /**
+     * Lets @p change modify the window with @p id and emits windowChanged()
+     * for @p properties and @p properties2, plus strutChanged() for
+     * NET::WMStrut. Nothing happens if there is no such window.
+     */
+    void changeWindow(WId id, const std::function<void(Window &)> &change,
+                      NET::Properties properties, NET::Properties2 properties2 = NET::Properties2());
+
+    /// The windows in the order they got mapped
+    QList<WId> windows() const;
+    /// The windows from bottom to top
+    QList<WId> stackingOrder() const;
+    void raiseWindow(WId id);
+    void lowerWindow(WId id);
+
+    WId activeWindow() const;
+    /// Activates the window with @p id, or no window for 0
+    void setActiveWindow(WId id);
+
+    int numberOfDesktops() const;
+    void setNumberOfDesktops(int count);
+    int currentDesktop() const;
+    void setCurrentDesktop(int desktop);
+    QString desktopName(int desktop) const;
+    void setDesktopName(int desktop, const QString &name);
+    bool showingDesktop() const;
+    void setShowingDesktop(bool showing);
+    bool compositingActive() const;
+    void setCompositingActive(bool active);
+    QRect screenGeometry() const;
+    void setScreenGeometry(const QRect &geometry);
+
+    /**
+     * @return the screen without the struts of all windows on @p desktop,
+     * except @p excludes. A @p desktop of -1 means the current desktop.
+     */
+    QRect workArea(const QList<WId> &excludes, int desktop) const;
+
+    /**
+     * Maps @p count windows in a row, like a session being restored. The
+     * windows are spread over all desktops, some are dialogs of the window
+     * before, on all desktops or minimized.
+     * @return the ids of the new windows
+     */
+    QList<WId> windowStorm(int count, quint32 seed = 0);
+
+    /**
+     * Makes @p count changes to random windows: renaming them, changing
+     * their state, desktop or geometry, or activating them, as applications
+     * and the window manager constantly do.
+     */
+    void propertyChurn(int count, quint32 seed = 0);
+
+private:
+    KWindowSystemSimulation();
+    void emitWindowChanged(WId id, NET::Properties properties, NET::Properties2 properties2);
+    static bool hasStrut(const Window &window);
+    void stackAt(WId id, qint64 position);
+
+    // Ids are handed out in increasing order, so the map iterates the
+    // windows in the order they got mapped.
+    QMap<WId, Window> m_windows;
+    // The stacking order keyed by position: raising and lowering take a
+    // position above the top or below the bottom window.
+    QMap<qint64, WId> m_stacking;
+    QHash<WId, qint64> m_stackingPosition;
+    WId m_activeWindow = 0;
+    WId m_nextId = 0;
+    int m_currentDesktop = 1;
+    QStringList m_desktopNames;
+    bool m_showingDesktop = false;
+    bool m_compositingActive = true;
+    QRect m_screenGeometry;
+};
+
+#endif
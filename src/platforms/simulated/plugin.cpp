@@ -0,0 +1,39 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "plugin.h"
+#include "kwindowinfo_p_simulated.h"
+#include "kwindowsystem_p_simulated.h"
+
+SimulatedPlugin::SimulatedPlugin(QObject *parent)
+    : KWindowSystemPluginInterface(parent)
+{
+}
+
+SimulatedPlugin::~SimulatedPlugin()
+{
+}
+
+KWindowSystemPrivate *SimulatedPlugin::createWindowSystem()
+{
+    return new KWindowSystemPrivateSimulated();
+}
+
+KWindowInfoPrivate *SimulatedPlugin::createWindowInfo(WId window, NET::Properties properties, NET::Properties2 properties2)
+{
+    return new KWindowInfoPrivateSimulated(window, properties, properties2);
+}
@@ -0,0 +1,37 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KWINDOWSYSTEM_SIMULATED_PLUGIN_H
+#define KWINDOWSYSTEM_SIMULATED_PLUGIN_H
+
+#include "kwindowsystemplugininterface_p.h"
+
+class SimulatedPlugin : public KWindowSystemPluginInterface
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.kde.kwindowsystem.KWindowSystemPluginInterface" FILE "simulated.json")
+    Q_INTERFACES(KWindowSystemPluginInterface)
+
+public:
+    explicit SimulatedPlugin(QObject *parent = nullptr);
+    ~SimulatedPlugin() override;
+
+    KWindowSystemPrivate *createWindowSystem() override;
+    KWindowInfoPrivate *createWindowInfo(WId window, NET::Properties properties, NET::Properties2 properties2) override;
+};
+
+#endif
@@ -20,18 +20,28 @@
 
 #include "kkeyserver_x11.h"
 #include "kkeyserver.h"
+#include "kxutils_p.h"
 
 #include "platforms/xcb/kwindowsystem_xcb_debug.h"
 #include <QDebug>
 
+#include <QAbstractNativeEventFilter>
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
 #include <QX11Info>
+
+#include <algorithm>
+#include <memory>
 # define XK_MISCELLANY
 # define XK_XKB_KEYS
 # include <X11/X.h>
 # include <X11/Xlib.h>
 # include <X11/Xutil.h>
 # include <X11/keysymdef.h>
-#include <xcb/xcb_keysyms.h>
 # define X11_ONLY(arg) arg, //allows to omit an argument
 
 // #define KKEYSERVER_DEBUG 1
@@ -75,7 +85,7 @@ struct TransKey {
 // Arrays
 //---------------------------------------------------------------------
 
-static X11ModInfo g_rgX11ModInfo[4] = {
+static const X11ModInfo g_rgX11ModInfo[4] = {
     { Qt::SHIFT,   X11_ONLY(ShiftMask) },
     { Qt::CTRL,    X11_ONLY(ControlMask) },
     { Qt::ALT,     X11_ONLY(Mod1Mask) },
@@ -459,6 +469,36 @@ static const TransKey g_rgQtToSymX[] = {
     { Qt::Key_LaunchF,    XF86XK_LaunchD },
 };
 
+static const int g_nTransKeys = sizeof(g_rgQtToSymX) / sizeof(TransKey);
+
+// g_rgQtToSymX sorted by Qt key and by X keysym. Entries with the same key keep
+// their order in g_rgQtToSymX, so the first match wins just like in a linear scan.
+struct TransKeyIndex {
+    TransKeyIndex();
+
+    quint16 byQt[g_nTransKeys];
+    quint16 byX[g_nTransKeys];
+};
+
+TransKeyIndex::TransKeyIndex()
+{
+    for (int i = 0; i < g_nTransKeys; i++) {
+        byQt[i] = byX[i] = i;
+    }
+    std::stable_sort(byQt, byQt + g_nTransKeys, [](quint16 a, quint16 b) {
+        return g_rgQtToSymX[a].keySymQt < g_rgQtToSymX[b].keySymQt;
+    });
+    std::stable_sort(byX, byX + g_nTransKeys, [](quint16 a, quint16 b) {
+        return g_rgQtToSymX[a].keySymX < g_rgQtToSymX[b].keySymX;
+    });
+}
+
+static const TransKeyIndex &transKeyIndex()
+{
+    static const TransKeyIndex index;
+    return index;
+}
+
 //---------------------------------------------------------------------
 // Debugging
 //---------------------------------------------------------------------
@@ -477,153 +517,419 @@ inline void checkDisplay()
 #endif
 
 //---------------------------------------------------------------------
-// Initialization
+// Keyboard mapping
 //---------------------------------------------------------------------
 
-static bool g_bInitializedMods;
-static uint g_modXNumLock, g_modXScrollLock, g_modXModeSwitch, g_alt_mask, g_meta_mask, g_super_mask, g_hyper_mask;
+// Event types of the XKB extension, libxcb-xkb is not used for just these
+static const uint8_t XkbNewKeyboardNotify = 0;
+static const uint8_t XkbMapNotify = 1;
+
+// The core keyboard mapping with a reverse index from keysyms to keys
+struct KeyboardMap {
+    struct Key {
+        xcb_keycode_t keyCode;
+        int level; // the column of the keysym in the keyboard mapping
+    };
+
+    KeyboardMap();
+    void load(const xcb_setup_t *setup, xcb_get_keyboard_mapping_reply_t *reply);
+
+    xcb_keysym_t keySym(xcb_keycode_t keyCode, int col) const;
+    const xcb_keysym_t *rawKeySyms(xcb_keycode_t keyCode) const;
+    Key key(xcb_keysym_t sym) const;
+
+    xcb_keycode_t minKeyCode;
+    xcb_keycode_t maxKeyCode;
+    int keySymsPerKeyCode;
+    QVector<xcb_keysym_t> keySyms;
+    // The first key producing a keysym, in the order XKeysymToKeycode() finds it
+    QHash<xcb_keysym_t, Key> keys;
+};
 
-bool initializeMods()
+KeyboardMap::KeyboardMap()
+    : minKeyCode(0)
+    , maxKeyCode(0)
+    , keySymsPerKeyCode(0)
 {
-    // Reinitialize the masks
-    g_modXNumLock = 0;
-    g_modXScrollLock = 0;
-    g_modXModeSwitch = 0;
-    g_alt_mask = 0;
-    g_meta_mask = 0;
-    g_super_mask = 0;
-    g_hyper_mask = 0;
+}
 
-    if (!QX11Info::isPlatformX11()) {
-        qCWarning(LOG_KKEYSERVER_X11) << "X11 implementation of KKeyServer accessed from non-X11 platform! This is an application bug.";
-        g_bInitializedMods = true;
+void KeyboardMap::load(const xcb_setup_t *setup, xcb_get_keyboard_mapping_reply_t *reply)
+{
+    if (!reply || reply->keysyms_per_keycode == 0) {
+        qCWarning(LOG_KKEYSERVER_X11) << "Failed to read the keyboard mapping";
+        return;
+    }
+
+    minKeyCode = setup->min_keycode;
+    maxKeyCode = setup->max_keycode;
+    keySymsPerKeyCode = reply->keysyms_per_keycode;
+    const xcb_keysym_t *syms = xcb_get_keyboard_mapping_keysyms(reply);
+    keySyms = QVector<xcb_keysym_t>(syms, syms + xcb_get_keyboard_mapping_keysyms_length(reply));
+
+    keys.reserve(keySyms.size());
+    for (int col = 0; col < keySymsPerKeyCode; ++col) {
+        for (int keyCode = minKeyCode; keyCode <= maxKeyCode; ++keyCode) {
+            const xcb_keysym_t sym = keySym(keyCode, col);
+            if (sym != XCB_NO_SYMBOL && !keys.contains(sym)) {
+                keys.insert(sym, Key{ xcb_keycode_t(keyCode), col });
+            }
+        }
+    }
+}
+
+const xcb_keysym_t *KeyboardMap::rawKeySyms(xcb_keycode_t keyCode) const
+{
+    if (keyCode < minKeyCode || keyCode > maxKeyCode || keySyms.isEmpty()) {
+        return nullptr;
+    }
+    return keySyms.constData() + (keyCode - minKeyCode) * keySymsPerKeyCode;
+}
+
+// Same rules as XKeycodeToKeysym() for the core keyboard mapping
+xcb_keysym_t KeyboardMap::keySym(xcb_keycode_t keyCode, int col) const
+{
+    int per = keySymsPerKeyCode;
+    const xcb_keysym_t *syms = rawKeySyms(keyCode);
+    if (!syms || col < 0 || (col >= per && col > 3)) {
+        return XCB_NO_SYMBOL;
+    }
+
+    if (col < 4) {
+        if (col > 1) {
+            while (per > 2 && syms[per - 1] == XCB_NO_SYMBOL) {
+                per--;
+            }
+            if (per < 3) {
+                col -= 2;
+            }
+        }
+        if (per <= (col | 1) || syms[col | 1] == XCB_NO_SYMBOL) {
+            KeySym lower, upper;
+            XConvertCase(syms[col & ~1], &lower, &upper);
+            if (!(col & 1)) {
+                return xcb_keysym_t(lower);
+            } else if (upper == lower) {
+                return XCB_NO_SYMBOL;
+            }
+            return xcb_keysym_t(upper);
+        }
+    }
+    return syms[col];
+}
+
+KeyboardMap::Key KeyboardMap::key(xcb_keysym_t sym) const
+{
+    return keys.value(sym, Key{ 0, 0 });
+}
+
+// Everything KKeyServer knows about one keyboard layout. A Keymap is never
+// modified once it is published, so any thread holding a reference can use it
+// without locking. It is freed once the last user drops its reference.
+struct Keymap {
+    Keymap();
+    explicit Keymap(xcb_connection_t *c);
+
+    void initializeMods(xcb_get_modifier_mapping_reply_t *modMap);
+
+    KeyboardMap keyboard;
+    uint modXNumLock, modXScrollLock, modXModeSwitch, altMask, metaMask, superMask, hyperMask;
+    X11ModInfo modInfo[4];
+    bool valid;
+};
+
+// Publishes the Keymap of the Qt connection and replaces it by a new one
+// whenever the server reports a change of the keyboard mapping. Readers load
+// the current keymap atomically and never wait for a rebuild, except for the
+// very first one.
+class KeymapWatcher : public QAbstractNativeEventFilter
+{
+public:
+    KeymapWatcher();
+    ~KeymapWatcher() override;
+
+    std::shared_ptr<const Keymap> keymap();
+
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override;
+
+private:
+    xcb_connection_t *m_connection;
+    uint8_t m_xkbEventBase; // 0 if XKB is not available
+    // Set from the event filter when the server reports a new mapping
+    QAtomicInt m_invalidated;
+    // Only taken to build a keymap, so that it is built once
+    QMutex m_rebuildMutex;
+    // Only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<const Keymap> m_keymap;
+};
+
+KeymapWatcher::KeymapWatcher()
+    : m_connection(QX11Info::connection())
+    , m_xkbEventBase(0)
+    , m_invalidated(0)
+{
+    if (!m_connection) {
+        return;
+    }
+    static const char xkbExtension[] = "XKEYBOARD";
+    xcb_query_extension_reply_t *xkb = xcb_query_extension_reply(m_connection,
+            xcb_query_extension(m_connection, strlen(xkbExtension), xkbExtension), nullptr);
+    if (xkb) {
+        if (xkb->present) {
+            m_xkbEventBase = xkb->first_event;
+        }
+        free(xkb);
+    }
+
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app) {
+        return;
+    }
+    // The event filters may only be touched from the thread processing the events
+    if (QThread::currentThread() == app->thread()) {
+        app->installNativeEventFilter(this);
+    } else {
+        QMetaObject::invokeMethod(app, [this, app]() {
+            app->installNativeEventFilter(this);
+        }, Qt::QueuedConnection);
+    }
+}
+
+KeymapWatcher::~KeymapWatcher()
+{
+    if (QCoreApplication::instance()) {
+        QCoreApplication::instance()->removeNativeEventFilter(this);
+    }
+}
+
+std::shared_ptr<const Keymap> KeymapWatcher::keymap()
+{
+    // Users keep their copy of the pointer, so a replaced keymap lives on until
+    // the last of them is done with it
+    std::shared_ptr<const Keymap> current = std::atomic_load(&m_keymap);
+    if (current && !m_invalidated.loadAcquire()) {
+        return current;
+    }
+    if (current) {
+        // While another thread builds the new keymap the old one is still good
+        if (!m_rebuildMutex.tryLock()) {
+            return current;
+        }
+    } else {
+        m_rebuildMutex.lock();
+    }
+    current = std::atomic_load(&m_keymap);
+    if (!current || m_invalidated.fetchAndStoreAcquire(0)) {
+        current = std::make_shared<const Keymap>(m_connection);
+        std::atomic_store(&m_keymap, current);
+    }
+    m_rebuildMutex.unlock();
+    return current;
+}
+
+bool KeymapWatcher::nativeEventFilter(const QByteArray &eventType, void *message, long *result)
+{
+    Q_UNUSED(result)
+    if (eventType != "xcb_generic_event_t") {
         return false;
     }
+    xcb_generic_event_t *event = reinterpret_cast<xcb_generic_event_t *>(message);
+    const uint8_t responseType = event->response_type & ~0x80;
+    bool changed = false;
+    if (responseType == XCB_MAPPING_NOTIFY) {
+        xcb_mapping_notify_event_t *mapping = reinterpret_cast<xcb_mapping_notify_event_t *>(event);
+        changed = mapping->request == XCB_MAPPING_MODIFIER || mapping->request == XCB_MAPPING_KEYBOARD;
+    } else if (m_xkbEventBase && responseType == m_xkbEventBase) {
+        // The second byte of every XKB event is its XKB event type
+        const uint8_t xkbType = event->pad0;
+        changed = xkbType == XkbNewKeyboardNotify || xkbType == XkbMapNotify;
+    }
+    if (changed) {
+        // The next user fetches the new mapping
+        m_invalidated.storeRelease(1);
+    }
+    return false;
+}
 
-    checkDisplay();
-    XModifierKeymap *xmk = XGetModifierMapping(QX11Info::display());
+Q_GLOBAL_STATIC(KeymapWatcher, s_keymapWatcher)
 
-    int min_keycode, max_keycode;
-    int keysyms_per_keycode = 0;
+static std::shared_ptr<const Keymap> currentKeymap()
+{
+    if (KeymapWatcher *watcher = s_keymapWatcher()) {
+        return watcher->keymap();
+    }
+    // Only happens during shutdown
+    static const std::shared_ptr<const Keymap> empty = std::make_shared<const Keymap>();
+    return empty;
+}
 
-    XDisplayKeycodes(QX11Info::display(), &min_keycode, &max_keycode);
-    XFree(XGetKeyboardMapping(QX11Info::display(), min_keycode, 1, &keysyms_per_keycode));
+//---------------------------------------------------------------------
+// Initialization
+//---------------------------------------------------------------------
+
+Keymap::Keymap()
+    : modXNumLock(0)
+    , modXScrollLock(0)
+    , modXModeSwitch(0)
+    , altMask(0)
+    , metaMask(0)
+    , superMask(0)
+    , hyperMask(0)
+    , valid(false)
+{
+    std::copy(g_rgX11ModInfo, g_rgX11ModInfo + 4, modInfo);
+}
+
+Keymap::Keymap(xcb_connection_t *c)
+    : Keymap()
+{
+    if (!QX11Info::isPlatformX11() || !c) {
+        qCWarning(LOG_KKEYSERVER_X11) << "X11 implementation of KKeyServer accessed from non-X11 platform! This is an application bug.";
+        return;
+    }
+
+    // Fetch the modifier map and the whole keyboard map in one go
+    const xcb_setup_t *setup = xcb_get_setup(c);
+    const xcb_get_keyboard_mapping_cookie_t keyCookie = xcb_get_keyboard_mapping(c, setup->min_keycode,
+            setup->max_keycode - setup->min_keycode + 1);
+    const xcb_get_modifier_mapping_cookie_t modCookie = xcb_get_modifier_mapping(c);
+    KXUtils::ScopedCPointer<xcb_get_keyboard_mapping_reply_t> keyMap(xcb_get_keyboard_mapping_reply(c, keyCookie, nullptr));
+    KXUtils::ScopedCPointer<xcb_get_modifier_mapping_reply_t> modMap(xcb_get_modifier_mapping_reply(c, modCookie, nullptr));
+
+    keyboard.load(setup, keyMap.data());
+    if (modMap.isNull()) {
+        qCWarning(LOG_KKEYSERVER_X11) << "Failed to read the modifier mapping";
+        return;
+    }
+    initializeMods(modMap.data());
+    valid = true;
+}
+
+void Keymap::initializeMods(xcb_get_modifier_mapping_reply_t *modMap)
+{
+    const xcb_keycode_t *modKeyCodes = xcb_get_modifier_mapping_keycodes(modMap);
+    const int keyCodesPerMod = modMap->keycodes_per_modifier;
 
-    for (int i = Mod1MapIndex; i < 8; i++) {
+    for (int i = XCB_MAP_INDEX_1; i < 8; i++) {
         uint mask = (1 << i);
-        uint keySymX = NoSymbol;
 
         // This used to be only XKeycodeToKeysym( ... , 0 ), but that fails with XFree4.3.99
         // and X.org R6.7 , where for some reason only ( ... , 1 ) works. I have absolutely no
         // idea what the problem is, but searching all possibilities until something valid is
         // found fixes the problem.
-        for (int j = 0; j < xmk->max_keypermod; ++j) {
-
-            for (int k = 0; k < keysyms_per_keycode; ++k) {
+        for (int j = 0; j < keyCodesPerMod; ++j) {
+            const xcb_keysym_t *keyCodeSyms = keyboard.rawKeySyms(modKeyCodes[keyCodesPerMod * i + j]);
+            if (!keyCodeSyms) {
+                continue; // unused slot
+            }
 
-                keySymX = XKeycodeToKeysym(QX11Info::display(), xmk->modifiermap[xmk->max_keypermod * i + j], k);
+            for (int k = 0; k < keyboard.keySymsPerKeyCode; ++k) {
 
-                switch (keySymX) {
+                switch (keyCodeSyms[k]) {
                 case XK_Alt_L:
-                case XK_Alt_R:       g_alt_mask |= mask; break;
+                case XK_Alt_R:       altMask |= mask; break;
 
                 case XK_Super_L:
-                case XK_Super_R:     g_super_mask |= mask; break;
+                case XK_Super_R:     superMask |= mask; break;
 
                 case XK_Hyper_L:
-                case XK_Hyper_R:     g_hyper_mask |= mask; break;
+                case XK_Hyper_R:     hyperMask |= mask; break;
 
                 case XK_Meta_L:
-                case XK_Meta_R:      g_meta_mask |= mask; break;
+                case XK_Meta_R:      metaMask |= mask; break;
 
-                case XK_Num_Lock:    g_modXNumLock |= mask; break;
-                case XK_Scroll_Lock: g_modXScrollLock |= mask; break;
-                case XK_Mode_switch: g_modXModeSwitch |= mask; break;
+                case XK_Num_Lock:    modXNumLock |= mask; break;
+                case XK_Scroll_Lock: modXScrollLock |= mask; break;
+                case XK_Mode_switch: modXModeSwitch |= mask; break;
                 }
             }
         }
     }
 
 #ifdef KKEYSERVER_DEBUG
-    qCDebug(LOG_KKEYSERVER_X11) << "Alt:" << g_alt_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "Meta:" << g_meta_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "Super:" << g_super_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "Hyper:" << g_hyper_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "NumLock:" << g_modXNumLock;
-    qCDebug(LOG_KKEYSERVER_X11) << "ScrollLock:" << g_modXScrollLock;
-    qCDebug(LOG_KKEYSERVER_X11) << "ModeSwitch:" << g_modXModeSwitch;
+    qCDebug(LOG_KKEYSERVER_X11) << "Alt:" << altMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "Meta:" << metaMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "Super:" << superMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "Hyper:" << hyperMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "NumLock:" << modXNumLock;
+    qCDebug(LOG_KKEYSERVER_X11) << "ScrollLock:" << modXScrollLock;
+    qCDebug(LOG_KKEYSERVER_X11) << "ModeSwitch:" << modXModeSwitch;
 #endif
 
     // Check if hyper overlaps with super or meta or alt
-    if (g_hyper_mask & (g_super_mask | g_meta_mask | g_alt_mask)) {
+    if (hyperMask & (superMask | metaMask | altMask)) {
 #ifdef KKEYSERVER_DEBUG
         qCDebug(LOG_KKEYSERVER_X11) << "Hyper conflicts with super, meta or alt.";
 #endif
         // Remove the conflicting masks
-        g_hyper_mask &= ~(g_super_mask | g_meta_mask | g_alt_mask);
+        hyperMask &= ~(superMask | metaMask | altMask);
     }
 
     // Check if super overlaps with meta or alt
-    if (g_super_mask & (g_meta_mask | g_alt_mask)) {
+    if (superMask & (metaMask | altMask)) {
 #ifdef KKEYSERVER_DEBUG
         qCDebug(LOG_KKEYSERVER_X11) << "Super conflicts with meta or alt.";
 #endif
         // Remove the conflicting masks
-        g_super_mask &= ~(g_meta_mask | g_alt_mask);
+        superMask &= ~(metaMask | altMask);
     }
 
     // Check if meta overlaps with alt
-    if (g_meta_mask | g_alt_mask) {
+    if (metaMask | altMask) {
 #ifdef KKEYSERVER_DEBUG
         qCDebug(LOG_KKEYSERVER_X11) << "Meta conflicts with alt.";
 #endif
         // Remove the conflicting masks
-        g_meta_mask &= ~(g_alt_mask);
+        metaMask &= ~(altMask);
     }
 
-    if (!g_meta_mask) {
+    if (!metaMask) {
 #ifdef KKEYSERVER_DEBUG
         qCDebug(LOG_KKEYSERVER_X11) << "Meta is not set or conflicted with alt.";
 #endif
-        if (g_super_mask) {
+        if (superMask) {
 #ifdef KKEYSERVER_DEBUG
             qCDebug(LOG_KKEYSERVER_X11) << "Using super for meta";
 #endif
             // Use Super
-            g_meta_mask = g_super_mask;
-        } else if (g_hyper_mask) {
+            metaMask = superMask;
+        } else if (hyperMask) {
 #ifdef KKEYSERVER_DEBUG
             qCDebug(LOG_KKEYSERVER_X11) << "Using hyper for meta";
 #endif
             // User Hyper
-            g_meta_mask = g_hyper_mask;
+            metaMask = hyperMask;
         } else {
             // ???? Nothing left
-            g_meta_mask = 0;
+            metaMask = 0;
         }
     }
 
 #ifdef KKEYSERVER_DEBUG
-    qCDebug(LOG_KKEYSERVER_X11) << "Alt:" << g_alt_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "Meta:" << g_meta_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "Super:" << g_super_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "Hyper:" << g_hyper_mask;
-    qCDebug(LOG_KKEYSERVER_X11) << "NumLock:" << g_modXNumLock;
-    qCDebug(LOG_KKEYSERVER_X11) << "ScrollLock:" << g_modXScrollLock;
-    qCDebug(LOG_KKEYSERVER_X11) << "ModeSwitch:" << g_modXModeSwitch;
+    qCDebug(LOG_KKEYSERVER_X11) << "Alt:" << altMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "Meta:" << metaMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "Super:" << superMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "Hyper:" << hyperMask;
+    qCDebug(LOG_KKEYSERVER_X11) << "NumLock:" << modXNumLock;
+    qCDebug(LOG_KKEYSERVER_X11) << "ScrollLock:" << modXScrollLock;
+    qCDebug(LOG_KKEYSERVER_X11) << "ModeSwitch:" << modXModeSwitch;
 #endif
 
-    if (!g_meta_mask) {
+    if (!metaMask) {
         qCWarning(LOG_KKEYSERVER_X11) << "Your keyboard setup doesn't provide a key to use for meta. See 'xmodmap -pm' or 'xkbcomp $DISPLAY'";
     }
 
-    g_rgX11ModInfo[2].modX = g_alt_mask;
-    g_rgX11ModInfo[3].modX = g_meta_mask;
-
-    XFreeModifiermap(xmk);
-    g_bInitializedMods = true;
+    modInfo[2].modX = altMask;
+    modInfo[3].modX = metaMask;
+}
 
-    return true;
+bool initializeMods()
+{
+    if (!QX11Info::isPlatformX11()) {
+        qCWarning(LOG_KKEYSERVER_X11) << "X11 implementation of KKeyServer accessed from non-X11 platform! This is an application bug.";
+        return false;
+    }
+    // Builds the keymap if it does not exist yet or the mapping changed since
+    return currentKeymap()->valid;
 }
 
 //---------------------------------------------------------------------
@@ -649,22 +955,16 @@ uint modXCtrl()
 }
 uint modXAlt()
 {
-    if (!g_bInitializedMods) {
-        initializeMods();
-    } return g_alt_mask;
+    return currentKeymap()->altMask;
 }
 uint modXMeta()
 {
-    if (!g_bInitializedMods) {
-        initializeMods();
-    } return g_meta_mask;
+    return currentKeymap()->metaMask;
 }
 
 uint modXNumLock()
 {
-    if (!g_bInitializedMods) {
-        initializeMods();
-    } return g_modXNumLock;
+    return currentKeymap()->modXNumLock;
 }
 uint modXLock()
 {
@@ -672,15 +972,11 @@ uint modXLock()
 }
 uint modXScrollLock()
 {
-    if (!g_bInitializedMods) {
-        initializeMods();
-    } return g_modXScrollLock;
+    return currentKeymap()->modXScrollLock;
 }
 uint modXModeSwitch()
 {
-    if (!g_bInitializedMods) {
-        initializeMods();
-    } return g_modXModeSwitch;
+    return currentKeymap()->modXModeSwitch;
 }
 
 bool keyboardHasMetaKey()
@@ -711,19 +1007,15 @@ uint getModsRequired(uint sym)
         }
     }
 
-    uchar code = XKeysymToKeycode(QX11Info::display(), sym);
-    if (code) {
-        // need to check index 0 before the others, so that a null-mod
-        //  can take precedence over the others, in case the modified
-        //  key produces the same symbol.
-        if (sym == XKeycodeToKeysym(QX11Info::display(), code, 0))
-            ;
-        else if (sym == XKeycodeToKeysym(QX11Info::display(), code, 1)) {
-            mod = Qt::SHIFT;
-        } else if (sym == XKeycodeToKeysym(QX11Info::display(), code, 2)) {
-            mod = MODE_SWITCH;
-        } else if (sym == XKeycodeToKeysym(QX11Info::display(), code, 3)) {
-            mod = Qt::SHIFT | MODE_SWITCH;
+    // The index holds the lowest level producing the symbol, so a null-mod
+    //  takes precedence over the others, in case the modified key produces
+    //  the same symbol.
+    const KeyboardMap::Key key = currentKeymap()->keyboard.key(sym);
+    if (key.keyCode) {
+        switch (key.level) {
+        case 1: mod = Qt::SHIFT; break;
+        case 2: mod = MODE_SWITCH; break;
+        case 3: mod = Qt::SHIFT | MODE_SWITCH; break;
         }
     }
     return mod;
@@ -749,7 +1041,7 @@ bool keyQtToCodeX(int keyQt, int *keyCode)
         return false;
     }
 
-    *keyCode = XKeysymToKeycode(QX11Info::display(), sym);
+    *keyCode = currentKeymap()->keyboard.key(sym).keyCode;
     return true;
 }
 
@@ -769,13 +1061,15 @@ bool keyQtToSymX(int keyQt, int *keySym)
         }
     }
 
-    for (uint i = 0; i < sizeof(g_rgQtToSymX) / sizeof(TransKey); i++) {
-        if (g_rgQtToSymX[i].keySymQt == symQt) {
-            if ((keyQt & Qt::KeypadModifier) && !is_keypad_key(g_rgQtToSymX[i].keySymX))
-                continue;
-            *keySym = g_rgQtToSymX[i].keySymX;
-            return true;
-        }
+    const quint16 *byQt = transKeyIndex().byQt;
+    const quint16 *it = std::lower_bound(byQt, byQt + g_nTransKeys, symQt, [](quint16 i, int key) {
+        return g_rgQtToSymX[i].keySymQt < key;
+    });
+    for (; it != byQt + g_nTransKeys && g_rgQtToSymX[*it].keySymQt == symQt; ++it) {
+        if ((keyQt & Qt::KeypadModifier) && !is_keypad_key(g_rgQtToSymX[*it].keySymX))
+            continue;
+        *keySym = g_rgQtToSymX[*it].keySymX;
+        return true;
     }
 
     *keySym = 0;
@@ -786,7 +1080,9 @@ bool keyQtToSymX(int keyQt, int *keySym)
     return false;
 }
 
-bool symXModXToKeyQt(uint32_t keySym, uint16_t modX, int *keyQt)
+static bool mod_x_to_qt(const Keymap *keymap, uint modX, int *modQt);
+
+static bool sym_x_mod_x_to_key_qt(const Keymap *keymap, uint32_t keySym, uint16_t modX, int *keyQt)
 {
     int keyModQt = 0;
     *keyQt = Qt::Key_unknown;
@@ -808,18 +1104,20 @@ bool symXModXToKeyQt(uint32_t keySym, uint16_t modX, int *keyQt)
     }
 
     else {
-        for (uint i = 0; i < sizeof(g_rgQtToSymX) / sizeof(TransKey); i++)
-            if (g_rgQtToSymX[i].keySymX == keySym) {
-                *keyQt = g_rgQtToSymX[i].keySymQt;
-                break;
-            }
+        const quint16 *byX = transKeyIndex().byX;
+        const quint16 *it = std::lower_bound(byX, byX + g_nTransKeys, keySym, [](quint16 i, uint32_t sym) {
+            return g_rgQtToSymX[i].keySymX < sym;
+        });
+        if (it != byX + g_nTransKeys && g_rgQtToSymX[*it].keySymX == keySym) {
+            *keyQt = g_rgQtToSymX[*it].keySymQt;
+        }
     }
 
     if (*keyQt == Qt::Key_unknown) {
         return false;
     }
 
-    if (modXToQt(modX, &keyModQt)) {
+    if (mod_x_to_qt(keymap, modX, &keyModQt)) {
         *keyQt |= keyModQt;
         if (is_keypad_key(keySym)) {
             *keyQt |= Qt::KeypadModifier;
@@ -829,6 +1127,11 @@ bool symXModXToKeyQt(uint32_t keySym, uint16_t modX, int *keyQt)
     return false;
 }
 
+bool symXModXToKeyQt(uint32_t keySym, uint16_t modX, int *keyQt)
+{
+    return sym_x_mod_x_to_key_qt(currentKeymap().get(), keySym, modX, keyQt);
+}
+
 #if KWINDOWSYSTEM_BUILD_DEPRECATED_SINCE(5, 38)
 bool symXToKeyQt(uint keySym, int *keyQt)
 {
@@ -838,16 +1141,15 @@ bool symXToKeyQt(uint keySym, int *keyQt)
 
 bool keyQtToModX(int modQt, uint *modX)
 {
-    if (!g_bInitializedMods) {
-        initializeMods();
-    }
+    const std::shared_ptr<const Keymap> keymap = currentKeymap();
+    const X11ModInfo *modInfo = keymap->modInfo;
 
     *modX = 0;
     for (int i = 0; i < 4; i++) {
 
-        if (modQt & g_rgX11ModInfo[i].modQt) {
-            if (g_rgX11ModInfo[i].modX) {
-                *modX |= g_rgX11ModInfo[i].modX;
+        if (modQt & modInfo[i].modQt) {
+            if (modInfo[i].modX) {
+                *modX |= modInfo[i].modX;
             } else {
                 // The qt modifier has no x equivalent. Return false
                 return false;
@@ -857,22 +1159,23 @@ bool keyQtToModX(int modQt, uint *modX)
     return true;
 }
 
-bool modXToQt(uint modX, int *modQt)
+static bool mod_x_to_qt(const Keymap *keymap, uint modX, int *modQt)
 {
-    if (!g_bInitializedMods) {
-        initializeMods();
-    }
-
     *modQt = 0;
     for (int i = 0; i < 4; i++) {
-        if (modX & g_rgX11ModInfo[i].modX) {
-            *modQt |= g_rgX11ModInfo[i].modQt;
+        if (modX & keymap->modInfo[i].modX) {
+            *modQt |= keymap->modInfo[i].modQt;
             continue;
         }
     }
     return true;
 }
 
+bool modXToQt(uint modX, int *modQt)
+{
+    return mod_x_to_qt(currentKeymap().get(), modX, modQt);
+}
+
 bool codeXToSym(uchar codeX, uint modX, uint *sym)
 {
     if (!QX11Info::isPlatformX11()) {
@@ -949,16 +1252,16 @@ bool xcbKeyPressEventToQt(xcb_generic_event_t *e, int *keyQt)
 
 bool xcbKeyPressEventToQt(xcb_key_press_event_t *e, int *keyQt)
 {
-    const uint16_t keyModX = e->state & (accelModMaskX() | MODE_SWITCH);
-
-    xcb_key_symbols_t *symbols = xcb_key_symbols_alloc(QX11Info::connection());
+    // Use the same keymap for everything, it may get replaced in the meantime
+    const std::shared_ptr<const Keymap> keymap = currentKeymap();
+    const uint16_t keyModX = e->state & (modXShift() | modXCtrl() | keymap->altMask | keymap->metaMask | MODE_SWITCH);
 
     // We might have to use 4,5 instead of 0,1 here when mode_switch is active, just not sure how to test that.
-    const xcb_keysym_t keySym0 = xcb_key_press_lookup_keysym(symbols, e, 0);
-    const xcb_keysym_t keySym1 = xcb_key_press_lookup_keysym(symbols, e, 1);
+    const xcb_keysym_t keySym0 = keymap->keyboard.keySym(e->detail, 0);
+    const xcb_keysym_t keySym1 = keymap->keyboard.keySym(e->detail, 1);
     xcb_keysym_t keySymX;
 
-    if ((e->state & KKeyServer::modXNumLock()) && is_keypad_key(keySym1) ) {
+    if ((e->state & keymap->modXNumLock) && is_keypad_key(keySym1) ) {
         if ((e->state & XCB_MOD_MASK_SHIFT))
             keySymX = keySym0;
         else
@@ -967,18 +1270,17 @@ bool xcbKeyPressEventToQt(xcb_key_press_event_t *e, int *keyQt)
         keySymX = keySym0;
     }
 
-    bool ok = KKeyServer::symXModXToKeyQt(keySymX, keyModX, keyQt);
+    bool ok = sym_x_mod_x_to_key_qt(keymap.get(), keySymX, keyModX, keyQt);
 
     if ((*keyQt & Qt::ShiftModifier) && !KKeyServer::isShiftAsModifierAllowed(*keyQt)) {
         if (*keyQt != Qt::Key_Tab) { // KKeySequenceWidget does not map shift+tab to backtab
             static const int FirstLevelShift = 1;
-            keySymX = xcb_key_symbols_get_keysym(symbols, e->detail, FirstLevelShift);
-            KKeyServer::symXModXToKeyQt(keySymX, keyModX, keyQt);
+            keySymX = keymap->keyboard.keySym(e->detail, FirstLevelShift);
+            sym_x_mod_x_to_key_qt(keymap.get(), keySymX, keyModX, keyQt);
         }
         *keyQt &= ~Qt::ShiftModifier;
     }
 
-    xcb_key_symbols_free(symbols);
     return ok;
 }
 
@@ -26,15 +26,24 @@ DEALINGS IN THE SOFTWARE.
 
 #include <config-kwindowsystem.h>
 #include "kwindowsystem.h"
+#include "kwindowsystem_debug.h"
 
 #include <QBasicTimer>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QGuiApplication>
+#include <QHash>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QTimer>
 #include <QTimerEvent>
 #include <QAbstractNativeEventFilter>
 
 #include <qx11info_x11.h>
 
+// An INCR transfer is aborted when the requestor takes no chunk for this long (ms)
+static const qint64 s_incrTimeout = 10000;
+
 static xcb_window_t get_selection_owner(xcb_connection_t *c, xcb_atom_t selection)
 {
     xcb_window_t owner = XCB_NONE;
@@ -65,7 +74,13 @@ class Q_DECL_HIDDEN KSelectionOwner::Private
     : public QAbstractNativeEventFilter
 {
 public:
-    enum State { Idle, WaitingForTimestamp, WaitingForPreviousOwner };
+    enum State { Idle, WaitingForTimestamp, WaitingForGroup, WaitingForPreviousOwner };
+
+    // Owners claimed together by claimAll(), verified with a single roundtrip
+    struct ClaimGroup {
+        QVector<QPointer<KSelectionOwner> > owners;
+        int pending_timestamps;
+    };
 
     Private(KSelectionOwner *owner_P, xcb_atom_t selection_P, xcb_connection_t *c, xcb_window_t root)
         : state(Idle),
@@ -78,14 +93,32 @@ public:
           extra1(0),
           extra2(0),
           force_kill(false),
+          incr_chunk_size(0),
+          in_selection_request(false),
+          claim_latency(-1),
           owner(owner_P)
     {
         QCoreApplication::instance()->installNativeEventFilter(this);
     }
 
+    ~Private() override;
+
+    xcb_get_selection_owner_cookie_t startClaim();
+    void requestTimestamp(xcb_window_t current_owner, bool force, bool force_kill);
     void claimSucceeded();
+    void claimFailed();
     void gotTimestamp();
+    void verifyOwner();
     void timeout();
+    static void completeGroup(const QSharedPointer<ClaimGroup> &group);
+
+    uint32_t chunkSize() const;
+    void startIncr(xcb_atom_t property, xcb_window_t requestor, xcb_atom_t type, uint8_t format, const QByteArray &data);
+    void selectIncrRequestors();
+    bool incrPropertyDeleted(xcb_property_notify_event_t *ev);
+    void incrRequestorDestroyed(xcb_window_t requestor);
+    void releaseIncrRequestor(xcb_window_t requestor);
+    void expireIncrTransfers();
 
     State state;
     const xcb_atom_t selection;
@@ -97,10 +130,35 @@ public:
     uint32_t extra1, extra2;
     QBasicTimer timer;
     bool force_kill;
+
+    // An INCR transfer in progress, keyed by requestor window and property
+    struct IncrTransfer {
+        QByteArray data;
+        int offset;
+        xcb_atom_t type;
+        uint8_t format;
+        // restarted whenever the requestor takes a chunk
+        QElapsedTimer last_activity;
+    };
+    QHash<QPair<xcb_window_t, xcb_atom_t>, IncrTransfer> incr_transfers;
+    // Event mask this connection had selected on the requestor windows before the transfers
+    QHash<xcb_window_t, uint32_t> incr_requestor_masks;
+    // Requestors whose event mask is still being queried
+    QHash<xcb_window_t, xcb_get_window_attributes_cookie_t> incr_pending_requestors;
+    uint32_t incr_chunk_size;
+    QBasicTimer incr_timer;
+    bool in_selection_request;
+
+    QSharedPointer<ClaimGroup> group;
+    xcb_get_selection_owner_cookie_t verify_cookie;
+    QElapsedTimer claim_timer;
+    qint64 claim_latency;
+
     static xcb_atom_t manager_atom;
     static xcb_atom_t xa_multiple;
     static xcb_atom_t xa_targets;
     static xcb_atom_t xa_timestamp;
+    static xcb_atom_t xa_incr;
 
     static Private *create(KSelectionOwner *owner, xcb_atom_t selection_P, int screen_P);
     static Private *create(KSelectionOwner *owner, const char *selection_P, int screen_P);
@@ -121,6 +179,166 @@ private:
     KSelectionOwner *owner;
 };
 
+KSelectionOwner::Private::~Private()
+{
+    if (state == WaitingForGroup) {
+        xcb_discard_reply(connection, verify_cookie.sequence);
+    } else if (state == WaitingForTimestamp && group && --group->pending_timestamps == 0) {
+        // The rest of the group was only waiting for us, don't emit signals from within a destructor
+        QSharedPointer<ClaimGroup> pending_group = group;
+        QTimer::singleShot(0, [pending_group]() { completeGroup(pending_group); });
+    }
+    // Abort pending transfers, but give the requestors their event mask back
+    for (auto it = incr_pending_requestors.constBegin(); it != incr_pending_requestors.constEnd(); ++it) {
+        xcb_discard_reply(connection, it.value().sequence);
+    }
+    for (auto it = incr_requestor_masks.constBegin(); it != incr_requestor_masks.constEnd(); ++it) {
+        const uint32_t mask = it.value();
+        xcb_change_window_attributes(connection, it.key(), XCB_CW_EVENT_MASK, &mask);
+    }
+}
+
+uint32_t KSelectionOwner::Private::chunkSize() const
+{
+    // Leave room for the ChangeProperty request header
+    const uint32_t max_bytes = xcb_get_maximum_request_length(connection) * 4 - 32;
+    uint32_t size = incr_chunk_size;
+    if (size == 0) {
+        size = qMin<uint32_t>(max_bytes / 4, 256 * 1024);
+    }
+    // Every chunk has to hold a whole number of 32 bit items
+    return qMax<uint32_t>(qMin(size, max_bytes) & ~3u, 4);
+}
+
+void KSelectionOwner::Private::startIncr(xcb_atom_t property, xcb_window_t requestor, xcb_atom_t type, uint8_t format, const QByteArray &data)
+{
+    if (!incr_requestor_masks.contains(requestor) && !incr_pending_requestors.contains(requestor)) {
+        // The requestor can be one of our own windows, so keep what is already selected on it.
+        // The reply is only waited for in selectIncrRequestors(), together with the ones for
+        // the other targets of the request.
+        incr_pending_requestors.insert(requestor, xcb_get_window_attributes(connection, requestor));
+    }
+
+    IncrTransfer transfer = { data, 0, type, format, QElapsedTimer() };
+    transfer.last_activity.start();
+    incr_transfers.insert(qMakePair(requestor, property), transfer);
+    if (!incr_timer.isActive()) {
+        incr_timer.start(s_incrTimeout / 2, owner);
+    }
+
+    // The data follows in chunks once the requestor has deleted the INCR property
+    const uint32_t size = data.size();
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, requestor, property, xa_incr, 32, 1, &size);
+
+    if (!in_selection_request) {
+        selectIncrRequestors();
+    }
+}
+
+void KSelectionOwner::Private::selectIncrRequestors()
+{
+    // This has to happen before the SelectionNotify is sent, the requestor deletes
+    // the INCR property in response to it
+    for (auto it = incr_pending_requestors.constBegin(); it != incr_pending_requestors.constEnd(); ++it) {
+        const xcb_window_t requestor = it.key();
+        xcb_get_window_attributes_reply_t *attr = xcb_get_window_attributes_reply(connection, it.value(), nullptr);
+        if (!attr) {
+            // the requestor is gone already
+            for (auto transfer = incr_transfers.begin(); transfer != incr_transfers.end();) {
+                if (transfer.key().first == requestor) {
+                    transfer = incr_transfers.erase(transfer);
+                } else {
+                    ++transfer;
+                }
+            }
+            continue;
+        }
+        const uint32_t previous_mask = attr->your_event_mask;
+        free(attr);
+
+        const uint32_t mask = previous_mask | XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+        xcb_change_window_attributes(connection, requestor, XCB_CW_EVENT_MASK, &mask);
+        incr_requestor_masks.insert(requestor, previous_mask);
+    }
+    incr_pending_requestors.clear();
+}
+
+bool KSelectionOwner::Private::incrPropertyDeleted(xcb_property_notify_event_t *ev)
+{
+    if (ev->state != XCB_PROPERTY_DELETE || incr_transfers.isEmpty()) {
+        return false;
+    }
+    auto it = incr_transfers.find(qMakePair(ev->window, ev->atom));
+    if (it == incr_transfers.end()) {
+        return false;
+    }
+
+    IncrTransfer &transfer = it.value();
+    const int unit = transfer.format / 8;
+    const int length = qMin<int>(chunkSize(), transfer.data.size() - transfer.offset);
+    // A zero length chunk marks the end of the transfer
+    xcb_change_property(connection, XCB_PROP_MODE_APPEND, ev->window, ev->atom, transfer.type, transfer.format,
+                        length / unit, transfer.data.constData() + transfer.offset);
+    transfer.offset += length;
+    transfer.last_activity.start();
+
+    if (length == 0) {
+        incr_transfers.erase(it);
+        releaseIncrRequestor(ev->window);
+    }
+    return true;
+}
+
+void KSelectionOwner::Private::incrRequestorDestroyed(xcb_window_t requestor)
+{
+    if (!incr_requestor_masks.remove(requestor)) {
+        return;
+    }
+    for (auto it = incr_transfers.begin(); it != incr_transfers.end();) {
+        if (it.key().first == requestor) {
+            it = incr_transfers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void KSelectionOwner::Private::releaseIncrRequestor(xcb_window_t requestor)
+{
+    for (auto it = incr_transfers.constBegin(); it != incr_transfers.constEnd(); ++it) {
+        if (it.key().first == requestor) {
+            return; // still in use by another transfer
+        }
+    }
+    const uint32_t mask = incr_requestor_masks.take(requestor);
+    xcb_change_window_attributes(connection, requestor, XCB_CW_EVENT_MASK, &mask);
+}
+
+void KSelectionOwner::Private::expireIncrTransfers()
+{
+    // Requestors that stopped taking chunks would otherwise keep their data
+    // and event mask forever
+    QVector<xcb_window_t> requestors;
+    for (auto it = incr_transfers.begin(); it != incr_transfers.end();) {
+        if (it.value().last_activity.hasExpired(s_incrTimeout)) {
+            qCWarning(LOG_KWINDOWSYSTEM) << "Incremental selection transfer to" << it.key().first << "timed out";
+            requestors << it.key().first;
+            it = incr_transfers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (xcb_window_t requestor : qAsConst(requestors)) {
+        if (incr_requestor_masks.contains(requestor)) {
+            releaseIncrRequestor(requestor);
+        }
+    }
+    if (incr_transfers.isEmpty()) {
+        incr_timer.stop();
+    }
+    xcb_flush(connection);
+}
+
 KSelectionOwner::Private* KSelectionOwner::Private::create(KSelectionOwner *owner, xcb_atom_t selection_P, int screen_P)
 {
     if (KWindowSystem::isPlatformX11()) {
@@ -184,6 +402,57 @@ KSelectionOwner::~KSelectionOwner()
     }
 }
 
+xcb_get_selection_owner_cookie_t KSelectionOwner::Private::startClaim()
+{
+    Q_ASSERT(state == Idle);
+
+    if (manager_atom == XCB_NONE) {
+        owner->getAtoms();
+    }
+
+    if (timestamp != XCB_CURRENT_TIME) {
+        owner->release();
+    }
+
+    group.reset();
+    claim_timer.start();
+    return xcb_get_selection_owner(connection, selection);
+}
+
+void KSelectionOwner::Private::requestTimestamp(xcb_window_t current_owner, bool force, bool force_kill_P)
+{
+    xcb_connection_t *c = connection;
+    prev_owner = current_owner;
+
+    if (prev_owner != XCB_NONE) {
+        if (!force) {
+            // qDebug() << "Selection already owned, failing";
+            claimFailed();
+            return;
+        }
+
+        // Select structure notify events so get an event when the previous owner
+        // destroys the window
+        uint32_t mask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+        xcb_change_window_attributes(c, prev_owner, XCB_CW_EVENT_MASK, &mask);
+    }
+
+    uint32_t values[] = { true, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY };
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, root, 0, 0, 1, 1, 0,
+                      XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT,
+                      XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK, values);
+
+    // Trigger a property change event so we get a timestamp
+    xcb_atom_t tmp = XCB_ATOM_ATOM;
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_ATOM, XCB_ATOM_ATOM, 32, 1, (const void *) &tmp);
+
+    // Now we have to return to the event loop and wait for the property change event
+    force_kill = force_kill_P;
+    state = WaitingForTimestamp;
+}
+
 void KSelectionOwner::Private::claimSucceeded()
 {
     state = Idle;
@@ -201,22 +470,65 @@ void KSelectionOwner::Private::claimSucceeded()
 
     xcb_send_event(connection, false, root, XCB_EVENT_MASK_STRUCTURE_NOTIFY, (const char *) &ev);
 
-    // qDebug() << "Claimed selection";
+    claim_latency = claim_timer.nsecsElapsed() / 1000;
+    qCDebug(LOG_KWINDOWSYSTEM) << "Claimed selection" << selection << "in" << claim_latency << "us";
 
     emit owner->claimedOwnership();
 }
 
+void KSelectionOwner::Private::claimFailed()
+{
+    state = Idle;
+
+    claim_latency = claim_timer.nsecsElapsed() / 1000;
+    qCDebug(LOG_KWINDOWSYSTEM) << "Failed to claim selection" << selection << "after" << claim_latency << "us";
+
+    emit owner->failedToClaimOwnership();
+}
+
 void KSelectionOwner::Private::gotTimestamp()
 {
     Q_ASSERT(state == WaitingForTimestamp);
 
-    state = Idle;
+    // Set the selection owner and verify that the claim was successful
+    xcb_set_selection_owner(connection, window, selection, timestamp);
+    verify_cookie = xcb_get_selection_owner(connection, selection);
 
+    if (!group) {
+        verifyOwner();
+        return;
+    }
+
+    // Members of a group wait for each other, so the verification costs one roundtrip for all of them
+    state = WaitingForGroup;
+    if (--group->pending_timestamps == 0) {
+        completeGroup(group);
+    }
+}
+
+void KSelectionOwner::Private::completeGroup(const QSharedPointer<ClaimGroup> &group)
+{
+    // The signals emitted while verifying may delete any of the owners
+    const QVector<QPointer<KSelectionOwner> > owners = group->owners;
+    for (const QPointer<KSelectionOwner> &owner : owners) {
+        if (owner && owner->d->group == group && owner->d->state == WaitingForGroup) {
+            owner->d->verifyOwner();
+        }
+    }
+}
+
+void KSelectionOwner::Private::verifyOwner()
+{
     xcb_connection_t *c = connection;
 
-    // Set the selection owner and immediately verify that the claim was successful
-    xcb_set_selection_owner(c, window, selection, timestamp);
-    xcb_window_t new_owner = get_selection_owner(c, selection);
+    state = Idle;
+    group.reset();
+
+    xcb_window_t new_owner = XCB_NONE;
+    if (xcb_get_selection_owner_reply_t *reply = xcb_get_selection_owner_reply(c, verify_cookie, nullptr)) {
+        new_owner = reply->owner;
+        free(reply);
+    }
 
     if (new_owner != window) {
         // qDebug() << "Failed to claim selection : " << new_owner;
@@ -224,7 +536,7 @@ void KSelectionOwner::Private::gotTimestamp()
         timestamp = XCB_CURRENT_TIME;
         window = XCB_NONE;
 
-        emit owner->failedToClaimOwnership();
+        claimFailed();
         return;
     }
 
@@ -257,7 +569,7 @@ void KSelectionOwner::Private::timeout()
 
         claimSucceeded();
     } else {
-        emit owner->failedToClaimOwnership();
+        claimFailed();
     }
 }
 
@@ -266,46 +578,59 @@ void KSelectionOwner::claim(bool force_P, bool force_kill_P)
     if (!d) {
         return;
     }
-    Q_ASSERT(d->state == Private::Idle);
 
-    if (Private::manager_atom == XCB_NONE) {
-        getAtoms();
-    }
-
-    if (d->timestamp != XCB_CURRENT_TIME) {
-        release();
+    xcb_get_selection_owner_cookie_t cookie = d->startClaim();
+    xcb_window_t current_owner = XCB_NONE;
+    if (xcb_get_selection_owner_reply_t *reply = xcb_get_selection_owner_reply(d->connection, cookie, nullptr)) {
+        current_owner = reply->owner;
+        free(reply);
     }
 
-    xcb_connection_t *c = d->connection;
-    d->prev_owner = get_selection_owner(c, d->selection);
+    d->requestTimestamp(current_owner, force_P, force_kill_P);
+}
 
-    if (d->prev_owner != XCB_NONE) {
-        if (!force_P) {
-            // qDebug() << "Selection already owned, failing";
-            emit failedToClaimOwnership();
-            return;
+void KSelectionOwner::claimAll(const QVector<KSelectionOwner *> &owners, bool force, bool force_kill)
+{
+    QSharedPointer<Private::ClaimGroup> group(new Private::ClaimGroup);
+    group->pending_timestamps = 0;
+
+    // Query all current owners before waiting for any of the replies
+    QVector<QPair<xcb_connection_t *, xcb_get_selection_owner_cookie_t> > cookies;
+    cookies.reserve(owners.size());
+    for (KSelectionOwner *owner : owners) {
+        if (owner->d) {
+            cookies.append(qMakePair(owner->d->connection, owner->d->startClaim()));
+            group->owners.append(owner);
         }
-
-        // Select structure notify events so get an event when the previous owner
-        // destroys the window
-        uint32_t mask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
-        xcb_change_window_attributes(c, d->prev_owner, XCB_CW_EVENT_MASK, &mask);
     }
 
-    uint32_t values[] = { true, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY };
-
-    d->window = xcb_generate_id(c);
-    xcb_create_window(c, XCB_COPY_FROM_PARENT, d->window, d->root, 0, 0, 1, 1, 0,
-                      XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT,
-                      XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK, values);
-
-    // Trigger a property change event so we get a timestamp
-    xcb_atom_t tmp = XCB_ATOM_ATOM;
-    xcb_change_property(c, XCB_PROP_MODE_REPLACE, d->window, XCB_ATOM_ATOM, XCB_ATOM_ATOM, 32, 1, (const void *) &tmp);
+    // Fetching the replies can emit failedToClaimOwnership(), which may delete owners
+    const QVector<QPointer<KSelectionOwner> > claiming = group->owners;
+    for (int i = 0; i < claiming.size(); ++i) {
+        xcb_connection_t *c = cookies.at(i).first;
+        if (!claiming.at(i)) {
+            xcb_discard_reply(c, cookies.at(i).second.sequence);
+            continue;
+        }
+        xcb_window_t current_owner = XCB_NONE;
+        if (xcb_get_selection_owner_reply_t *reply = xcb_get_selection_owner_reply(c, cookies.at(i).second, nullptr)) {
+            current_owner = reply->owner;
+            free(reply);
+        }
+        claiming.at(i)->d->requestTimestamp(current_owner, force, force_kill);
+        if (claiming.at(i) && claiming.at(i)->d->state == Private::WaitingForTimestamp) {
+            claiming.at(i)->d->group = group;
+            ++group->pending_timestamps;
+        }
+    }
+}
 
-    // Now we have to return to the event loop and wait for the property change event
-    d->force_kill = force_kill_P;
-    d->state = Private::WaitingForTimestamp;
+qint64 KSelectionOwner::claimLatency() const
+{
+    if (!d) {
+        return -1;
+    }
+    return d->claim_latency;
 }
 
 // destroy resource first
@@ -385,6 +710,7 @@ bool KSelectionOwner::filterEvent(void *ev_P)
     }
     case XCB_DESTROY_NOTIFY: {
         xcb_destroy_notify_event_t *ev = reinterpret_cast<xcb_destroy_notify_event_t *>(event);
+        d->incrRequestorDestroyed(ev->window);
         if (ev->window == d->prev_owner) {
             if (d->state == Private::WaitingForPreviousOwner) {
                 d->timer.stop();
@@ -424,6 +750,8 @@ bool KSelectionOwner::filterEvent(void *ev_P)
             d->gotTimestamp();
             return true;
         }
+        // The requestor window is not ours, leave the event to others as well
+        d->incrPropertyDeleted(ev);
         return false;
     }
     default:
@@ -442,6 +770,10 @@ void KSelectionOwner::timerEvent(QTimerEvent *event)
         d->timeout();
         return;
     }
+    if (event->timerId() == d->incr_timer.timerId()) {
+        d->expireIncrTransfers();
+        return;
+    }
 
     QObject::timerEvent(event);
 }
@@ -472,6 +804,7 @@ void KSelectionOwner::filter_selection_request(void *event)
 
     xcb_connection_t *c = d->connection;
     bool handled = false;
+    d->in_selection_request = true;
 
     if (ev->target == Private::xa_multiple) {
         if (ev->property != XCB_NONE) {
@@ -516,6 +849,8 @@ void KSelectionOwner::filter_selection_request(void *event)
 
         handled = handle_selection(ev->target, ev->property, ev->requestor);
     }
+    d->in_selection_request = false;
+    d->selectIncrRequestors();
 
     xcb_selection_notify_event_t xev;
     xev.response_type = XCB_SELECTION_NOTIFY;
@@ -565,6 +900,38 @@ bool KSelectionOwner::genericReply(xcb_atom_t, xcb_atom_t, xcb_window_t)
     return false;
 }
 
+void KSelectionOwner::replyData(xcb_atom_t property_P, xcb_window_t requestor_P, xcb_atom_t type_P, uint8_t format_P, const QByteArray &data_P)
+{
+    if (!d) {
+        return;
+    }
+    Q_ASSERT(format_P == 8 || format_P == 16 || format_P == 32);
+    Q_ASSERT(data_P.size() % (format_P / 8) == 0);
+
+    if (uint32_t(data_P.size()) > d->chunkSize()) {
+        d->startIncr(property_P, requestor_P, type_P, format_P, data_P);
+        return;
+    }
+    xcb_change_property(d->connection, XCB_PROP_MODE_REPLACE, requestor_P, property_P, type_P, format_P,
+                        data_P.size() / (format_P / 8), data_P.constData());
+}
+
+void KSelectionOwner::setIncrementalChunkSize(uint32_t bytes)
+{
+    if (!d) {
+        return;
+    }
+    d->incr_chunk_size = bytes;
+}
+
+uint32_t KSelectionOwner::incrementalChunkSize() const
+{
+    if (!d) {
+        return 0;
+    }
+    return d->chunkSize();
+}
+
 void KSelectionOwner::getAtoms()
 {
     if (!d) {
@@ -583,7 +950,8 @@ void KSelectionOwner::getAtoms()
         { "MANAGER",   &Private::manager_atom },
         { "MULTIPLE",  &Private::xa_multiple  },
         { "TARGETS",   &Private::xa_targets   },
-        { "TIMESTAMP", &Private::xa_timestamp }
+        { "TIMESTAMP", &Private::xa_timestamp },
+        { "INCR",      &Private::xa_incr      }
     };
 
     const int count = sizeof(atoms) / sizeof(atoms[0]);
@@ -605,4 +973,5 @@ xcb_atom_t KSelectionOwner::Private::manager_atom = XCB_NONE;
 xcb_atom_t KSelectionOwner::Private::xa_multiple  = XCB_NONE;
 xcb_atom_t KSelectionOwner::Private::xa_targets   = XCB_NONE;
 xcb_atom_t KSelectionOwner::Private::xa_timestamp = XCB_NONE;
+xcb_atom_t KSelectionOwner::Private::xa_incr      = XCB_NONE;
 
@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include <kwindowsystem_export.h>
 #include <QObject>
+#include <QVector>
 
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
@@ -118,6 +119,29 @@ public:
      */
     void claim(bool force, bool force_kill = true);
 
+    /**
+     * Claims ownership of several manager selections at once, e.g. one per screen.
+     *
+     * This behaves like calling claim() on each of the @p owners, but the requests
+     * for all of them are issued together, so claiming N selections costs about as
+     * many roundtrips to the X server as claiming a single one. Every owner still
+     * emits its own claimedOwnership() or failedToClaimOwnership() signal.
+     *
+     * @see claim, claimLatency
+     * @since 5.65
+     */
+    static void claimAll(const QVector<KSelectionOwner *> &owners, bool force, bool force_kill = true);
+
+    /**
+     * Returns the time in microseconds the last claim took from calling claim() or
+     * claimAll() until claimedOwnership() or failedToClaimOwnership() was emitted,
+     * or -1 if no claim has completed yet. The value is also logged in the
+     * org.kde.kwindowsystem category.
+     *
+     * @since 5.65
+     */
+    qint64 claimLatency() const;
+
     /**
      * If the selection is owned, the ownership is given up.
      */
@@ -129,6 +153,24 @@ public:
      */
     xcb_window_t ownerWindow() const; // None if not owning the selection
 
+    /**
+     * Sets the maximum number of bytes written to the requestor at once when
+     * replyData() transfers data using the ICCCM INCR protocol. Replies that
+     * are larger than this are sent incrementally. The value is rounded down to
+     * a multiple of 4 and limited by the maximum request length of the server.
+     *
+     * @param bytes the chunk size, or 0 to derive it from the maximum request length
+     * @since 5.65
+     */
+    void setIncrementalChunkSize(uint32_t bytes);
+
+    /**
+     * @returns the chunk size in bytes used for incremental transfers
+     * @see setIncrementalChunkSize
+     * @since 5.65
+     */
+    uint32_t incrementalChunkSize() const;
+
     /**
      * @internal
      */
@@ -182,6 +224,24 @@ protected:
      * MULTIPLE, TIMESTAMP and TARGETS.
      */
     virtual void replyTargets(xcb_atom_t property, xcb_window_t requestor);
+    /**
+     * Stores @p data as reply to a selection request in @p property of the
+     * @p requestor window. This is meant to be used from genericReply() and
+     * replyTargets() instead of changing the property directly.
+     *
+     * Data larger than incrementalChunkSize() is transferred using the INCR
+     * protocol described in the ICCCM section 2.7.2. Several requestors
+     * can be served at the same time. A transfer is aborted when its
+     * requestor does not take the next chunk within 10 seconds.
+     *
+     * @param property property to use for the reply data
+     * @param requestor requestor window
+     * @param type the type of the reply data
+     * @param format 8, 16 or 32, the size of @p data must be a multiple of it
+     * @param data the reply data
+     * @since 5.65
+     */
+    void replyData(xcb_atom_t property, xcb_window_t requestor, xcb_atom_t type, uint8_t format, const QByteArray &data);
     /**
      * Called to create atoms needed for claiming the selection and
      * communication using the selection handling mechanism. The default
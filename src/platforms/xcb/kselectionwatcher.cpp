@@ -33,6 +33,10 @@ DEALINGS IN THE SOFTWARE.
 
 #include <qx11info_x11.h>
 
+#if KWINDOWSYSTEM_HAVE_XCB_XFIXES
+#include <xcb/xfixes.h>
+#endif
+
 static xcb_window_t get_selection_owner(xcb_connection_t *c, xcb_atom_t selection)
 {
     xcb_window_t owner = XCB_NONE;
@@ -72,15 +76,31 @@ public:
           root(root),
           selection(selection_P),
           selection_owner(XCB_NONE),
+          xfixes_window(XCB_WINDOW_NONE),
+          xfixes_event_base(0),
           watcher(watcher_P)
     {
         QCoreApplication::instance()->installNativeEventFilter(this);
     }
 
+    ~Private() override
+    {
+        if (xfixes_window != XCB_WINDOW_NONE) {
+            xcb_destroy_window(connection, xfixes_window);
+            xcb_flush(connection);
+        }
+    }
+
+    bool initXFixes();
+    void xfixesEvent(xcb_generic_event_t *event);
+
     xcb_connection_t *connection;
     xcb_window_t root;
     const xcb_atom_t selection;
     xcb_window_t selection_owner;
+    // when set, selection_owner is kept up to date by XFixes SelectionNotify events
+    xcb_window_t xfixes_window;
+    uint8_t xfixes_event_base;
     static xcb_atom_t manager_atom;
 
     static Private *create(KSelectionWatcher *watcher, xcb_atom_t selection_P, int screen_P);
@@ -103,6 +123,84 @@ private:
     KSelectionWatcher *watcher;
 };
 
+bool KSelectionWatcher::Private::initXFixes()
+{
+#if KWINDOWSYSTEM_HAVE_XCB_XFIXES
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(connection, &xcb_xfixes_id);
+    if (!extension || !extension->present) {
+        return false;
+    }
+    // The version has to be negotiated before any other XFixes request is made. Qt
+    // already did that on its own connection, asking again there would change the
+    // version its xcb plugin relies on, so that is only done for other connections.
+    const bool negotiate = connection != QX11Info::connection();
+    xcb_xfixes_query_version_cookie_t version_cookie;
+    if (negotiate) {
+        version_cookie = xcb_xfixes_query_version(connection, 1, 0);
+    }
+
+    // Use a private window so that the selection input of other watchers
+    // for the same selection is not affected when this one goes away
+    xfixes_window = xcb_generate_id(connection);
+    const uint32_t values[] = { true };
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, xfixes_window, root,
+                      0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT,
+                      XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_xfixes_select_selection_input(connection, xfixes_window, selection,
+                                      XCB_XFIXES_SELECTION_EVENT_MASK_SET_SELECTION_OWNER |
+                                      XCB_XFIXES_SELECTION_EVENT_MASK_SELECTION_WINDOW_DESTROY |
+                                      XCB_XFIXES_SELECTION_EVENT_MASK_SELECTION_CLIENT_CLOSE);
+    // Requested after selecting the input, so every later change is seen as an event
+    xcb_get_selection_owner_cookie_t owner_cookie = xcb_get_selection_owner(connection, selection);
+
+    bool ok = true;
+    if (negotiate) {
+        xcb_xfixes_query_version_reply_t *version = xcb_xfixes_query_version_reply(connection, version_cookie, nullptr);
+        ok = version != nullptr;
+        free(version);
+    }
+    xcb_get_selection_owner_reply_t *owner = xcb_get_selection_owner_reply(connection, owner_cookie, nullptr);
+    ok = ok && owner;
+    if (ok) {
+        xfixes_event_base = extension->first_event;
+        selection_owner = owner->owner;
+    }
+    free(owner);
+
+    if (!ok) {
+        xcb_destroy_window(connection, xfixes_window);
+        xfixes_window = XCB_WINDOW_NONE;
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+void KSelectionWatcher::Private::xfixesEvent(xcb_generic_event_t *event)
+{
+#if KWINDOWSYSTEM_HAVE_XCB_XFIXES
+    if ((event->response_type & ~0x80) != xfixes_event_base + XCB_XFIXES_SELECTION_NOTIFY) {
+        return;
+    }
+    xcb_xfixes_selection_notify_event_t *ev = reinterpret_cast<xcb_xfixes_selection_notify_event_t *>(event);
+    if (ev->window != xfixes_window || ev->selection != selection) {
+        return;
+    }
+    if (ev->owner == selection_owner) {
+        return;
+    }
+    selection_owner = ev->owner;
+    if (selection_owner != XCB_WINDOW_NONE) {
+        emit watcher->newOwner(selection_owner);
+    } else {
+        emit watcher->lostOwner();    // it must be safe to delete 'this' in a slot
+    }
+#else
+    Q_UNUSED(event)
+#endif
+}
+
 KSelectionWatcher::Private *KSelectionWatcher::Private::create(KSelectionWatcher *watcher, xcb_atom_t selection_P, int screen_P)
 {
     if (KWindowSystem::isPlatformX11()) {
@@ -167,6 +265,14 @@ void KSelectionWatcher::init()
     if (!d) {
         return;
     }
+    if (d->initXFixes()) {
+        // Ownership changes are tracked from SelectionNotify events from now on,
+        // neither MANAGER messages nor DestroyNotify of the owner are needed
+        if (d->selection_owner != XCB_WINDOW_NONE) {
+            emit newOwner(d->selection_owner);
+        }
+        return;
+    }
     if (Private::manager_atom == XCB_NONE) {
         xcb_connection_t *c = d->connection;
 
@@ -196,6 +302,9 @@ xcb_window_t KSelectionWatcher::owner()
     if (!d) {
         return XCB_WINDOW_NONE;
     }
+    if (d->xfixes_window != XCB_WINDOW_NONE) {
+        return d->selection_owner;
+    }
     xcb_connection_t *c = d->connection;
 
     xcb_window_t current_owner = get_selection_owner(c, d->selection);
@@ -236,6 +345,10 @@ void KSelectionWatcher::filterEvent(void *ev_P)
         return;
     }
     xcb_generic_event_t *event = reinterpret_cast<xcb_generic_event_t *>(ev_P);
+    if (d->xfixes_window != XCB_WINDOW_NONE) {
+        d->xfixesEvent(event);
+        return;
+    }
     const uint response_type = event->response_type & ~0x80;
     if (response_type == XCB_CLIENT_MESSAGE) {
         xcb_client_message_event_t *cm_event = reinterpret_cast<xcb_client_message_event_t *>(event);
@@ -96,6 +96,9 @@ public:
      * Return the current owner of the manager selection, if any. Note that if the event
      * informing about the owner change is still in the input queue, newOwner() might
      * have been emitted yet.
+     *
+     * If the XFixes extension is available the owner is tracked from selection
+     * notify events and this only returns the cached value without a roundtrip.
      */
     xcb_window_t owner();
     /**
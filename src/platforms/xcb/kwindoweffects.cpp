@@ -22,72 +22,439 @@
 #include <QGuiApplication>
 
 #include "kwindowsystem.h"
+#include "kxutils_p.h"
 #include <config-kwindowsystem.h>
 
 #include <xcb/xcb.h>
 #include <QX11Info>
 #include <QMatrix4x4>
 
+#include <queue>
+
 static const char DASHBOARD_WIN_CLASS[] = "dashboard\0dashboard";
 using namespace KWindowEffects;
 
+static const char *const s_atomNames[] = {
+    "_KDE_SLIDE",
+    "_KDE_PRESENT_WINDOWS_DESKTOP",
+    "_KDE_PRESENT_WINDOWS_GROUP",
+    "_KDE_WINDOW_HIGHLIGHT",
+    "_KDE_NET_WM_BLUR_BEHIND_REGION",
+    // TODO: Better namespacing for atoms
+    "_WM_EFFECT_KDE_DASHBOARD",
+    "_KDE_NET_WM_BACKGROUND_CONTRAST_REGION",
+    // used by windowSizes()
+    "_NET_FRAME_EXTENTS",
+    "_KDE_NET_WM_FRAME_STRUT"
+};
+
+// the effect announced by each of the effect atoms above
+static const Effect s_effects[] = {
+    Slide,
+    PresentWindows,
+    PresentWindowsGroup,
+    HighlightWindows,
+    BlurBehind,
+    Dashboard,
+    BackgroundContrast
+};
+
+// Rectangles of a blur or contrast region which line up with their neighbours
+// to within this many device pixels get merged.
+static const int s_regionTolerance = 1;
+// Upper bound for the number of rectangles sent to the compositor per region.
+static const int s_maxRegionRects = 128;
+
 KWindowEffectsPrivateX11::KWindowEffectsPrivateX11()
 {
+    // start interning right away, the replies are picked up on first use
+    if (xcb_connection_t *c = QX11Info::connection()) {
+        internAtoms(c);
+        QCoreApplication::instance()->installNativeEventFilter(this);
+        // Users connected to KWindowSystem::effectAvailabilityChanged() have to be
+        // told about changes even if they never query the availability. Not done
+        // right here, as the backend is created while KWindowSystem is looking
+        // for its platform plugin.
+        QMetaObject::invokeMethod(&m_context, [this]() {
+            xcb_connection_t *c = QX11Info::connection();
+            if (c && (!m_trackingAvailability || c != m_atomConnection)) {
+                trackAvailability(c);
+            }
+        }, Qt::QueuedConnection);
+    }
 }
 
 KWindowEffectsPrivateX11::~KWindowEffectsPrivateX11()
 {
+    QObject::disconnect(m_compositingConnection);
+    if (m_atomsPending && m_atomConnection == QX11Info::connection()) {
+        for (int i = 0; i < AtomCount; ++i) {
+            xcb_discard_reply(m_atomConnection, m_atomCookies[i].sequence);
+        }
+    }
 }
 
-bool KWindowEffectsPrivateX11::isEffectAvailable(Effect effect)
+void KWindowEffectsPrivateX11::internAtoms(xcb_connection_t *c)
 {
-    if (!KWindowSystem::self()->compositingActive()) {
-        return false;
+    Q_STATIC_ASSERT(sizeof(s_atomNames) / sizeof(s_atomNames[0]) == AtomCount);
+    Q_STATIC_ASSERT(sizeof(s_effects) / sizeof(s_effects[0]) == EffectAtomCount);
+
+    if (m_atomsPending) {
+        // the old connection is gone, its replies are of no interest anymore
+        for (int i = 0; i < AtomCount; ++i) {
+            xcb_discard_reply(m_atomConnection, m_atomCookies[i].sequence);
+        }
     }
-    QByteArray effectName;
+    for (int i = 0; i < AtomCount; ++i) {
+        m_atomCookies[i] = xcb_intern_atom_unchecked(c, false, strlen(s_atomNames[i]), s_atomNames[i]);
+        m_atoms[i] = XCB_ATOM_NONE;
+    }
+    m_atomConnection = c;
+    m_atomsPending = true;
+    m_blurBehind.clear();
+    m_backgroundContrast.clear();
+    m_ownWrites.clear();
+}
 
-    switch (effect) {
-    case Slide:
-        effectName = QByteArrayLiteral("_KDE_SLIDE");
-        break;
-    case PresentWindows:
-        effectName = QByteArrayLiteral("_KDE_PRESENT_WINDOWS_DESKTOP");
-        break;
-    case PresentWindowsGroup:
-        effectName = QByteArrayLiteral("_KDE_PRESENT_WINDOWS_GROUP");
-        break;
-    case HighlightWindows:
-        effectName = QByteArrayLiteral("_KDE_WINDOW_HIGHLIGHT");
-        break;
-    case BlurBehind:
-        effectName = QByteArrayLiteral("_KDE_NET_WM_BLUR_BEHIND_REGION");
-        break;
-    case Dashboard:
-        // TODO: Better namespacing for atoms
-        effectName = QByteArrayLiteral("_WM_EFFECT_KDE_DASHBOARD");
-        break;
-    case BackgroundContrast:
-        effectName = QByteArrayLiteral("_KDE_NET_WM_BACKGROUND_CONTRAST_REGION");
-        break;
-    default:
-        return false;
+xcb_atom_t KWindowEffectsPrivateX11::atom(xcb_connection_t *c, EffectAtom which)
+{
+    if (c != m_atomConnection) {
+        internAtoms(c);
+    }
+    if (m_atomsPending) {
+        // all replies arrive together, so at most one round trip per connection
+        for (int i = 0; i < AtomCount; ++i) {
+            KXUtils::ScopedCPointer<xcb_intern_atom_reply_t> reply(xcb_intern_atom_reply(c, m_atomCookies[i], nullptr));
+            if (!reply.isNull()) {
+                m_atoms[i] = reply->atom;
+            }
+        }
+        m_atomsPending = false;
     }
+    return m_atoms[which];
+}
 
+void KWindowEffectsPrivateX11::trackAvailability(xcb_connection_t *c)
+{
+    QObject::disconnect(m_compositingConnection);
+    m_rootWindow = QX11Info::appRootWindow();
+    xcb_get_window_attributes_cookie_t attributesCookie = xcb_get_window_attributes_unchecked(c, m_rootWindow);
     // hackish way to find out if KWin has the effect enabled,
     // TODO provide proper support
-    xcb_connection_t *c = QX11Info::connection();
-    xcb_list_properties_cookie_t propsCookie = xcb_list_properties_unchecked(c, QX11Info::appRootWindow());
-    xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom_unchecked(c, false, effectName.length(), effectName.constData());
+    xcb_list_properties_cookie_t propsCookie = xcb_list_properties_unchecked(c, m_rootWindow);
+
+    for (int i = 0; i < EffectAtomCount; ++i) {
+        atom(c, EffectAtom(i));
+        m_effectPropertyPresent[i] = false;
+    }
+
+    // Qt normally selects PropertyChange on the root window already, but make
+    // sure of it without dropping anything from our existing event mask
+    KXUtils::ScopedCPointer<xcb_get_window_attributes_reply_t> attributes(xcb_get_window_attributes_reply(c, attributesCookie, nullptr));
+    if (!attributes.isNull() && !(attributes->your_event_mask & XCB_EVENT_MASK_PROPERTY_CHANGE)) {
+        const uint32_t mask = attributes->your_event_mask | XCB_EVENT_MASK_PROPERTY_CHANGE;
+        xcb_change_window_attributes(c, m_rootWindow, XCB_CW_EVENT_MASK, &mask);
+    }
+    // usually done by the constructor already, it has to happen before the
+    // property list is read so that no change is missed
+    QCoreApplication::instance()->installNativeEventFilter(this);
 
     QScopedPointer<xcb_list_properties_reply_t, QScopedPointerPodDeleter> props(xcb_list_properties_reply(c, propsCookie, nullptr));
-    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atom(xcb_intern_atom_reply(c, atomCookie, nullptr));
-    if (!atom || !props) {
+    if (props) {
+        const xcb_atom_t *atoms = xcb_list_properties_atoms(props.data());
+        for (int i = 0; i < props->atoms_len; ++i) {
+            for (int j = 0; j < EffectAtomCount; ++j) {
+                if (m_atoms[j] != XCB_ATOM_NONE && atoms[i] == m_atoms[j]) {
+                    m_effectPropertyPresent[j] = true;
+                }
+            }
+        }
+    }
+
+    m_compositingActive = KWindowSystem::compositingActive();
+    m_compositingConnection = QObject::connect(KWindowSystem::self(), &KWindowSystem::compositingChanged, &m_context,
+        [this](bool active) {
+            setCompositingActive(active);
+        }
+    );
+    m_trackingAvailability = true;
+}
+
+void KWindowEffectsPrivateX11::setEffectPropertyPresent(int index, bool present)
+{
+    if (m_effectPropertyPresent[index] == present) {
+        return;
+    }
+    m_effectPropertyPresent[index] = present;
+    if (m_compositingActive) {
+        emit KWindowSystem::self()->effectAvailabilityChanged(s_effects[index], present);
+    }
+}
+
+void KWindowEffectsPrivateX11::setCompositingActive(bool active)
+{
+    if (m_compositingActive == active) {
+        return;
+    }
+    m_compositingActive = active;
+    for (int i = 0; i < EffectAtomCount; ++i) {
+        if (m_effectPropertyPresent[i]) {
+            emit KWindowSystem::self()->effectAvailabilityChanged(s_effects[i], active);
+        }
+    }
+}
+
+bool KWindowEffectsPrivateX11::nativeEventFilter(const QByteArray &eventType, void *message, long *result)
+{
+    Q_UNUSED(result)
+    if (eventType != "xcb_generic_event_t") {
+        return false;
+    }
+    xcb_generic_event_t *ev = static_cast<xcb_generic_event_t *>(message);
+    const uint8_t type = ev->response_type & ~0x80;
+    if (type == XCB_DESTROY_NOTIFY) {
+        forgetWindow(reinterpret_cast<xcb_destroy_notify_event_t *>(ev)->window);
+        return false;
+    }
+    if (type != XCB_PROPERTY_NOTIFY) {
+        return false;
+    }
+    xcb_property_notify_event_t *event = reinterpret_cast<xcb_property_notify_event_t *>(ev);
+    if (event->atom == XCB_ATOM_NONE) {
+        return false;
+    }
+    if (event->window != m_rootWindow) {
+        if (event->atom == m_atoms[BlurBehindAtom]) {
+            regionEffectChanged(m_blurBehind, event);
+        } else if (event->atom == m_atoms[BackgroundContrastAtom]) {
+            regionEffectChanged(m_backgroundContrast, event);
+        }
+        return false;
+    }
+    if (!m_trackingAvailability) {
+        return false;
+    }
+    for (int i = 0; i < EffectAtomCount; ++i) {
+        if (event->atom == m_atoms[i]) {
+            setEffectPropertyPresent(i, event->state == XCB_PROPERTY_NEW_VALUE);
+            break;
+        }
+    }
+    return false;
+}
+
+bool KWindowEffectsPrivateX11::isRegionEffectSet(const QHash<xcb_window_t, RegionEffectState> &states, xcb_window_t window, xcb_atom_t effectAtom, const RegionEffectState &state) const
+{
+    if (m_ownWrites.contains(qMakePair(window, effectAtom))) {
+        // not confirmed yet, and never will be for windows without PropertyChange selected
         return false;
     }
-    xcb_atom_t *atoms = xcb_list_properties_atoms(props.data());
-    for (int i = 0; i < props->atoms_len; ++i) {
-        if (atoms[i] == atom->atom) {
-            return true;
+    auto it = states.constFind(window);
+    return it != states.constEnd() && *it == state;
+}
+
+void KWindowEffectsPrivateX11::regionEffectChanged(QHash<xcb_window_t, RegionEffectState> &states, xcb_property_notify_event_t *event)
+{
+    if (event->state == XCB_PROPERTY_NEW_VALUE) {
+        auto it = m_ownWrites.find(qMakePair(event->window, event->atom));
+        if (it != m_ownWrites.end()) {
+            // the change we made ourselves
+            if (--it->pending == 0) {
+                states.insert(event->window, it->state);
+                m_ownWrites.erase(it);
+            }
+            return;
+        }
+    }
+    // somebody else changed or removed the effect, it has to be set again next time
+    states.remove(event->window);
+}
+
+void KWindowEffectsPrivateX11::forgetWindow(xcb_window_t window)
+{
+    // the id may be reused for a new window which doesn't have any of our properties
+    m_blurBehind.remove(window);
+    m_backgroundContrast.remove(window);
+    m_ownWrites.remove(qMakePair(window, m_atoms[BlurBehindAtom]));
+    m_ownWrites.remove(qMakePair(window, m_atoms[BackgroundContrastAtom]));
+}
+
+bool KWindowEffectsPrivateX11::RegionEffectState::operator==(const RegionEffectState &other) const
+{
+    return region == other.region
+        && devicePixelRatio == other.devicePixelRatio
+        && contrast == other.contrast
+        && intensity == other.intensity
+        && saturation == other.saturation;
+}
+
+/**
+ * Converts @p region into device pixels and serializes it as x, y, width, height
+ * quadruples. On the way, rectangles which line up to within @p tolerance pixels
+ * are merged: those next to each other within one band as well as those of
+ * consecutive bands. A rectangle built from several bands never sticks out
+ * more than @p tolerance pixels on either side of any of them.
+ *
+ * If more than @p maxRects rectangles remain, the neighbours whose bounding
+ * rectangle adds the least area are merged, until the limit is reached or the
+ * added area would exceed that of the region itself.
+ *
+ * The result may cover slightly more than @p region, but never less.
+ */
+static QVector<uint32_t> serializeRegion(const QRegion &region, qreal devicePixelRatio, int tolerance, int maxRects)
+{
+    // the range of the left and right edges of the bands merged into a rect
+    struct Edges {
+        int minLeft, maxLeft, minRight, maxRight;
+    };
+    QVector<QRect> rects;
+    QVector<Edges> edges;
+    rects.reserve(region.rectCount());
+    edges.reserve(region.rectCount());
+    qint64 regionArea = 0;
+    int bandTop = -1;
+    QVector<int> previousBand;
+    QVector<int> currentBand;
+    for (const QRect &logical : region) {
+        // kwin on X uses device pixels, convert from logical
+        QRect r(int(logical.x() * devicePixelRatio), int(logical.y() * devicePixelRatio),
+                int(logical.width() * devicePixelRatio), int(logical.height() * devicePixelRatio));
+        if (r.isEmpty()) {
+            continue;
+        }
+        regionArea += qint64(r.width()) * r.height();
+        if (r.top() != bandTop) {
+            bandTop = r.top();
+            previousBand = currentBand;
+            currentBand.clear();
+        } else if (!currentBand.isEmpty()) {
+            // rects of a band are sorted from left to right
+            const int index = currentBand.last();
+            QRect &left = rects[index];
+            if (left.top() == r.top() && left.bottom() == r.bottom() && r.left() - left.right() - 1 <= tolerance) {
+                left.setRight(r.right());
+                edges[index].minRight = edges[index].maxRight = r.right();
+                continue;
+            }
+        }
+        bool merged = false;
+        for (int i = 0; i < previousBand.count(); ++i) {
+            const int index = previousBand.at(i);
+            QRect &above = rects[index];
+            Edges &e = edges[index];
+            if (r.top() - above.bottom() - 1 <= tolerance
+                    && qMax(e.maxLeft, r.left()) - qMin(e.minLeft, r.left()) <= tolerance
+                    && qMax(e.maxRight, r.right()) - qMin(e.minRight, r.right()) <= tolerance) {
+                above = above.united(r);
+                e.minLeft = qMin(e.minLeft, r.left());
+                e.maxLeft = qMax(e.maxLeft, r.left());
+                e.minRight = qMin(e.minRight, r.right());
+                e.maxRight = qMax(e.maxRight, r.right());
+                currentBand << index;
+                previousBand.remove(i);
+                merged = true;
+                break;
+            }
+        }
+        if (!merged) {
+            currentBand << rects.count();
+            rects << r;
+            edges << Edges{r.left(), r.left(), r.right(), r.right()};
+        }
+    }
+
+    if (maxRects > 0 && rects.count() > maxRects) {
+        // rects are still roughly ordered top to bottom, so only consecutive
+        // ones are considered; merges are taken cheapest first
+        const auto area = [](const QRect &r) {
+            return qint64(r.width()) * r.height();
+        };
+        const auto cost = [&area](const QRect &a, const QRect &b) {
+            return qMax<qint64>(0, area(a | b) - area(a) - area(b));
+        };
+        struct Merge {
+            qint64 cost;
+            int left, right;
+            int leftVersion, rightVersion;
+            bool operator<(const Merge &other) const {
+                return cost > other.cost;
+            }
+        };
+        const int count = rects.count();
+        QVector<int> next(count), previous(count), version(count, 0);
+        std::priority_queue<Merge> merges;
+        for (int i = 0; i < count; ++i) {
+            previous[i] = i - 1;
+            next[i] = i + 1 < count ? i + 1 : -1;
+            if (i > 0) {
+                merges.push(Merge{cost(rects.at(i - 1), rects.at(i)), i - 1, i, 0, 0});
+            }
+        }
+        int remaining = count;
+        qint64 addedArea = 0;
+        while (remaining > maxRects && !merges.empty()) {
+            const Merge m = merges.top();
+            merges.pop();
+            if (version.at(m.left) != m.leftVersion || version.at(m.right) != m.rightVersion) {
+                continue;
+            }
+            if (addedArea + m.cost > regionArea) {
+                break;
+            }
+            addedArea += m.cost;
+            rects[m.left] |= rects.at(m.right);
+            ++version[m.left];
+            version[m.right] = -1;
+            next[m.left] = next.at(m.right);
+            if (next.at(m.left) >= 0) {
+                previous[next.at(m.left)] = m.left;
+            }
+            --remaining;
+            if (previous.at(m.left) >= 0) {
+                const int p = previous.at(m.left);
+                merges.push(Merge{cost(rects.at(p), rects.at(m.left)), p, m.left, version.at(p), version.at(m.left)});
+            }
+            if (next.at(m.left) >= 0) {
+                const int n = next.at(m.left);
+                merges.push(Merge{cost(rects.at(m.left), rects.at(n)), m.left, n, version.at(m.left), version.at(n)});
+            }
+        }
+        QVector<QRect> bounded;
+        bounded.reserve(remaining);
+        for (int i = 0; i < count; ++i) {
+            if (version.at(i) >= 0) {
+                bounded << rects.at(i);
+            }
+        }
+        rects = bounded;
+    }
+
+    QVector<uint32_t> data;
+    data.reserve(rects.count() * 4 + 16);
+    for (const QRect &r : qAsConst(rects)) {
+        data << r.x() << r.y() << r.width() << r.height();
+    }
+    return data;
+}
+
+bool KWindowEffectsPrivateX11::isEffectAvailable(Effect effect)
+{
+    xcb_connection_t *c = QX11Info::connection();
+    if (!c) {
+        return false;
+    }
+    if (c != m_atomConnection) {
+        m_trackingAvailability = false;
+    }
+    if (!m_trackingAvailability) {
+        trackAvailability(c);
+    }
+    if (!m_compositingActive) {
+        return false;
+    }
+    for (int i = 0; i < EffectAtomCount; ++i) {
+        if (s_effects[i] == effect) {
+            return m_effectPropertyPresent[i];
         }
     }
     return false;
@@ -100,8 +467,10 @@ void KWindowEffectsPrivateX11::slideWindow(WId id, SlideFromLocation location, i
         return;
     }
 
-    const QByteArray effectName = QByteArrayLiteral("_KDE_SLIDE");
-    xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom_unchecked(c, false, effectName.length(), effectName.constData());
+    const xcb_atom_t effectAtom = atom(c, SlideAtom);
+    if (effectAtom == XCB_ATOM_NONE) {
+        return;
+    }
 
     const int size = 2;
     int32_t data[size];
@@ -123,27 +492,75 @@ void KWindowEffectsPrivateX11::slideWindow(WId id, SlideFromLocation location, i
         break;
     }
 
-    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atom(xcb_intern_atom_reply(c, atomCookie, nullptr));
-    if (!atom) {
-        return;
-    }
     if (location == NoEdge) {
-        xcb_delete_property(c, id, atom->atom);
+        xcb_delete_property(c, id, effectAtom);
     } else {
-        xcb_change_property(c, XCB_PROP_MODE_REPLACE, id, atom->atom, atom->atom, 32, size, data);
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, id, effectAtom, effectAtom, 32, size, data);
     }
 }
 
 QList<QSize> KWindowEffectsPrivateX11::windowSizes(const QList<WId> &ids)
 {
     QList<QSize> windowSizes;
-    for (WId id : ids) {
+    xcb_connection_t *c = QX11Info::connection();
+    if (!c) {
+        for (int i = 0; i < ids.count(); ++i) {
+            windowSizes.append(QSize());
+        }
+        return windowSizes;
+    }
+
+    // the same as KWindowInfo(id, NET::WMGeometry | NET::WMFrameExtents).frameGeometry().size(),
+    // but with the requests for all windows in flight at once
+    const xcb_atom_t frameExtents = atom(c, NetFrameExtentsAtom);
+    const xcb_atom_t frameStrut = atom(c, KdeFrameStrutAtom);
+    struct Cookies {
+        xcb_get_geometry_cookie_t geometry;
+        xcb_get_property_cookie_t frameExtents;
+        xcb_get_property_cookie_t frameStrut;
+    };
+    QVarLengthArray<Cookies, 32> cookies(ids.count());
+    for (int i = 0; i < ids.count(); ++i) {
+        const WId id = ids.at(i);
         if (id > 0) {
-            KWindowInfo info(id, NET::WMGeometry | NET::WMFrameExtents);
-            windowSizes.append(info.frameGeometry().size());
-        } else {
+            cookies[i].geometry = xcb_get_geometry_unchecked(c, id);
+            if (frameExtents != XCB_ATOM_NONE) {
+                cookies[i].frameExtents = xcb_get_property_unchecked(c, false, id, frameExtents, XCB_ATOM_CARDINAL, 0, 4);
+            }
+            if (frameStrut != XCB_ATOM_NONE) {
+                cookies[i].frameStrut = xcb_get_property_unchecked(c, false, id, frameStrut, XCB_ATOM_CARDINAL, 0, 4);
+            }
+        }
+    }
+
+    for (int i = 0; i < ids.count(); ++i) {
+        if (ids.at(i) <= 0) {
             windowSizes.append(QSize());
+            continue;
+        }
+        QSize size(0, 0);
+        KXUtils::ScopedCPointer<xcb_get_geometry_reply_t> geometry(xcb_get_geometry_reply(c, cookies[i].geometry, nullptr));
+        if (!geometry.isNull()) {
+            size = QSize(geometry->width, geometry->height);
+        }
+        KXUtils::ScopedCPointer<xcb_get_property_reply_t> strut;
+        if (frameExtents != XCB_ATOM_NONE) {
+            strut.reset(xcb_get_property_reply(c, cookies[i].frameExtents, nullptr));
+        }
+        if (strut.isNull() || strut->type != XCB_ATOM_CARDINAL || strut->format != 32 || strut->value_len != 4) {
+            // fall back to the KDE specific frame strut, like NETWinInfo does
+            if (frameStrut != XCB_ATOM_NONE) {
+                strut.reset(xcb_get_property_reply(c, cookies[i].frameStrut, nullptr));
+            }
+        } else if (frameStrut != XCB_ATOM_NONE) {
+            xcb_discard_reply(c, cookies[i].frameStrut.sequence);
         }
+        if (!strut.isNull() && strut->type == XCB_ATOM_CARDINAL && strut->format == 32 && strut->value_len == 4) {
+            // left, right, top, bottom
+            const uint32_t *data = static_cast<uint32_t *>(xcb_get_property_value(strut.data()));
+            size += QSize(data[0] + data[1], data[2] + data[3]);
+        }
+        windowSizes.append(size);
     }
     return windowSizes;
 }
@@ -173,13 +590,11 @@ void KWindowEffectsPrivateX11::presentWindows(WId controller, const QList<WId> &
         return;
     }
 
-    const QByteArray effectName = QByteArrayLiteral("_KDE_PRESENT_WINDOWS_GROUP");
-    xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom_unchecked(c, false, effectName.length(), effectName.constData());
-    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atom(xcb_intern_atom_reply(c, atomCookie, nullptr));
-    if (!atom) {
+    const xcb_atom_t effectAtom = atom(c, PresentWindowsGroupAtom);
+    if (effectAtom == XCB_ATOM_NONE) {
         return;
     }
-    xcb_change_property(c, XCB_PROP_MODE_REPLACE, controller, atom->atom, atom->atom, 32, data.size(), data.constData());
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, controller, effectAtom, effectAtom, 32, data.size(), data.constData());
 }
 
 void KWindowEffectsPrivateX11::presentWindows(WId controller, int desktop)
@@ -188,15 +603,13 @@ void KWindowEffectsPrivateX11::presentWindows(WId controller, int desktop)
     if (!c) {
         return;
     }
-    const QByteArray effectName = QByteArrayLiteral("_KDE_PRESENT_WINDOWS_DESKTOP");
-    xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom_unchecked(c, false, effectName.length(), effectName.constData());
-    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atom(xcb_intern_atom_reply(c, atomCookie, nullptr));
-    if (!atom) {
+    const xcb_atom_t effectAtom = atom(c, PresentWindowsDesktopAtom);
+    if (effectAtom == XCB_ATOM_NONE) {
         return;
     }
 
     int32_t data = desktop;
-    xcb_change_property(c, XCB_PROP_MODE_REPLACE, controller, atom->atom, atom->atom, 32, 1, &data);
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, controller, effectAtom, effectAtom, 32, 1, &data);
 }
 
 void KWindowEffectsPrivateX11::highlightWindows(WId controller, const QList<WId> &ids)
@@ -205,16 +618,14 @@ void KWindowEffectsPrivateX11::highlightWindows(WId controller, const QList<WId>
     if (!c) {
         return;
     }
-    const QByteArray effectName = QByteArrayLiteral("_KDE_WINDOW_HIGHLIGHT");
-    xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom_unchecked(c, false, effectName.length(), effectName.constData());
-    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atom(xcb_intern_atom_reply(c, atomCookie, nullptr));
-    if (!atom) {
+    const xcb_atom_t effectAtom = atom(c, HighlightWindowsAtom);
+    if (effectAtom == XCB_ATOM_NONE) {
         return;
     }
 
     const int numWindows = ids.count();
     if (numWindows == 0) {
-        xcb_delete_property(c, controller, atom->atom);
+        xcb_delete_property(c, controller, effectAtom);
         return;
     }
 
@@ -233,7 +644,7 @@ void KWindowEffectsPrivateX11::highlightWindows(WId controller, const QList<WId>
     if (data.isEmpty()) {
         return;
     }
-    xcb_change_property(c, XCB_PROP_MODE_REPLACE, controller, atom->atom, atom->atom,
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, controller, effectAtom, effectAtom,
                         32, data.size(), data.constData());
 }
 
@@ -243,46 +654,47 @@ void KWindowEffectsPrivateX11::enableBlurBehind(WId window, bool enable, const Q
     if (!c) {
         return;
     }
-    const QByteArray effectName = QByteArrayLiteral("_KDE_NET_WM_BLUR_BEHIND_REGION");
-    xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom_unchecked(c, false, effectName.length(), effectName.constData());
-    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atom(xcb_intern_atom_reply(c, atomCookie, nullptr));
-    if (!atom) {
+    const xcb_atom_t effectAtom = atom(c, BlurBehindAtom);
+    if (effectAtom == XCB_ATOM_NONE) {
         return;
     }
 
     if (enable) {
-        QVector<uint32_t> data;
-        data.reserve(region.rectCount() * 4);
-        for (const QRect& r : region) {
-            // kwin on X uses device pixels, convert from logical
-            auto dpr = qApp->devicePixelRatio();
-            data << r.x() * dpr << r.y() * dpr << r.width() * dpr << r.height() * dpr;
+        const RegionEffectState state = {region, qApp->devicePixelRatio(), 1, 1, 1};
+        if (isRegionEffectSet(m_blurBehind, window, effectAtom, state)) {
+            return;
         }
+        const QVector<uint32_t> data = serializeRegion(region, state.devicePixelRatio, s_regionTolerance, s_maxRegionRects);
 
-        xcb_change_property(c, XCB_PROP_MODE_REPLACE, window, atom->atom, XCB_ATOM_CARDINAL,
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, window, effectAtom, XCB_ATOM_CARDINAL,
                             32, data.size(), data.constData());
+        OwnWrite &write = m_ownWrites[qMakePair(xcb_window_t(window), effectAtom)];
+        ++write.pending;
+        write.state = state;
     } else {
-        xcb_delete_property(c, window, atom->atom);
+        m_blurBehind.remove(window);
+        m_ownWrites.remove(qMakePair(xcb_window_t(window), effectAtom));
+        xcb_delete_property(c, window, effectAtom);
     }
 }
 
 void KWindowEffectsPrivateX11::enableBackgroundContrast(WId window, bool enable, qreal contrast, qreal intensity, qreal saturation, const QRegion &region)
 {
     xcb_connection_t *c = QX11Info::connection();
-    const QByteArray effectName = QByteArrayLiteral("_KDE_NET_WM_BACKGROUND_CONTRAST_REGION");
-    xcb_intern_atom_cookie_t atomCookie = xcb_intern_atom_unchecked(c, false, effectName.length(), effectName.constData());
-    QScopedPointer<xcb_intern_atom_reply_t, QScopedPointerPodDeleter> atom(xcb_intern_atom_reply(c, atomCookie, nullptr));
-    if (!atom) {
+    if (!c) {
+        return;
+    }
+    const xcb_atom_t effectAtom = atom(c, BackgroundContrastAtom);
+    if (effectAtom == XCB_ATOM_NONE) {
         return;
     }
 
     if (enable) {
-        QVector<uint32_t> data;
-        data.reserve(region.rectCount() * 4 + 16);
-        for (const QRect& r : region) {
-            auto dpr = qApp->devicePixelRatio();
-            data << r.x() * dpr << r.y() * dpr << r.width() * dpr << r.height() * dpr;
+        const RegionEffectState state = {region, qApp->devicePixelRatio(), contrast, intensity, saturation};
+        if (isRegionEffectSet(m_backgroundContrast, window, effectAtom, state)) {
+            return;
         }
+        QVector<uint32_t> data = serializeRegion(region, state.devicePixelRatio, s_regionTolerance, s_maxRegionRects);
 
         QMatrix4x4 satMatrix; //saturation
         QMatrix4x4 intMatrix; //intensity
@@ -324,10 +736,31 @@ void KWindowEffectsPrivateX11::enableBackgroundContrast(WId window, bool enable,
             data << rawData[i];
         }
         
-        xcb_change_property(c, XCB_PROP_MODE_REPLACE, window, atom->atom, atom->atom,
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, window, effectAtom, effectAtom,
                             32, data.size(), data.constData());
+        OwnWrite &write = m_ownWrites[qMakePair(xcb_window_t(window), effectAtom)];
+        ++write.pending;
+        write.state = state;
     } else {
-        xcb_delete_property(c, window, atom->atom);
+        m_backgroundContrast.remove(window);
+        m_ownWrites.remove(qMakePair(xcb_window_t(window), effectAtom));
+        xcb_delete_property(c, window, effectAtom);
+    }
+}
+
+void KWindowEffectsPrivateX11::beginBatch()
+{
+    // resolve the atoms before any change of the batch is queued, waiting for
+    // their replies in between would send the changes applied so far
+    if (xcb_connection_t *c = QX11Info::connection()) {
+        atom(c, SlideAtom);
+    }
+}
+
+void KWindowEffectsPrivateX11::flush()
+{
+    if (xcb_connection_t *c = QX11Info::connection()) {
+        xcb_flush(c);
     }
 }
 
@@ -21,7 +21,16 @@
 #define KWINDOWEFFECTS_X11_H
 #include "kwindoweffects_p.h"
 
-class KWindowEffectsPrivateX11 : public KWindowEffectsPrivate
+#include <QAbstractNativeEventFilter>
+#include <QHash>
+#include <QMetaObject>
+#include <QObject>
+#include <QPair>
+#include <QRegion>
+
+#include <xcb/xcb.h>
+
+class KWindowEffectsPrivateX11 : public KWindowEffectsPrivateV2, public QAbstractNativeEventFilter
 {
 public:
     KWindowEffectsPrivateX11();
@@ -35,6 +44,75 @@ public:
     void enableBlurBehind(WId window, bool enable = true, const QRegion& region = QRegion()) override;
     void enableBackgroundContrast(WId window, bool enable = true, qreal contrast = 1, qreal intensity = 1, qreal saturation = 1, const QRegion &region = QRegion()) override;
     void markAsDashboard(WId window) override;
+    void beginBatch() override;
+    void flush() override;
+
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override;
+
+private:
+    enum EffectAtom {
+        SlideAtom,
+        PresentWindowsDesktopAtom,
+        PresentWindowsGroupAtom,
+        HighlightWindowsAtom,
+        BlurBehindAtom,
+        DashboardAtom,
+        BackgroundContrastAtom,
+        EffectAtomCount,
+        NetFrameExtentsAtom = EffectAtomCount,
+        KdeFrameStrutAtom,
+        AtomCount
+    };
+    void internAtoms(xcb_connection_t *c);
+    xcb_atom_t atom(xcb_connection_t *c, EffectAtom which);
+    void trackAvailability(xcb_connection_t *c);
+    void setEffectPropertyPresent(int index, bool present);
+    void setCompositingActive(bool active);
+    void forgetWindow(xcb_window_t window);
+
+    // Atoms are interned once per connection: all requests go out
+    // together and the replies are only collected on first use.
+    xcb_connection_t *m_atomConnection = nullptr;
+    bool m_atomsPending = false;
+    xcb_intern_atom_cookie_t m_atomCookies[AtomCount];
+    xcb_atom_t m_atoms[AtomCount];
+
+    // Availability is read from the root window once and then kept up to
+    // date from PropertyNotify events and KWindowSystem::compositingChanged.
+    bool m_trackingAvailability = false;
+    xcb_window_t m_rootWindow = XCB_WINDOW_NONE;
+    bool m_compositingActive = false;
+    bool m_effectPropertyPresent[EffectAtomCount];
+    QMetaObject::Connection m_compositingConnection;
+    // Context for queued calls into this backend, they are dropped with it
+    QObject m_context;
+
+    // What was last set on a window for the region based effects, so that
+    // repeated identical requests do not cause any X11 traffic.
+    struct RegionEffectState {
+        QRegion region;
+        qreal devicePixelRatio;
+        qreal contrast;
+        qreal intensity;
+        qreal saturation;
+        bool operator==(const RegionEffectState &other) const;
+    };
+    bool isRegionEffectSet(const QHash<xcb_window_t, RegionEffectState> &states, xcb_window_t window, xcb_atom_t effectAtom, const RegionEffectState &state) const;
+    void regionEffectChanged(QHash<xcb_window_t, RegionEffectState> &states, xcb_property_notify_event_t *event);
+
+    // What is known to be set on a window. A state only gets here once the
+    // PropertyNotify of our own change arrives, which only happens for windows
+    // with PropertyChange selected. For them the changes of other clients are
+    // noticed as well, so the state can be kept.
+    QHash<xcb_window_t, RegionEffectState> m_blurBehind;
+    QHash<xcb_window_t, RegionEffectState> m_backgroundContrast;
+    // Property changes of our own whose PropertyNotify is still to come, with
+    // the state written last
+    struct OwnWrite {
+        int pending = 0;
+        RegionEffectState state;
+    };
+    QHash<QPair<xcb_window_t, xcb_atom_t>, OwnWrite> m_ownWrites;
 };
 
 #endif
@@ -23,7 +23,9 @@
 
 #include <kxerrorhandler_p.h>
 #include <fixx11h.h>
+#include <kxeventrecording_p.h>
 #include <kxutils_p.h>
+#include <kxpixelconversion_p.h>
 
 #include <QBitmap>
 #include <QDebug>
@@ -136,7 +138,8 @@ NETEventFilter::NETEventFilter(KWindowSystemPrivateX11::FilterInfo _what)
       haveXfixes(false),
       what(_what),
       winId(XCB_WINDOW_NONE),
-      m_appRootWindow(QX11Info::appRootWindow())
+      m_appRootWindow(QX11Info::appRootWindow()),
+      m_recorder(KXUtils::EventRecorder::fromEnvironment(QX11Info::connection(), m_appRootWindow))
 {
     QCoreApplication::instance()->installNativeEventFilter(this);
 
@@ -189,6 +192,10 @@ bool NETEventFilter::nativeEventFilter(xcb_generic_event_t *ev)
     KWindowSystem *s_q = KWindowSystem::self();
     const uint8_t eventType = ev->response_type & ~0x80;
 
+    if (m_recorder) {
+        m_recorder->record(ev);
+    }
+
     if (eventType == xfixesEventBase + XCB_XFIXES_SELECTION_NOTIFY) {
         xcb_xfixes_selection_notify_event_t *event = reinterpret_cast<xcb_xfixes_selection_notify_event_t *>(ev);
         if (event->window == winId) {
@@ -229,6 +236,12 @@ bool NETEventFilter::nativeEventFilter(xcb_generic_event_t *ev)
         break;
     }
 
+    // record the value NETRootInfo or NETWinInfo are about to read
+    if (m_recorder && eventType == XCB_PROPERTY_NOTIFY
+            && (eventWindow == m_appRootWindow || windows.contains(eventWindow))) {
+        m_recorder->recordProperty(reinterpret_cast<xcb_property_notify_event_t *>(ev));
+    }
+
     if (eventWindow == m_appRootWindow) {
         int old_current_desktop = currentDesktop();
         xcb_window_t old_active_window = activeWindow();
@@ -406,6 +419,7 @@ static bool atoms_created = false;
 static Atom _wm_protocols;
 static Atom _wm_change_state;
 static Atom kwm_utf8_string;
+static Atom net_wm_icon;
 
 static void create_atoms()
 {
@@ -425,6 +439,9 @@ static void create_atoms()
         atoms[n] = &kwm_utf8_string;
         names[n++] = "UTF8_STRING";
 
+        atoms[n] = &net_wm_icon;
+        names[n++] = "_NET_WM_ICON";
+
         char net_wm_cm_name[ 100 ];
         sprintf(net_wm_cm_name, "_NET_WM_CM_S%d", QX11Info::appScreen());
         atoms[n] = &net_wm_cm;
@@ -463,6 +480,10 @@ void KWindowSystemPrivateX11::connectNotify(const QMetaMethod &signal)
     }
 
     init(what);
+    if (signal == QMetaMethod::fromSignal(&KWindowSystem::effectAvailabilityChanged)) {
+        // the first query starts tracking the availability of all effects
+        KWindowEffects::isEffectAvailable(KWindowEffects::BlurBehind);
+    }
     NETEventFilter *const s_d = s_d_func();
     if (!s_d->strutSignalConnected && signal == QMetaMethod::fromSignal(&KWindowSystem::strutChanged)) {
         s_d->strutSignalConnected = true;
@@ -706,12 +727,19 @@ QPixmap KWindowSystemPrivateX11::iconFromNetWinInfo(int width, int height, bool
     if (flags & KWindowSystem::NETWM) {
         NETIcon ni = info->icon(width, height);
         if (ni.data && ni.size.width > 0 && ni.size.height > 0) {
-            QImage img((uchar *) ni.data, (int) ni.size.width, (int) ni.size.height, QImage::Format_ARGB32);
+            // premultiply right away, Qt would have to do it before painting anyway
+            QImage img(ni.size.width, ni.size.height, QImage::Format_ARGB32_Premultiplied);
+            if (!img.isNull()) {
+                const uint32_t *src = reinterpret_cast<const uint32_t *>(ni.data);
+                for (int y = 0; y < img.height(); ++y, src += img.width()) {
+                    KXUtils::pixelKernels().premultiply(src, reinterpret_cast<uint32_t *>(img.scanLine(y)), img.width());
+                }
+            }
             if (scale && width > 0 && height > 0 && img.size() != QSize(width, height) && !img.isNull()) {
                 img = img.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
             }
             if (!img.isNull()) {
-                result = QPixmap::fromImage(img);
+                result = QPixmap::fromImage(std::move(img));
             }
             return result;
         }
@@ -785,24 +813,25 @@ void KWindowSystemPrivateX11::setIcons(WId win, const QPixmap &icon, const QPixm
     if (icon.isNull()) {
         return;
     }
-    NETWinInfo info(QX11Info::connection(), win, QX11Info::appRootWindow(), NET::Properties(), NET::Properties2());
-    QImage img = icon.toImage().convertToFormat(QImage::Format_ARGB32);
-    NETIcon ni;
-    ni.size.width = img.size().width();
-    ni.size.height = img.size().height();
-    ni.data = (unsigned char *) img.bits();
-    info.setIcon(ni, true);
-    if (miniIcon.isNull()) {
-        return;
+    const QImage images[2] = { icon.toImage(), miniIcon.toImage() };
+    const int count = images[1].isNull() ? 1 : 2;
+
+    // both sizes are converted straight from the images into the _NET_WM_ICON
+    // layout and written as they are, NETWinInfo::setIcons would copy them twice
+    int length = 0;
+    for (int i = 0; i < count; ++i) {
+        length += KXUtils::netWmIconLength(images[i]);
     }
-    img = miniIcon.toImage().convertToFormat(QImage::Format_ARGB32);
-    if (img.isNull()) {
-        return;
+    QVector<uint32_t> data(length);
+    uint32_t *out = data.data();
+    for (int i = 0; i < count; ++i) {
+        KXUtils::writeNetWmIcon(images[i], out);
+        out += KXUtils::netWmIconLength(images[i]);
     }
-    ni.size.width = img.size().width();
-    ni.size.height = img.size().height();
-    ni.data = (unsigned char *) img.bits();
-    info.setIcon(ni, false);
+
+    create_atoms();
+    xcb_change_property(QX11Info::connection(), XCB_PROP_MODE_REPLACE, win, net_wm_icon,
+                        XCB_ATOM_CARDINAL, 32, length, data.constData());
 }
 
 void KWindowSystemPrivateX11::setType(WId win, NET::WindowType windowType)
@@ -26,6 +26,10 @@
 #include <QAbstractNativeEventFilter>
 
 class NETEventFilter;
+namespace KXUtils
+{
+class EventRecorder;
+}
 
 class KWindowSystemPrivateX11 : public KWindowSystemPrivate
 {
@@ -145,7 +149,8 @@ private:
     bool nativeEventFilter(xcb_generic_event_t *event);
     xcb_window_t winId;
     xcb_window_t m_appRootWindow;
-
+    // shared by all filters, see KXUtils::EventRecorder::fromEnvironment
+    KXUtils::EventRecorder *m_recorder;
 };
 
 #endif
@@ -0,0 +1,371 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kxeventrecording_p.h"
+
+#include <QDebug>
+#include <QScopedPointer>
+#include <QVarLengthArray>
+
+#include <string.h>
+
+namespace KXUtils
+{
+
+static const quint32 s_magic = 0x4b584552; // "KXER"
+static const quint16 s_version = 1;
+// the size of an event on the wire, xcb_generic_event_t adds full_sequence
+static const int s_eventSize = 32;
+// the same limit as NETRootInfo and NETWinInfo, in 32 bit units
+static const uint32_t s_maxPropertyLength = 100000;
+
+enum RecordTag : quint8 {
+    AtomTag = 1,
+    EventTag = 2,
+    PropertyTag = 3
+};
+
+// atoms up to WM_TRANSIENT_FOR are the same on every server
+static inline bool isPredefinedAtom(xcb_atom_t atom)
+{
+    return atom <= XCB_ATOM_WM_TRANSIENT_FOR;
+}
+
+EventRecorder::EventRecorder(xcb_connection_t *c, xcb_window_t rootWindow, const QString &fileName)
+    : m_connection(c)
+    , m_file(fileName)
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_5_6);
+    m_stream << s_magic << s_version << quint32(rootWindow);
+    m_timer.start();
+}
+
+EventRecorder::~EventRecorder()
+{
+}
+
+EventRecorder *EventRecorder::fromEnvironment(xcb_connection_t *c, xcb_window_t rootWindow)
+{
+    // KWindowSystem replaces its event filter when more information is
+    // requested, so the recorder has to outlive the filters
+    static QScopedPointer<EventRecorder> s_recorder;
+    static bool s_initialized = false;
+    if (s_initialized) {
+        return s_recorder.data();
+    }
+    s_initialized = true;
+
+    const QString fileName = QFile::decodeName(qgetenv("KWINDOWSYSTEM_RECORD_EVENTS"));
+    if (fileName.isEmpty()) {
+        return nullptr;
+    }
+    s_recorder.reset(new EventRecorder(c, rootWindow, fileName));
+    if (!s_recorder->isRecording()) {
+        qWarning() << "Cannot record X events to" << fileName << s_recorder->m_file.errorString();
+        s_recorder.reset();
+    }
+    return s_recorder.data();
+}
+
+bool EventRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+
+void EventRecorder::noteAtoms(const xcb_atom_t *atoms, int count)
+{
+    // ask for all new names at once, so that there is at most one round trip
+    QVarLengthArray<QPair<xcb_atom_t, xcb_get_atom_name_cookie_t>, 8> cookies;
+    for (int i = 0; i < count; ++i) {
+        const xcb_atom_t atom = atoms[i];
+        if (isPredefinedAtom(atom) || m_knownAtoms.contains(atom)) {
+            continue;
+        }
+        m_knownAtoms.insert(atom);
+        cookies.append(qMakePair(atom, xcb_get_atom_name_unchecked(m_connection, atom)));
+    }
+    for (const auto &cookie : qAsConst(cookies)) {
+        QByteArray name;
+        xcb_get_atom_name_reply_t *reply = xcb_get_atom_name_reply(m_connection, cookie.second, nullptr);
+        if (reply) {
+            name = QByteArray(xcb_get_atom_name_name(reply), xcb_get_atom_name_name_length(reply));
+            free(reply);
+        }
+        m_stream << quint8(AtomTag) << quint32(cookie.first) << name;
+    }
+}
+
+void EventRecorder::record(const xcb_generic_event_t *event)
+{
+    if (!isRecording()) {
+        return;
+    }
+    switch (event->response_type & ~0x80) {
+    case XCB_PROPERTY_NOTIFY:
+        noteAtoms(&reinterpret_cast<const xcb_property_notify_event_t *>(event)->atom, 1);
+        break;
+    case XCB_CLIENT_MESSAGE:
+        noteAtoms(&reinterpret_cast<const xcb_client_message_event_t *>(event)->type, 1);
+        break;
+    }
+    m_stream << quint8(EventTag) << quint32(m_timer.elapsed());
+    m_stream.writeRawData(reinterpret_cast<const char *>(event), s_eventSize);
+}
+
+void EventRecorder::recordProperty(const xcb_property_notify_event_t *event)
+{
+    if (!isRecording()) {
+        return;
+    }
+    xcb_atom_t type = XCB_ATOM_NONE;
+    uint8_t format = 0;
+    QByteArray value;
+    if (event->state == XCB_PROPERTY_NEW_VALUE) {
+        xcb_get_property_cookie_t cookie = xcb_get_property_unchecked(m_connection, false, event->window, event->atom,
+                                                                      XCB_GET_PROPERTY_TYPE_ANY, 0, s_maxPropertyLength);
+        xcb_get_property_reply_t *reply = xcb_get_property_reply(m_connection, cookie, nullptr);
+        if (reply) {
+            type = reply->type;
+            format = reply->format;
+            value = QByteArray(reinterpret_cast<const char *>(xcb_get_property_value(reply)),
+                               xcb_get_property_value_length(reply));
+            free(reply);
+        }
+    }
+
+    noteAtoms(&type, 1);
+    if (type == XCB_ATOM_ATOM && format == 32) {
+        noteAtoms(reinterpret_cast<const xcb_atom_t *>(value.constData()), value.size() / 4);
+    }
+    m_stream << quint8(PropertyTag) << quint32(event->window) << quint32(event->atom)
+             << quint32(type) << quint8(format) << value;
+}
+
+bool EventRecording::load(const QString &fileName)
+{
+    rootWindow = XCB_WINDOW_NONE;
+    events.clear();
+    atomNames.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic;
+    quint16 version;
+    quint32 root;
+    stream >> magic >> version >> root;
+    if (stream.status() != QDataStream::Ok || magic != s_magic || version != s_version) {
+        return false;
+    }
+    rootWindow = root;
+
+    while (!stream.atEnd()) {
+        quint8 tag;
+        stream >> tag;
+        switch (tag) {
+        case AtomTag: {
+            quint32 atom;
+            QByteArray name;
+            stream >> atom >> name;
+            atomNames.insert(atom, name);
+            break;
+        }
+        case EventTag: {
+            RecordedEvent event;
+            memset(&event.event, 0, sizeof(event.event));
+            stream >> event.time;
+            if (stream.readRawData(reinterpret_cast<char *>(&event.event), s_eventSize) != s_eventSize) {
+                return false;
+            }
+            events << event;
+            break;
+        }
+        case PropertyTag: {
+            if (events.isEmpty()) {
+                return false;
+            }
+            quint32 window;
+            quint32 atom;
+            quint32 type;
+            quint8 format;
+            RecordedProperty property;
+            stream >> window >> atom >> type >> format >> property.value;
+            property.window = window;
+            property.atom = atom;
+            property.type = type;
+            property.format = format;
+            events.last().properties << property;
+            break;
+        }
+        default:
+            return false;
+        }
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+EventReplayer::EventReplayer(xcb_connection_t *c, xcb_window_t rootWindow, const EventRecording &recording)
+    : m_connection(c)
+    , m_rootWindow(rootWindow)
+    , m_recordedRootWindow(recording.rootWindow)
+    , m_events(recording.events)
+{
+    // intern all atoms in one go
+    QVector<QPair<xcb_atom_t, xcb_intern_atom_cookie_t>> cookies;
+    cookies.reserve(recording.atomNames.count());
+    for (auto it = recording.atomNames.constBegin(); it != recording.atomNames.constEnd(); ++it) {
+        cookies << qMakePair(it.key(), xcb_intern_atom_unchecked(c, false, it.value().length(), it.value().constData()));
+    }
+    for (const auto &cookie : qAsConst(cookies)) {
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(c, cookie.second, nullptr);
+        if (reply) {
+            m_atoms.insert(cookie.first, reply->atom);
+            free(reply);
+        }
+    }
+
+    // translate everything up front, replay() only passes the events on
+    for (RecordedEvent &recorded : m_events) {
+        xcb_generic_event_t *event = &recorded.event;
+        switch (event->response_type & ~0x80) {
+        case XCB_PROPERTY_NOTIFY: {
+            xcb_property_notify_event_t *e = reinterpret_cast<xcb_property_notify_event_t *>(event);
+            e->window = translateWindow(e->window);
+            e->atom = translateAtom(e->atom);
+            break;
+        }
+        case XCB_CLIENT_MESSAGE: {
+            xcb_client_message_event_t *e = reinterpret_cast<xcb_client_message_event_t *>(event);
+            e->window = translateWindow(e->window);
+            e->type = translateAtom(e->type);
+            break;
+        }
+        case XCB_CONFIGURE_NOTIFY: {
+            xcb_configure_notify_event_t *e = reinterpret_cast<xcb_configure_notify_event_t *>(event);
+            e->event = translateWindow(e->event);
+            e->window = translateWindow(e->window);
+            e->above_sibling = translateWindow(e->above_sibling);
+            break;
+        }
+        }
+
+        for (RecordedProperty &property : recorded.properties) {
+            property.window = translateWindow(property.window);
+            property.atom = translateAtom(property.atom);
+            property.type = translateAtom(property.type);
+            if (property.format != 32 || (property.type != XCB_ATOM_ATOM && property.type != XCB_ATOM_WINDOW)) {
+                continue;
+            }
+            uint32_t *values = reinterpret_cast<uint32_t *>(property.value.data());
+            for (int i = 0; i < property.value.size() / 4; ++i) {
+                values[i] = property.type == XCB_ATOM_ATOM ? translateAtom(values[i]) : translateWindow(values[i]);
+            }
+        }
+    }
+    xcb_flush(c);
+}
+
+EventReplayer::~EventReplayer()
+{
+    for (xcb_window_t window : qAsConst(m_windows)) {
+        xcb_destroy_window(m_connection, window);
+    }
+    xcb_flush(m_connection);
+}
+
+int EventReplayer::count() const
+{
+    return m_events.count();
+}
+
+xcb_atom_t EventReplayer::translateAtom(xcb_atom_t atom) const
+{
+    if (isPredefinedAtom(atom)) {
+        return atom;
+    }
+    return m_atoms.value(atom, atom);
+}
+
+xcb_window_t EventReplayer::translateWindow(xcb_window_t window)
+{
+    if (window == XCB_WINDOW_NONE) {
+        return XCB_WINDOW_NONE;
+    }
+    if (window == m_recordedRootWindow) {
+        return m_rootWindow;
+    }
+    auto it = m_windows.constFind(window);
+    if (it != m_windows.constEnd()) {
+        return it.value();
+    }
+    const xcb_window_t standIn = xcb_generate_id(m_connection);
+    xcb_create_window(m_connection, XCB_COPY_FROM_PARENT, standIn, m_rootWindow,
+                      0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, nullptr);
+    m_windows.insert(window, standIn);
+    return standIn;
+}
+
+xcb_window_t EventReplayer::window(xcb_window_t window) const
+{
+    if (window == m_recordedRootWindow) {
+        return m_rootWindow;
+    }
+    return m_windows.value(window, XCB_WINDOW_NONE);
+}
+
+void EventReplayer::applyProperties()
+{
+    // the last value recorded for each property is the one to end up with
+    QHash<QPair<xcb_window_t, xcb_atom_t>, const RecordedProperty *> properties;
+    for (const RecordedEvent &recorded : qAsConst(m_events)) {
+        for (const RecordedProperty &property : recorded.properties) {
+            properties.insert(qMakePair(property.window, property.atom), &property);
+        }
+    }
+    for (const RecordedProperty *property : qAsConst(properties)) {
+        if (property->type == XCB_ATOM_NONE) {
+            xcb_delete_property(m_connection, property->window, property->atom);
+        } else {
+            xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, property->window, property->atom,
+                                property->type, property->format, property->value.size() / (property->format / 8),
+                                property->value.constData());
+        }
+    }
+    // the values have to be there before the first event is passed on
+    free(xcb_get_input_focus_reply(m_connection, xcb_get_input_focus_unchecked(m_connection), nullptr));
+}
+
+void EventReplayer::replay(const std::function<void(xcb_generic_event_t *)> &filter)
+{
+    for (const RecordedEvent &recorded : qAsConst(m_events)) {
+        // the filters get their own copy, like from the event queue
+        xcb_generic_event_t event = recorded.event;
+        filter(&event);
+    }
+}
+
+} // namespace
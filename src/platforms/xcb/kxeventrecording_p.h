@@ -0,0 +1,184 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KXEVENTRECORDING_P_H
+#define KXEVENTRECORDING_P_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include <xcb/xcb.h>
+
+#include <functional>
+
+namespace KXUtils
+{
+
+/**
+ * Records the X events seen by the native event filter of the X11 backend,
+ * together with the values of the properties they make NETRootInfo and
+ * NETWinInfo read, so that event mixes of real sessions can be replayed in
+ * benchmarks.
+ *
+ * Recording is enabled by setting KWINDOWSYSTEM_RECORD_EVENTS to the name
+ * of the file to write.
+ *
+ * The file is a QDataStream starting with a header (magic, version, root
+ * window), followed by tagged records: the name of each non predefined atom
+ * before its first use, every event as its 32 byte wire representation with
+ * a timestamp, and after a PropertyNotify the value of that property. The
+ * payload of generic events is not recorded.
+ *
+ * Reading a property value, and the names of atoms not seen before, takes a
+ * round trip to the X server right in the native event filter. While
+ * recording, events are therefore handled slower than usual, and timings
+ * taken in the recording process are not representative.
+ */
+class EventRecorder
+{
+public:
+    EventRecorder(xcb_connection_t *c, xcb_window_t rootWindow, const QString &fileName);
+    ~EventRecorder();
+
+    /**
+     * @return the recorder of this process for the file named by
+     * KWINDOWSYSTEM_RECORD_EVENTS, or @c nullptr if it is not set or the
+     * file cannot be written. It is created on the first call, later calls
+     * return the same recorder whatever their arguments.
+     */
+    static EventRecorder *fromEnvironment(xcb_connection_t *c, xcb_window_t rootWindow);
+
+    bool isRecording() const;
+
+    /**
+     * Records @p event.
+     */
+    void record(const xcb_generic_event_t *event);
+    /**
+     * Records the current value of the property changed by @p event. Call
+     * it right after record() for the property changes the filter acts on.
+     */
+    void recordProperty(const xcb_property_notify_event_t *event);
+
+private:
+    void noteAtoms(const xcb_atom_t *atoms, int count);
+
+    xcb_connection_t *m_connection;
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_timer;
+    QSet<xcb_atom_t> m_knownAtoms;
+};
+
+/**
+ * A property value recorded by EventRecorder. A type of XCB_ATOM_NONE means
+ * the property did not exist.
+ */
+struct RecordedProperty {
+    xcb_window_t window;
+    xcb_atom_t atom;
+    xcb_atom_t type;
+    uint8_t format;
+    QByteArray value;
+};
+
+/**
+ * An event recorded by EventRecorder, with the properties recorded for it.
+ */
+struct RecordedEvent {
+    /// Milliseconds since the recording started
+    quint32 time;
+    xcb_generic_event_t event;
+    QVector<RecordedProperty> properties;
+};
+
+/**
+ * A recording written by EventRecorder.
+ */
+class EventRecording
+{
+public:
+    /**
+     * Reads the recording from @p fileName.
+     * @return @c false if the file cannot be read or is not a recording
+     */
+    bool load(const QString &fileName);
+
+    xcb_window_t rootWindow = XCB_WINDOW_NONE;
+    QVector<RecordedEvent> events;
+    QHash<xcb_atom_t, QByteArray> atomNames;
+};
+
+/**
+ * Replays an EventRecording against a stand-in X server, such as Xvfb.
+ *
+ * The windows of the recording are replaced by windows created on the
+ * stand-in server, the root window by its root window, and the atoms are
+ * interned there. applyProperties() writes the final recorded property values
+ * to the stand-in windows, so NETRootInfo and NETWinInfo read the state the
+ * recorded session ended in, whichever event they handle. The server is not
+ * written to during replay(). Atoms and windows in the data of client
+ * messages are not translated.
+ *
+ * To replay through KWindowSystem, pass the events on to
+ * QAbstractEventDispatcher::filterNativeEvent(), like the platform plugin
+ * does with the events from the X server.
+ */
+class EventReplayer
+{
+public:
+    EventReplayer(xcb_connection_t *c, xcb_window_t rootWindow, const EventRecording &recording);
+    ~EventReplayer();
+
+    int count() const;
+
+    /**
+     * @return the stand-in window for the recorded window @p window
+     */
+    xcb_window_t window(xcb_window_t window) const;
+
+    /**
+     * Writes the last recorded value of every property to the stand-in
+     * windows, and waits until the server has applied them.
+     */
+    void applyProperties();
+
+    /**
+     * Passes all events of the recording to @p filter, in order.
+     */
+    void replay(const std::function<void(xcb_generic_event_t *)> &filter);
+
+private:
+    xcb_atom_t translateAtom(xcb_atom_t atom) const;
+    xcb_window_t translateWindow(xcb_window_t window);
+
+    xcb_connection_t *m_connection;
+    xcb_window_t m_rootWindow;
+    xcb_window_t m_recordedRootWindow;
+    QHash<xcb_atom_t, xcb_atom_t> m_atoms;
+    QHash<xcb_window_t, xcb_window_t> m_windows;
+    QVector<RecordedEvent> m_events;
+};
+
+} // namespace
+
+#endif
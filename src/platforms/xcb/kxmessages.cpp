@@ -32,11 +32,40 @@ DEALINGS IN THE SOFTWARE.
 #include <QDebug>
 #include <QWindow> // WId
 #include <QAbstractNativeEventFilter>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QMetaMethod>
+#include <QQueue>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
 
 #include <xcb/xcb.h>
 #include <qx11info_x11.h>
 #include <X11/Xlib.h>
 
+// Atoms used by the property transport. The payload of a message is published in one
+// of the slot properties on the sender's handle window, which are used round robin.
+// Receivers able to read them list (message type, receiver window) pairs in the
+// advertisement property of the root window, and acknowledge every payload they read
+// by appending (slot, serial) to the acknowledgement property of the handle window.
+// The transport is only used while the <message type>_PROPERTY_TRANSPORT selection
+// has an owner, which declares that no receiver of the type needs fragments.
+static const char s_propertyTransportAtom[] = "_KDE_KXMESSAGES_PROPERTY_TRANSPORT";
+static const char s_acknowledgeAtom[] = "_KDE_KXMESSAGES_ACK";
+static const char s_payloadTypeAtom[] = "_KDE_KXMESSAGES_PAYLOAD";
+static const char s_payloadSlotAtom[] = "_KDE_KXMESSAGES_PAYLOAD_";
+static const char s_propertyTransportSuffix[] = "_PROPERTY_TRANSPORT";
+static const int s_payloadSlotCount = 8;
+// upper bound for the advertisement and acknowledgement properties, in 32 bit units
+static const uint32_t s_maxPropertyLength = 65536;
+// messages fitting into this many fragments are cheaper to send the classic way
+static const int s_minimumPropertyFragments = 3;
+// a slot not acknowledged by all receivers within this time is considered free again
+static const qint64 s_acknowledgeTimeout = 10000;
+// how often a receiver checks for the payloads it requested, in milliseconds
+static const int s_payloadPollInterval = 1;
 
 class XcbAtom
 {
@@ -105,6 +134,120 @@ private:
     bool m_onlyIfExists;
 };
 
+/**
+ * Partially received messages, keyed by the window they are sent from.
+ *
+ * This is an open addressing hash table with linear probing. The buffers of
+ * finished messages stay allocated in their slots and get reused, so that
+ * reassembling a message neither allocates nor needs more than one lookup
+ * per fragment.
+ */
+class KXIncomingMessages
+{
+public:
+    KXIncomingMessages()
+        : m_slots(s_initialCapacity)
+        , m_count(0)
+    {
+    }
+
+    /**
+     * Returns the buffer for messages from @p window. If there is none yet, a new
+     * empty one is created if @p create is true, otherwise nullptr is returned.
+     */
+    QByteArray *find(xcb_window_t window, bool create)
+    {
+        int index = probe(window);
+        if (m_slots.at(index).window == window) {
+            return &m_slots[index].data;
+        }
+        if (!create) {
+            return nullptr;
+        }
+        // keep the load factor below 1/2, so that probing stays short
+        if ((m_count + 1) * 2 > m_slots.size()) {
+            grow();
+            index = probe(window);
+        }
+        Slot &slot = m_slots[index];
+        slot.window = window;
+        slot.data.resize(0);
+        if (slot.data.capacity() < s_bufferSize) {
+            slot.data.reserve(s_bufferSize);
+        }
+        ++m_count;
+        return &slot.data;
+    }
+
+    void remove(xcb_window_t window)
+    {
+        int index = probe(window);
+        if (m_slots.at(index).window != window) {
+            return;
+        }
+        m_slots[index].window = XCB_WINDOW_NONE;
+        m_slots[index].data.resize(0);
+        --m_count;
+        // backward shift deletion, so that no tombstones are needed
+        const int mask = m_slots.size() - 1;
+        int next = (index + 1) & mask;
+        while (m_slots.at(next).window != XCB_WINDOW_NONE) {
+            const int home = hash(m_slots.at(next).window) & mask;
+            // move the entry into the hole unless its home lies cyclically in (index, next]
+            if (((next - home) & mask) >= ((next - index) & mask)) {
+                qSwap(m_slots[index], m_slots[next]);
+                index = next;
+            }
+            next = (next + 1) & mask;
+        }
+    }
+
+private:
+    struct Slot {
+        Slot() : window(XCB_WINDOW_NONE) {}
+        xcb_window_t window;
+        QByteArray data;
+    };
+
+    static uint hash(xcb_window_t window)
+    {
+        // window ids of one client differ mostly in the low bits, mix in the high ones
+        return (window ^ (window >> 16)) * 0x45d9f3bu;
+    }
+
+    // index of the slot for window, or of the empty slot where it would be inserted
+    int probe(xcb_window_t window) const
+    {
+        const int mask = m_slots.size() - 1;
+        int index = hash(window) & mask;
+        while (m_slots.at(index).window != XCB_WINDOW_NONE && m_slots.at(index).window != window) {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    void grow()
+    {
+        QVector<Slot> old(m_slots.size() * 2);
+        old.swap(m_slots);
+        m_count = 0;
+        for (Slot &slot : old) {
+            if (slot.window == XCB_WINDOW_NONE) {
+                continue;
+            }
+            const int index = probe(slot.window);
+            m_slots[index].window = slot.window;
+            m_slots[index].data.swap(slot.data);
+            ++m_count;
+        }
+    }
+
+    static const int s_initialCapacity = 16; // must be a power of 2
+    static const int s_bufferSize = 256;
+    QVector<Slot> m_slots;
+    int m_count;
+};
+
 class KXMessagesPrivate
     : public QAbstractNativeEventFilter
 {
@@ -112,6 +255,8 @@ public:
     KXMessagesPrivate(KXMessages *parent, const char *acceptBroadcast, xcb_connection_t *c, xcb_window_t root)
         : accept_atom1(acceptBroadcast ? QByteArray(acceptBroadcast) + QByteArrayLiteral("_BEGIN") : QByteArray())
         , accept_atom2(acceptBroadcast ? QByteArray(acceptBroadcast) : QByteArray())
+        , accept_notify_atom(acceptBroadcast ? QByteArray(acceptBroadcast) + QByteArrayLiteral("_NOTIFY") : QByteArray())
+        , payload_type_atom(QByteArray(s_payloadTypeAtom))
         , handle(new QWindow)
         , q(parent)
         , valid(c)
@@ -123,18 +268,109 @@ public:
                 accept_atom1.fetch();
                 accept_atom2.setConnection(c);
                 accept_atom2.fetch();
+                accept_notify_atom.setConnection(c);
+                accept_notify_atom.fetch();
+                payload_type_atom.setConnection(c);
+                payload_type_atom.fetch();
                 QCoreApplication::instance()->installNativeEventFilter(this);
             }
+            pendingTimer.setInterval(s_payloadPollInterval);
+            QObject::connect(&pendingTimer, &QTimer::timeout, q, [this]() {
+                processPendingMessages();
+            });
+        }
+    ~KXMessagesPrivate()
+    {
+        // the connection of the application is closed when a receiver outlives it
+        if (QCoreApplication::instance()) {
+            for (const PendingMessage &pending : qAsConst(pendingMessages)) {
+                if (pending.cookie.sequence) {
+                    xcb_discard_reply(connection, pending.cookie.sequence);
+                }
+            }
+            if (advertising) {
+                updateAdvertisement(false);
+            }
         }
+    }
+
+    // A message waiting to be emitted. Messages sent using the property transport
+    // wait for the reply with their payload, later ones wait behind them, so that
+    // all messages are emitted in the order they arrived.
+    struct PendingMessage {
+        xcb_get_property_cookie_t cookie; // sequence 0 once the data is there
+        xcb_window_t window;
+        xcb_atom_t slot;
+        quint32 length;
+        quint32 serial;
+        QByteArray data;
+    };
+
     XcbAtom accept_atom1;
     XcbAtom accept_atom2;
-    QMap< WId, QByteArray > incoming_messages;
+    XcbAtom accept_notify_atom;
+    XcbAtom payload_type_atom;
+    KXIncomingMessages incoming_messages;
+    QQueue<PendingMessage> pendingMessages;
+    QTimer pendingTimer;
     QScopedPointer<QWindow> handle;
     KXMessages *q;
     bool valid;
+    bool advertising = false;
+    xcb_atom_t propertyTransportAtom = XCB_ATOM_NONE;
+    xcb_atom_t acknowledgeAtom = XCB_ATOM_NONE;
     xcb_connection_t *connection;
     xcb_window_t rootWindow;
 
+    // Adds or removes the entry of this receiver in the advertisement property. The
+    // server is grabbed, so that concurrent updates of other receivers are not lost.
+    void updateAdvertisement(bool advertise)
+    {
+        const xcb_window_t receiver = handle->winId();
+        xcb_grab_server(connection);
+        const xcb_get_property_cookie_t cookie = xcb_get_property_unchecked(connection, false, rootWindow,
+                propertyTransportAtom, XCB_ATOM_CARDINAL, 0, s_maxPropertyLength);
+        KXUtils::ScopedCPointer<xcb_get_property_reply_t> reply(xcb_get_property_reply(connection, cookie, nullptr));
+        QVector<quint32> entries;
+        if (!reply.isNull() && reply->format == 32 && reply->type == XCB_ATOM_CARDINAL) {
+            const quint32 *data = reinterpret_cast<const quint32 *>(xcb_get_property_value(reply.data()));
+            const int count = xcb_get_property_value_length(reply.data()) / sizeof(quint32);
+            for (int i = 0; i + 1 < count; i += 2) {
+                if (data[i + 1] != receiver) {
+                    entries << data[i] << data[i + 1];
+                }
+            }
+        }
+        if (advertise) {
+            // drop the entries of receivers that went away without removing them,
+            // senders would otherwise wait for their acknowledgements
+            QVector<xcb_get_window_attributes_cookie_t> cookies;
+            cookies.reserve(entries.count() / 2);
+            for (int i = 0; i < entries.count(); i += 2) {
+                cookies << xcb_get_window_attributes_unchecked(connection, entries.at(i + 1));
+            }
+            QVector<quint32> alive;
+            alive.reserve(entries.count() + 2);
+            for (int i = 0; i < cookies.count(); ++i) {
+                KXUtils::ScopedCPointer<xcb_get_window_attributes_reply_t> attributes(
+                    xcb_get_window_attributes_reply(connection, cookies.at(i), nullptr));
+                if (!attributes.isNull()) {
+                    alive << entries.at(2 * i) << entries.at(2 * i + 1);
+                }
+            }
+            alive << xcb_atom_t(accept_atom2) << receiver;
+            entries.swap(alive);
+        }
+        if (entries.isEmpty()) {
+            xcb_delete_property(connection, rootWindow, propertyTransportAtom);
+        } else {
+            xcb_change_property(connection, XCB_PROP_MODE_REPLACE, rootWindow, propertyTransportAtom,
+                                XCB_ATOM_CARDINAL, 32, entries.count(), entries.constData());
+        }
+        xcb_ungrab_server(connection);
+        xcb_flush(connection);
+    }
+
     bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override
     {
         Q_UNUSED(result);
@@ -143,40 +379,134 @@ public:
             return false;
         }
         xcb_generic_event_t *event = reinterpret_cast<xcb_generic_event_t *>(message);
+        if (!pendingMessages.isEmpty()) {
+            processPendingMessages();
+        }
         uint response_type = event->response_type & ~0x80;
         if (response_type != XCB_CLIENT_MESSAGE) {
             return false;
         }
         xcb_client_message_event_t *cm_event = reinterpret_cast<xcb_client_message_event_t *>(event);
+        if (cm_event->format == 32 && cm_event->type == accept_notify_atom) {
+            requestPropertyMessage(cm_event);
+            return false;
+        }
         if (cm_event->format != 8) {
             return false;
         }
         if (cm_event->type != accept_atom1 && cm_event->type != accept_atom2) {
             return false;
         }
-        char buf[ 21 ]; // can't be longer
-        // Copy the data in order to null-terminate it
-        qstrncpy(buf, reinterpret_cast<char *>(cm_event->data.data8), 21);
-        //qDebug() << cm_event->window << "buf=\"" << buf << "\" atom=" << (cm_event->type == accept_atom1 ? "atom1" : "atom2");
-        if (incoming_messages.contains(cm_event->window)) {
-            if (cm_event->type == accept_atom1)
-                // two different messages on the same window at the same time shouldn't happen anyway
-            {
-                incoming_messages[cm_event->window] = QByteArray();
-            }
-            incoming_messages[cm_event->window] += buf;
-        } else {
-            if (cm_event->type == accept_atom2) {
-                return false; // middle of message, but we don't have the beginning
-            }
-            incoming_messages[cm_event->window] = buf;
+        const char *fragment = reinterpret_cast<const char *>(cm_event->data.data8);
+        const uint length = qstrnlen(fragment, 20);
+        const bool leading = cm_event->type == accept_atom1;
+        // a leading fragment starts a new message, anything else needs the beginning
+        QByteArray *data = incoming_messages.find(cm_event->window, leading);
+        if (!data) {
+            return false; // middle of message, but we don't have the beginning
+        }
+        if (leading) {
+            // two different messages on the same window at the same time shouldn't happen anyway
+            data->resize(0);
         }
-        if (strlen(buf) < 20) { // last message fragment
-            emit q->gotMessage(QString::fromUtf8(incoming_messages[cm_event->window].constData()));
+        data->append(fragment, length);
+        if (length < 20) { // last message fragment
+            if (pendingMessages.isEmpty()) {
+                emitMessage(*data);
+            } else {
+                PendingMessage pending;
+                pending.cookie.sequence = 0;
+                pending.data = *data;
+                pendingMessages.enqueue(pending);
+            }
             incoming_messages.remove(cm_event->window);
         }
         return false; // lets other KXMessages instances get the event too
     }
+
+    // message sent using the property transport of KXMessagesSender, the payload is
+    // requested here and picked up by processPendingMessages() once it arrived
+    void requestPropertyMessage(const xcb_client_message_event_t *cm_event)
+    {
+        PendingMessage pending;
+        pending.window = cm_event->window;
+        pending.slot = cm_event->data.data32[0];
+        pending.length = cm_event->data.data32[1];
+        pending.serial = cm_event->data.data32[2];
+        pending.cookie = xcb_get_property_unchecked(connection, false, pending.window,
+                pending.slot, payload_type_atom, 0, (pending.length + 4 + 3) / 4);
+        xcb_flush(connection);
+        pendingMessages.enqueue(pending);
+        if (!pendingTimer.isActive()) {
+            pendingTimer.start();
+        }
+    }
+
+    // takes the payload of a property message from its reply, returns false if it is unusable
+    bool takePayload(PendingMessage &pending, xcb_get_property_reply_t *reply)
+    {
+        if (!reply || reply->format != 8 || reply->type != payload_type_atom
+                || quint32(xcb_get_property_value_length(reply)) < pending.length + 4) {
+            return false;
+        }
+        const uchar *data = reinterpret_cast<const uchar *>(xcb_get_property_value(reply));
+        const quint32 storedSerial = data[0] | (data[1] << 8) | (data[2] << 16) | (quint32(data[3]) << 24);
+        if (storedSerial != pending.serial) {
+            qWarning() << "KXMessages: message payload was overwritten before it could be read";
+            return false;
+        }
+        if (advertising) {
+            // the sender keeps the slot until all advertised receivers have read it
+            const quint32 acknowledgement[2] = { pending.slot, pending.serial };
+            xcb_change_property(connection, XCB_PROP_MODE_APPEND, pending.window, acknowledgeAtom,
+                                XCB_ATOM_CARDINAL, 32, 2, acknowledgement);
+            xcb_flush(connection);
+        }
+        pending.data = QByteArray(reinterpret_cast<const char *>(data + 4), pending.length);
+        return true;
+    }
+
+    // emits the pending messages whose payload arrived, without waiting for the others
+    void processPendingMessages()
+    {
+        while (!pendingMessages.isEmpty()) {
+            PendingMessage &pending = pendingMessages.head();
+            if (pending.cookie.sequence) {
+                void *reply = nullptr;
+                xcb_generic_error_t *error = nullptr;
+                if (!xcb_poll_for_reply(connection, pending.cookie.sequence, &reply, &error)) {
+                    break;
+                }
+                free(error);
+                pending.cookie.sequence = 0;
+                const bool usable = takePayload(pending, reinterpret_cast<xcb_get_property_reply_t *>(reply));
+                free(reply);
+                if (!usable) {
+                    pendingMessages.dequeue();
+                    continue;
+                }
+            }
+            // a slot connected to the signal may get here again
+            const QByteArray message = pendingMessages.dequeue().data;
+            emitMessage(message);
+        }
+        if (pendingMessages.isEmpty()) {
+            pendingTimer.stop();
+        }
+    }
+
+    void emitMessage(const QByteArray &message)
+    {
+        static const QMetaMethod gotMessageSignal = QMetaMethod::fromSignal(&KXMessages::gotMessage);
+        static const QMetaMethod gotRawMessageSignal = QMetaMethod::fromSignal(&KXMessages::gotRawMessage);
+        if (q->isSignalConnected(gotRawMessageSignal)) {
+            emit q->gotRawMessage(message);
+        }
+        // the conversion is only paid for when somebody listens
+        if (q->isSignalConnected(gotMessageSignal)) {
+            emit q->gotMessage(QString::fromUtf8(message.constData(), message.size()));
+        }
+    }
 };
 
 #if KWINDOWSYSTEM_BUILD_DEPRECATED_SINCE(5, 18)
@@ -186,7 +516,7 @@ static void send_message_internal(WId w_P, const QString &msg_P, long mask_P,
 static const long BROADCAST_MASK = PropertyChangeMask;
 // CHECKME
 #endif
-static void send_message_internal(xcb_window_t w, const QString &msg, xcb_connection_t *c,
+static void send_message_internal(xcb_window_t w, const QByteArray &msg, xcb_connection_t *c,
                                   xcb_atom_t leadingMessage, xcb_atom_t followingMessage, xcb_window_t handle);
 
 KXMessages::KXMessages(const char *accept_broadcast_P, QObject *parent_P)
@@ -229,10 +559,46 @@ void KXMessages::broadcastMessage(const char *msg_type_P, const QString &message
     XcbAtom a2(d->connection, msg);
     XcbAtom a1(d->connection, msg + QByteArrayLiteral("_BEGIN"));
     xcb_window_t root = screen_P == -1 ? d->rootWindow : defaultScreen(d->connection, screen_P)->root;
-    send_message_internal(root, message_P, d->connection,
+    send_message_internal(root, message_P.toUtf8(), d->connection,
                           a1, a2, d->handle->winId());
 }
 
+void KXMessages::advertisePropertyTransport()
+{
+    if (!d->valid || d->accept_atom2.name().isEmpty() || d->advertising) {
+        return;
+    }
+    XcbAtom propertyTransport(d->connection, QByteArray(s_propertyTransportAtom));
+    XcbAtom acknowledge(d->connection, QByteArray(s_acknowledgeAtom));
+    d->propertyTransportAtom = propertyTransport;
+    d->acknowledgeAtom = acknowledge;
+    if (d->propertyTransportAtom == XCB_ATOM_NONE || d->acknowledgeAtom == XCB_ATOM_NONE) {
+        return;
+    }
+    d->advertising = true;
+    d->updateAdvertisement(true);
+}
+
+void KXMessages::claimPropertyTransport()
+{
+    if (!d->valid || d->accept_atom2.name().isEmpty()) {
+        return;
+    }
+    XcbAtom selection(d->connection, d->accept_atom2.name() + QByteArray(s_propertyTransportSuffix));
+    if (selection == XCB_ATOM_NONE) {
+        return;
+    }
+    // the claim of somebody else is as good, and taking it over would end it
+    // when this receiver goes away first
+    KXUtils::ScopedCPointer<xcb_get_selection_owner_reply_t> owner(xcb_get_selection_owner_reply(d->connection,
+            xcb_get_selection_owner_unchecked(d->connection, selection), nullptr));
+    if (!owner.isNull() && owner->owner != XCB_WINDOW_NONE) {
+        return;
+    }
+    xcb_set_selection_owner(d->connection, d->handle->winId(), selection, XCB_CURRENT_TIME);
+    xcb_flush(d->connection);
+}
+
 #if KWINDOWSYSTEM_BUILD_DEPRECATED_SINCE(5, 18)
 bool KXMessages::broadcastMessageX(Display *disp, const char *msg_type_P,
                                    const QString &message_P, int screen_P)
@@ -258,19 +624,392 @@ bool KXMessages::broadcastMessageX(xcb_connection_t *c, const char *msg_type_P,
     if (!c) {
         return false;
     }
-    const QByteArray msg(msg_type_P);
-    XcbAtom a2(c, msg);
-    XcbAtom a1(c, msg + QByteArrayLiteral("_BEGIN"));
+    // shares the handle window and atoms of a sender that is kept alive elsewhere,
+    // otherwise a temporary window is created just for this message
+    KXMessagesSender sender(c, screenNumber);
+    return sender.broadcastMessage(msg_type_P, message);
+}
+
+struct KXMessagesAtoms
+{
+    xcb_atom_t leading;
+    xcb_atom_t following;
+    xcb_atom_t notify;
+    xcb_atom_t propertyTransport; // the selection owned while all receivers understand it
+};
+
+struct KXMessagesPayloadSlot
+{
+    xcb_atom_t atom;
+    quint32 serial;
+    int pendingAcknowledgements;
+    QElapsedTimer published;
+};
+
+/**
+ * The resources shared by all senders for one connection and screen.
+ *
+ * Payload slots are only reused once all receivers that advertised the message type
+ * acknowledged them, or after a timeout for receivers which went away. When the
+ * session changes the advertisement, senders on the connection of the application
+ * learn about it through the PropertyNotify of the root window, others read it again
+ * before every message that could use the property transport.
+ */
+class KXMessagesSenderHandle
+    : public QAbstractNativeEventFilter
+{
+public:
+    KXMessagesSenderHandle(xcb_connection_t *c, int screenNumber, xcb_window_t root)
+        : connection(c)
+        , screenNumber(screenNumber)
+        , rootWindow(root)
+        , handle(xcb_generate_id(c))
+        , qtConnection(QCoreApplication::instance() && QX11Info::connection() == c)
+        , refCount(1)
+        , trackingAdvertisement(false)
+        , propertyAtomsFetched(false)
+        , propertyTransport(XCB_ATOM_NONE)
+        , acknowledge(XCB_ATOM_NONE)
+        , payloadType(XCB_ATOM_NONE)
+        , advertisementValid(false)
+        , nextSlot(0)
+        , serial(0)
+    {
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, handle, root, 0, 0, 1, 1,
+                          0, XCB_COPY_FROM_PARENT, XCB_COPY_FROM_PARENT, 0, nullptr);
+        // native events are only delivered to the main thread
+        if (qtConnection && QThread::currentThread() == QCoreApplication::instance()->thread()) {
+            QCoreApplication::instance()->installNativeEventFilter(this);
+            trackingAdvertisement = true;
+        }
+    }
+    ~KXMessagesSenderHandle() override
+    {
+        if (trackingAdvertisement && QCoreApplication::instance()) {
+            QCoreApplication::instance()->removeNativeEventFilter(this);
+        }
+        // the payloads go away together with the window, receivers which
+        // did not read them yet lose those messages
+        if (isConnectionAlive()) {
+            xcb_destroy_window(connection, handle);
+            xcb_flush(connection);
+        }
+    }
+
+    // Qt closes its connection together with the application, which senders in static
+    // storage can outlive. Foreign connections have to outlive their senders, as documented.
+    bool isConnectionAlive() const
+    {
+        if (!qtConnection) {
+            return true;
+        }
+        return QCoreApplication::instance() && QX11Info::connection() == connection;
+    }
+
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override
+    {
+        Q_UNUSED(result);
+        if (eventType[0] != 'x') {
+            return false;
+        }
+        xcb_generic_event_t *event = reinterpret_cast<xcb_generic_event_t *>(message);
+        if ((event->response_type & ~0x80) != XCB_PROPERTY_NOTIFY) {
+            return false;
+        }
+        xcb_property_notify_event_t *pe = reinterpret_cast<xcb_property_notify_event_t *>(event);
+        if (pe->window != rootWindow) {
+            return false;
+        }
+        QMutexLocker locker(&mutex);
+        if (propertyAtomsFetched && pe->atom == propertyTransport) {
+            advertisementValid = false;
+        }
+        return false;
+    }
+
+    // leading, following, property notify and property transport atoms for the given message type
+    KXMessagesAtoms atoms(const QByteArray &msg)
+    {
+        auto it = atomCache.constFind(msg);
+        if (it != atomCache.constEnd()) {
+            return it.value();
+        }
+        XcbAtom a1(connection, msg + QByteArrayLiteral("_BEGIN"));
+        XcbAtom a2(connection, msg);
+        XcbAtom a3(connection, msg + QByteArrayLiteral("_NOTIFY"));
+        XcbAtom a4(connection, msg + QByteArray(s_propertyTransportSuffix));
+        KXMessagesAtoms result;
+        result.leading = a1;
+        result.following = a2;
+        result.notify = a3;
+        result.propertyTransport = a4;
+        atomCache.insert(msg, result);
+        return result;
+    }
+
+    void fetchPropertyAtoms()
+    {
+        if (propertyAtomsFetched) {
+            return;
+        }
+        const QByteArray names[3] = {
+            QByteArray(s_propertyTransportAtom), QByteArray(s_acknowledgeAtom), QByteArray(s_payloadTypeAtom)
+        };
+        xcb_intern_atom_cookie_t cookies[s_payloadSlotCount + 3];
+        for (int i = 0; i < 3; ++i) {
+            cookies[i] = xcb_intern_atom_unchecked(connection, false, names[i].length(), names[i].constData());
+        }
+        for (int i = 0; i < s_payloadSlotCount; ++i) {
+            const QByteArray name = QByteArray(s_payloadSlotAtom) + QByteArray::number(i);
+            cookies[i + 3] = xcb_intern_atom_unchecked(connection, false, name.length(), name.constData());
+        }
+        xcb_atom_t atoms[s_payloadSlotCount + 3];
+        for (int i = 0; i < s_payloadSlotCount + 3; ++i) {
+            KXUtils::ScopedCPointer<xcb_intern_atom_reply_t> reply(xcb_intern_atom_reply(connection, cookies[i], nullptr));
+            atoms[i] = reply.isNull() ? XCB_ATOM_NONE : reply->atom;
+        }
+        propertyTransport = atoms[0];
+        acknowledge = atoms[1];
+        payloadType = atoms[2];
+        for (int i = 0; i < s_payloadSlotCount; ++i) {
+            KXMessagesPayloadSlot slot;
+            slot.atom = atoms[i + 3];
+            slot.serial = 0;
+            slot.pendingAcknowledgements = 0;
+            payloadSlots << slot;
+        }
+        propertyAtomsFetched = true;
+    }
+
+    // number of receivers that advertised the property transport for this message type
+    int advertisedReceivers(xcb_atom_t msgAtom)
+    {
+        if (!advertisementValid || !trackingAdvertisement) {
+            advertised.clear();
+            const xcb_get_property_cookie_t cookie = xcb_get_property_unchecked(connection, false, rootWindow,
+                    propertyTransport, XCB_ATOM_CARDINAL, 0, s_maxPropertyLength);
+            KXUtils::ScopedCPointer<xcb_get_property_reply_t> reply(xcb_get_property_reply(connection, cookie, nullptr));
+            if (!reply.isNull() && reply->format == 32 && reply->type == XCB_ATOM_CARDINAL) {
+                const quint32 *data = reinterpret_cast<const quint32 *>(xcb_get_property_value(reply.data()));
+                const int count = xcb_get_property_value_length(reply.data()) / sizeof(quint32);
+                for (int i = 0; i + 1 < count; i += 2) {
+                    ++advertised[data[i]];
+                }
+            }
+            advertisementValid = true;
+        }
+        return advertised.value(msgAtom);
+    }
+
+    // number of receivers that have to acknowledge the message if it is sent using
+    // the property transport, 0 if it has to be sent fragmented
+    int propertyReceivers(KXMessagesSender::Transport transport, const KXMessagesAtoms &atoms, int length)
+    {
+        if (transport != KXMessagesSender::AutoTransport
+                || length < (s_minimumPropertyFragments - 1) * 20) {
+            return 0;
+        }
+        // leave room for the request header and the serial number
+        if (length + 64 > int(xcb_get_maximum_request_length(connection) * 4)) {
+            return 0;
+        }
+        fetchPropertyAtoms();
+        if (propertyTransport == XCB_ATOM_NONE || acknowledge == XCB_ATOM_NONE
+                || payloadType == XCB_ATOM_NONE || atoms.propertyTransport == XCB_ATOM_NONE) {
+            return 0;
+        }
+        // receivers which did not advertise the transport, like those of older
+        // versions, only understand fragments, so the transport is only used
+        // while somebody vouches that there are none of them
+        const xcb_get_selection_owner_cookie_t ownerCookie = xcb_get_selection_owner_unchecked(connection, atoms.propertyTransport);
+        const int receivers = advertisedReceivers(atoms.following);
+        KXUtils::ScopedCPointer<xcb_get_selection_owner_reply_t> owner(xcb_get_selection_owner_reply(connection, ownerCookie, nullptr));
+        if (owner.isNull() || owner->owner == XCB_WINDOW_NONE) {
+            return 0;
+        }
+        return receivers;
+    }
+
+    int freeSlot() const
+    {
+        for (int i = 0; i < payloadSlots.count(); ++i) {
+            const int index = (nextSlot + i) % payloadSlots.count();
+            const KXMessagesPayloadSlot &slot = payloadSlots.at(index);
+            if (slot.pendingAcknowledgements <= 0 || slot.published.hasExpired(s_acknowledgeTimeout)) {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    // takes the acknowledgements the receivers appended to the handle window
+    void readAcknowledgements()
+    {
+        const xcb_get_property_cookie_t cookie = xcb_get_property_unchecked(connection, true, handle,
+                acknowledge, XCB_ATOM_CARDINAL, 0, s_maxPropertyLength);
+        KXUtils::ScopedCPointer<xcb_get_property_reply_t> reply(xcb_get_property_reply(connection, cookie, nullptr));
+        if (reply.isNull() || reply->format != 32 || reply->type != XCB_ATOM_CARDINAL) {
+            return;
+        }
+        const quint32 *data = reinterpret_cast<const quint32 *>(xcb_get_property_value(reply.data()));
+        const int count = xcb_get_property_value_length(reply.data()) / sizeof(quint32);
+        for (int i = 0; i + 1 < count; i += 2) {
+            for (KXMessagesPayloadSlot &slot : payloadSlots) {
+                if (slot.atom == data[i] && slot.serial == data[i + 1]) {
+                    --slot.pendingAcknowledgements;
+                    break;
+                }
+            }
+        }
+    }
+
+    // returns false if all slots still wait for acknowledgements
+    bool sendPropertyMessage(const KXMessagesAtoms &atoms, const QByteArray &msg, int length, int receivers)
+    {
+        int index = freeSlot();
+        if (index < 0) {
+            readAcknowledgements();
+            index = freeSlot();
+            if (index < 0) {
+                return false;
+            }
+        }
+        KXMessagesPayloadSlot &slot = payloadSlots[index];
+        nextSlot = (index + 1) % payloadSlots.count();
+        ++serial;
+        slot.serial = serial;
+        slot.pendingAcknowledgements = receivers;
+        slot.published.start();
+
+        // the payload is prefixed with the serial number, so that receivers can detect
+        // a slot that got reused after the acknowledgement timeout
+        QByteArray payload;
+        payload.reserve(length + 4);
+        for (int i = 0; i < 4; ++i) {
+            payload += char((serial >> (8 * i)) & 0xff);
+        }
+        payload.append(msg.constData(), length);
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, handle, slot.atom, payloadType,
+                            8, payload.size(), payload.constData());
+
+        xcb_client_message_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.response_type = XCB_CLIENT_MESSAGE;
+        event.format = 32;
+        event.window = handle;
+        event.type = atoms.notify;
+        event.data.data32[0] = slot.atom;
+        event.data.data32[1] = length;
+        event.data.data32[2] = serial;
+        xcb_send_event(connection, false, rootWindow, XCB_EVENT_MASK_PROPERTY_CHANGE, (const char *) &event);
+        xcb_flush(connection);
+        return true;
+    }
+
+    xcb_connection_t *connection;
+    int screenNumber;
+    xcb_window_t rootWindow;
+    xcb_window_t handle;
+    bool qtConnection;
+    int refCount; // guarded by the registry mutex
+    bool trackingAdvertisement;
+    QMutex mutex; // guards everything below
+    QHash<QByteArray, KXMessagesAtoms> atomCache;
+    bool propertyAtomsFetched;
+    xcb_atom_t propertyTransport;
+    xcb_atom_t acknowledge;
+    xcb_atom_t payloadType;
+    bool advertisementValid;
+    QHash<xcb_atom_t, int> advertised;
+    QVector<KXMessagesPayloadSlot> payloadSlots;
+    int nextSlot;
+    quint32 serial;
+};
+
+class KXMessagesSenderPrivate
+{
+public:
+    KXMessagesSenderHandle *handle = nullptr;
+    KXMessagesSender::Transport transport = KXMessagesSender::FragmentedTransport;
+};
+
+namespace
+{
+struct KXMessagesSenderRegistry
+{
+    QMutex mutex;
+    QHash<QPair<xcb_connection_t *, int>, KXMessagesSenderHandle *> senders;
+};
+}
+Q_GLOBAL_STATIC(KXMessagesSenderRegistry, s_senderRegistry)
+
+KXMessagesSender::KXMessagesSender(xcb_connection_t *c, int screenNumber)
+    : d(new KXMessagesSenderPrivate)
+{
+    if (!c) {
+        return;
+    }
+    KXMessagesSenderRegistry *registry = s_senderRegistry();
+    QMutexLocker locker(&registry->mutex);
+    const QPair<xcb_connection_t *, int> key(c, screenNumber);
+    d->handle = registry->senders.value(key);
+    if (d->handle) {
+        ++d->handle->refCount;
+        return;
+    }
     const xcb_screen_t *screen = defaultScreen(c, screenNumber);
     if (!screen) {
+        return;
+    }
+    d->handle = new KXMessagesSenderHandle(c, screenNumber, screen->root);
+    registry->senders.insert(key, d->handle);
+}
+
+KXMessagesSender::~KXMessagesSender()
+{
+    if (d->handle) {
+        KXMessagesSenderRegistry *registry = s_senderRegistry();
+        QMutexLocker locker(&registry->mutex);
+        if (--d->handle->refCount > 0) {
+            d->handle = nullptr;
+        } else {
+            registry->senders.remove(qMakePair(d->handle->connection, d->handle->screenNumber));
+        }
+    }
+    delete d->handle;
+    delete d;
+}
+
+bool KXMessagesSender::isValid() const
+{
+    return d->handle != nullptr;
+}
+
+void KXMessagesSender::setTransport(Transport transport)
+{
+    d->transport = transport;
+}
+
+KXMessagesSender::Transport KXMessagesSender::transport() const
+{
+    return d->transport;
+}
+
+bool KXMessagesSender::broadcastMessage(const char *msg_type, const QString &message)
+{
+    if (!d->handle) {
         return false;
     }
-    const xcb_window_t root = screen->root;
-    const xcb_window_t win = xcb_generate_id(c);
-    xcb_create_window(c, XCB_COPY_FROM_PARENT, win, root, 0, 0, 1, 1,
-                      0, XCB_COPY_FROM_PARENT, XCB_COPY_FROM_PARENT, 0, nullptr);
-    send_message_internal(root, message, c, a1, a2, win);
-    xcb_destroy_window(c, win);
+    KXMessagesSenderHandle *handle = d->handle;
+    QMutexLocker locker(&handle->mutex);
+    const KXMessagesAtoms atoms = handle->atoms(QByteArray(msg_type));
+    const QByteArray msg = message.toUtf8();
+    const int length = strlen(msg.constData());
+    const int receivers = handle->propertyReceivers(d->transport, atoms, length);
+    // falls back to fragments when all payload slots are still being read
+    if (receivers == 0 || !handle->sendPropertyMessage(atoms, msg, length, receivers)) {
+        send_message_internal(handle->rootWindow, msg, handle->connection, atoms.leading, atoms.following, handle->handle);
+    }
     return true;
 }
 
@@ -328,11 +1067,10 @@ static void send_message_internal(WId w_P, const QString &msg_P, long mask_P,
 }
 #endif
 
-static void send_message_internal(xcb_window_t w, const QString &msg_P, xcb_connection_t *c,
+static void send_message_internal(xcb_window_t w, const QByteArray &msg, xcb_connection_t *c,
                                   xcb_atom_t leadingMessage, xcb_atom_t followingMessage, xcb_window_t handle)
 {
     unsigned int pos = 0;
-    QByteArray msg = msg_P.toUtf8();
     const size_t len = strlen(msg.constData());
 
     xcb_client_message_event_t event;
@@ -37,6 +37,7 @@ typedef struct _XDisplay Display;
 class QString;
 
 class KXMessagesPrivate;
+class KXMessagesSenderPrivate;
 
 /**
  * Sending string messages to other applications using the X Client Messages.
@@ -112,6 +113,36 @@ public:
     static bool broadcastMessageX(xcb_connection_t *c, const char *msg_type,
                                   const QString &message, int screenNumber);
 
+    /**
+     * Announces that this receiver understands the property transport of
+     * KXMessagesSender for its message type, by adding it to the
+     * _KDE_KXMESSAGES_PROPERTY_TRANSPORT property of the root window. The
+     * entry is removed again when the receiver is destroyed.
+     *
+     * Once the property transport is claimed for the message type, see
+     * claimPropertyTransport(), senders using KXMessagesSender::AutoTransport
+     * publish larger messages of this type in a property, and keep it until
+     * all advertised receivers read it.
+     *
+     * Does nothing if the receiver was created without a message type.
+     * @since 5.65
+     */
+    void advertisePropertyTransport();
+
+    /**
+     * Declares that all receivers of this message type in the session
+     * understand the property transport, by owning the
+     * @c \<msg_type\>_PROPERTY_TRANSPORT selection while this receiver exists.
+     * Senders keep sending fragments as long as nobody owns it, so receivers
+     * of older versions still get every message.
+     *
+     * Only the component that knows which receivers of the message type run
+     * in the session should call this. Does nothing if the selection is owned
+     * already or the receiver was created without a message type.
+     * @since 5.65
+     */
+    void claimPropertyTransport();
+
 #if 0 // currently unused
     /**
      * Sends the given message with the given message type only to given
@@ -143,10 +174,103 @@ Q_SIGNALS:
      * @param message the message that has been received
      */
     void gotMessage(const QString &message);
+
+    /**
+     * Emitted when a message was received, with the UTF-8 encoded message
+     * as sent. Receivers that only need the bytes can use this to avoid
+     * the conversion to QString.
+     * @param message the message that has been received
+     * @since 5.65
+     */
+    void gotRawMessage(const QByteArray &message);
 private:
     friend class KXMessagesPrivate;
     KXMessagesPrivate *const d;
 };
 
+/**
+ * Reusable handle for broadcasting X messages on one connection and screen.
+ *
+ * A sender owns a single handle window and caches the interned message atoms.
+ * All senders created for the same connection and screen share these resources,
+ * which are released when the last of them is destroyed. While at least one
+ * sender exists, KXMessages::broadcastMessageX() and the KStartupInfo::send*Xcb()
+ * functions reuse it instead of creating and destroying a window for every message,
+ * so applications emitting many messages should keep one alive for their session.
+ *
+ * When the last sender is destroyed, the payloads it published using
+ * AutoTransport are destroyed with its handle window right away. Receivers which
+ * did not read them by then lose those messages. Senders using the connection of
+ * the application may outlive it. When another connection is passed, all senders
+ * for it have to be destroyed before it is closed.
+ *
+ * @since 5.65
+ */
+class KWINDOWSYSTEM_EXPORT KXMessagesSender
+{
+public:
+    /**
+     * How messages are transported to the receivers.
+     */
+    enum Transport {
+        /**
+         * Split messages into 20 byte client message fragments. This is the
+         * default and is understood by all receivers.
+         */
+        FragmentedTransport,
+        /**
+         * Publish larger messages in a property of the handle window and send
+         * a single notify client message, if receivers advertised this for the
+         * message type with KXMessages::advertisePropertyTransport() and it was
+         * claimed with KXMessages::claimPropertyTransport(). Messages are sent
+         * fragmented otherwise, and also while all payload properties wait for
+         * receivers to read them.
+         */
+        AutoTransport
+    };
+
+    /**
+     * Creates a sender for the given screen of connection @p c, or shares the
+     * resources of an already existing one.
+     *
+     * @param c X11 connection used for sending
+     * @param screenNumber X11 screen to broadcast on
+     */
+    KXMessagesSender(xcb_connection_t *c, int screenNumber);
+    ~KXMessagesSender();
+
+    /**
+     * @return whether the sender could be set up for its connection and screen
+     */
+    bool isValid() const;
+
+    /**
+     * Sets how messages sent through this object are transported. Other senders
+     * for the same connection and screen are not affected.
+     * Short messages are always sent fragmented, as that is cheaper for them.
+     *
+     * @see Transport
+     */
+    void setTransport(Transport transport);
+
+    /**
+     * @return the transport used for larger messages
+     */
+    Transport transport() const;
+
+    /**
+     * Broadcasts the given message with the given message type.
+     *
+     * @param msg_type the type of the message
+     * @param message the message itself
+     * @return false when an error occurred, true otherwise
+     */
+    bool broadcastMessage(const char *msg_type, const QString &message);
+
+private:
+    Q_DISABLE_COPY(KXMessagesSender)
+    KXMessagesSenderPrivate *d;
+};
+
 #endif
 #endif
@@ -0,0 +1,449 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kxpixelconversion_p.h"
+
+#include <QRgb>
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KXPIXELS_HAVE_AVX2 1
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace KXUtils
+{
+
+// Portable implementations, also used for the pixels left over by the vectorized ones
+
+static inline uint32_t depth30ToArgb32(uint32_t p)
+{
+    // red, green and blue are the upper 8 bits of the 10 bit channels
+    return 0xff000000 | ((p >> 6) & 0x00ff0000) | ((p >> 4) & 0x0000ff00) | ((p >> 2) & 0x000000ff);
+}
+
+static void convertDepth30ToArgb32Scalar(uint32_t *pixels, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        pixels[i] = depth30ToArgb32(pixels[i]);
+    }
+}
+
+static void premultiplyScalar(const uint32_t *src, uint32_t *dst, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = qPremultiply(src[i]);
+    }
+}
+
+static void unpremultiplyScalar(const uint32_t *src, uint32_t *dst, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = qUnpremultiply(src[i]);
+    }
+}
+
+static void setOpaqueScalar(const uint32_t *src, uint32_t *dst, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = src[i] | 0xff000000;
+    }
+}
+
+static const PixelKernels s_scalarKernels = {
+    "Scalar",
+    convertDepth30ToArgb32Scalar,
+    premultiplyScalar,
+    unpremultiplyScalar,
+    setOpaqueScalar
+};
+
+/*
+ * The vectorized premultiply works on 16 bit lanes: red and blue of a pixel
+ * share one 32 bit lane, green gets one of its own. Every lane is multiplied
+ * with alpha and rounded like qPremultiply() does, which gives the same
+ * results bit for bit.
+ *
+ * The vectorized unpremultiply uses the factor 0xff0000 / alpha and the rounding
+ * of qUnpremultiply(), which gives the same results bit for bit. The factor is
+ * divided in single precision floats: the numerator is exact and the rounding
+ * error of the quotient is less than 1/alpha, the least distance of a non
+ * integral quotient to the next integer, so truncating it gives the same result
+ * as the integer division.
+ */
+
+#if defined(__SSE2__)
+static void convertDepth30ToArgb32SSE2(uint32_t *pixels, int count)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i redMask = _mm_set1_epi32(0x00ff0000);
+    const __m128i greenMask = _mm_set1_epi32(0x0000ff00);
+    const __m128i blueMask = _mm_set1_epi32(0x000000ff);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+        __m128i result = _mm_or_si128(alpha, _mm_and_si128(_mm_srli_epi32(p, 6), redMask));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_srli_epi32(p, 4), greenMask));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_srli_epi32(p, 2), blueMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), result);
+    }
+    convertDepth30ToArgb32Scalar(pixels + i, count - i);
+}
+
+static void premultiplySSE2(const uint32_t *src, uint32_t *dst, int count)
+{
+    const __m128i redBlueMask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i byteMask = _mm_set1_epi32(0x000000ff);
+    const __m128i half = _mm_set1_epi16(0x80);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i a = _mm_srli_epi32(p, 24);
+        const __m128i alpha16 = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+        __m128i rb = _mm_mullo_epi16(_mm_and_si128(p, redBlueMask), alpha16);
+        rb = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(rb, _mm_srli_epi16(rb, 8)), half), 8);
+
+        __m128i g = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(p, 8), byteMask), alpha16);
+        g = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(g, _mm_srli_epi16(g, 8)), half), 8);
+        g = _mm_and_si128(g, byteMask);
+
+        const __m128i result = _mm_or_si128(_mm_or_si128(rb, _mm_slli_epi32(g, 8)), _mm_slli_epi32(a, 24));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), result);
+    }
+    premultiplyScalar(src + i, dst + i, count - i);
+}
+
+static inline __m128i multiplySSE2(__m128i a, __m128i b)
+{
+    // SSE2 only multiplies the even 32 bit lanes
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i unpremultipliedChannelSSE2(__m128i p, int shift, __m128i inverseAlpha)
+{
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+    const __m128i c = _mm_and_si128(_mm_srli_epi32(p, shift), byteMask);
+    const __m128i q = _mm_srli_epi32(_mm_add_epi32(multiplySSE2(c, inverseAlpha), _mm_set1_epi32(0x8000)), 16);
+    // invalid premultiplied input exceeds 255, cut like qRgba() does
+    return _mm_and_si128(q, byteMask);
+}
+
+static void unpremultiplySSE2(const uint32_t *src, uint32_t *dst, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i a = _mm_srli_epi32(p, 24);
+        const __m128i inverseAlpha = _mm_cvttps_epi32(_mm_div_ps(_mm_set1_ps(float(0xff0000)), _mm_cvtepi32_ps(a)));
+
+        __m128i result = _mm_slli_epi32(a, 24);
+        result = _mm_or_si128(result, _mm_slli_epi32(unpremultipliedChannelSSE2(p, 16, inverseAlpha), 16));
+        result = _mm_or_si128(result, _mm_slli_epi32(unpremultipliedChannelSSE2(p, 8, inverseAlpha), 8));
+        result = _mm_or_si128(result, unpremultipliedChannelSSE2(p, 0, inverseAlpha));
+        // fully transparent pixels divided by zero
+        result = _mm_andnot_si128(_mm_cmpeq_epi32(a, zero), result);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), result);
+    }
+    unpremultiplyScalar(src + i, dst + i, count - i);
+}
+
+static void setOpaqueSSE2(const uint32_t *src, uint32_t *dst, int count)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(p, alpha));
+    }
+    setOpaqueScalar(src + i, dst + i, count - i);
+}
+
+static const PixelKernels s_sse2Kernels = {
+    "SSE2",
+    convertDepth30ToArgb32SSE2,
+    premultiplySSE2,
+    unpremultiplySSE2,
+    setOpaqueSSE2
+};
+#endif
+
+#if KXPIXELS_HAVE_AVX2
+#define KXPIXELS_AVX2 __attribute__((target("avx2")))
+
+KXPIXELS_AVX2 static void convertDepth30ToArgb32AVX2(uint32_t *pixels, int count)
+{
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    const __m256i redMask = _mm256_set1_epi32(0x00ff0000);
+    const __m256i greenMask = _mm256_set1_epi32(0x0000ff00);
+    const __m256i blueMask = _mm256_set1_epi32(0x000000ff);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i));
+        __m256i result = _mm256_or_si256(alpha, _mm256_and_si256(_mm256_srli_epi32(p, 6), redMask));
+        result = _mm256_or_si256(result, _mm256_and_si256(_mm256_srli_epi32(p, 4), greenMask));
+        result = _mm256_or_si256(result, _mm256_and_si256(_mm256_srli_epi32(p, 2), blueMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i), result);
+    }
+    convertDepth30ToArgb32Scalar(pixels + i, count - i);
+}
+
+KXPIXELS_AVX2 static void premultiplyAVX2(const uint32_t *src, uint32_t *dst, int count)
+{
+    const __m256i redBlueMask = _mm256_set1_epi32(0x00ff00ff);
+    const __m256i byteMask = _mm256_set1_epi32(0x000000ff);
+    const __m256i half = _mm256_set1_epi16(0x80);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        const __m256i a = _mm256_srli_epi32(p, 24);
+        const __m256i alpha16 = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+
+        __m256i rb = _mm256_mullo_epi16(_mm256_and_si256(p, redBlueMask), alpha16);
+        rb = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(rb, _mm256_srli_epi16(rb, 8)), half), 8);
+
+        __m256i g = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(p, 8), byteMask), alpha16);
+        g = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(g, _mm256_srli_epi16(g, 8)), half), 8);
+        g = _mm256_and_si256(g, byteMask);
+
+        const __m256i result = _mm256_or_si256(_mm256_or_si256(rb, _mm256_slli_epi32(g, 8)), _mm256_slli_epi32(a, 24));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), result);
+    }
+    premultiplyScalar(src + i, dst + i, count - i);
+}
+
+KXPIXELS_AVX2 static inline __m256i unpremultipliedChannelAVX2(__m256i p, int shift, __m256i inverseAlpha)
+{
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256i c = _mm256_and_si256(_mm256_srli_epi32(p, shift), byteMask);
+    const __m256i q = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(c, inverseAlpha), _mm256_set1_epi32(0x8000)), 16);
+    // invalid premultiplied input exceeds 255, cut like qRgba() does
+    return _mm256_and_si256(q, byteMask);
+}
+
+KXPIXELS_AVX2 static void unpremultiplyAVX2(const uint32_t *src, uint32_t *dst, int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        const __m256i a = _mm256_srli_epi32(p, 24);
+        const __m256i inverseAlpha = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_set1_ps(float(0xff0000)), _mm256_cvtepi32_ps(a)));
+
+        __m256i result = _mm256_slli_epi32(a, 24);
+        result = _mm256_or_si256(result, _mm256_slli_epi32(unpremultipliedChannelAVX2(p, 16, inverseAlpha), 16));
+        result = _mm256_or_si256(result, _mm256_slli_epi32(unpremultipliedChannelAVX2(p, 8, inverseAlpha), 8));
+        result = _mm256_or_si256(result, unpremultipliedChannelAVX2(p, 0, inverseAlpha));
+        // fully transparent pixels divided by zero
+        result = _mm256_andnot_si256(_mm256_cmpeq_epi32(a, zero), result);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), result);
+    }
+    unpremultiplyScalar(src + i, dst + i, count - i);
+}
+
+KXPIXELS_AVX2 static void setOpaqueAVX2(const uint32_t *src, uint32_t *dst, int count)
+{
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(p, alpha));
+    }
+    setOpaqueScalar(src + i, dst + i, count - i);
+}
+
+static const PixelKernels s_avx2Kernels = {
+    "AVX2",
+    convertDepth30ToArgb32AVX2,
+    premultiplyAVX2,
+    unpremultiplyAVX2,
+    setOpaqueAVX2
+};
+
+static bool cpuHasAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#if defined(__ARM_NEON)
+static void convertDepth30ToArgb32NEON(uint32_t *pixels, int count)
+{
+    const uint32x4_t alpha = vdupq_n_u32(0xff000000);
+    const uint32x4_t redMask = vdupq_n_u32(0x00ff0000);
+    const uint32x4_t greenMask = vdupq_n_u32(0x0000ff00);
+    const uint32x4_t blueMask = vdupq_n_u32(0x000000ff);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t p = vld1q_u32(pixels + i);
+        uint32x4_t result = vorrq_u32(alpha, vandq_u32(vshrq_n_u32(p, 6), redMask));
+        result = vorrq_u32(result, vandq_u32(vshrq_n_u32(p, 4), greenMask));
+        result = vorrq_u32(result, vandq_u32(vshrq_n_u32(p, 2), blueMask));
+        vst1q_u32(pixels + i, result);
+    }
+    convertDepth30ToArgb32Scalar(pixels + i, count - i);
+}
+
+static void premultiplyNEON(const uint32_t *src, uint32_t *dst, int count)
+{
+    const uint32x4_t redBlueMask = vdupq_n_u32(0x00ff00ff);
+    const uint32x4_t byteMask = vdupq_n_u32(0x000000ff);
+    const uint16x8_t half = vdupq_n_u16(0x80);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t p = vld1q_u32(src + i);
+        const uint32x4_t a = vshrq_n_u32(p, 24);
+        const uint16x8_t alpha16 = vreinterpretq_u16_u32(vorrq_u32(a, vshlq_n_u32(a, 16)));
+
+        uint16x8_t rb = vmulq_u16(vreinterpretq_u16_u32(vandq_u32(p, redBlueMask)), alpha16);
+        rb = vshrq_n_u16(vaddq_u16(vaddq_u16(rb, vshrq_n_u16(rb, 8)), half), 8);
+
+        uint16x8_t g = vmulq_u16(vreinterpretq_u16_u32(vandq_u32(vshrq_n_u32(p, 8), byteMask)), alpha16);
+        g = vshrq_n_u16(vaddq_u16(vaddq_u16(g, vshrq_n_u16(g, 8)), half), 8);
+        const uint32x4_t g32 = vandq_u32(vreinterpretq_u32_u16(g), byteMask);
+
+        const uint32x4_t result = vorrq_u32(vorrq_u32(vreinterpretq_u32_u16(rb), vshlq_n_u32(g32, 8)), vshlq_n_u32(a, 24));
+        vst1q_u32(dst + i, result);
+    }
+    premultiplyScalar(src + i, dst + i, count - i);
+}
+
+#if defined(__aarch64__)
+// ARMv7 NEON has no division, it uses the portable unpremultiply
+static inline uint32x4_t unpremultipliedChannelNEON(uint32x4_t c, uint32x4_t inverseAlpha)
+{
+    const uint32x4_t q = vshrq_n_u32(vaddq_u32(vmulq_u32(c, inverseAlpha), vdupq_n_u32(0x8000)), 16);
+    // invalid premultiplied input exceeds 255, cut like qRgba() does
+    return vandq_u32(q, vdupq_n_u32(0xff));
+}
+
+static void unpremultiplyNEON(const uint32_t *src, uint32_t *dst, int count)
+{
+    const uint32x4_t byteMask = vdupq_n_u32(0x000000ff);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t p = vld1q_u32(src + i);
+        const uint32x4_t a = vshrq_n_u32(p, 24);
+        const uint32x4_t inverseAlpha = vcvtq_u32_f32(vdivq_f32(vdupq_n_f32(float(0xff0000)), vcvtq_f32_u32(a)));
+
+        uint32x4_t result = vshlq_n_u32(a, 24);
+        result = vorrq_u32(result, vshlq_n_u32(unpremultipliedChannelNEON(vandq_u32(vshrq_n_u32(p, 16), byteMask), inverseAlpha), 16));
+        result = vorrq_u32(result, vshlq_n_u32(unpremultipliedChannelNEON(vandq_u32(vshrq_n_u32(p, 8), byteMask), inverseAlpha), 8));
+        result = vorrq_u32(result, unpremultipliedChannelNEON(vandq_u32(p, byteMask), inverseAlpha));
+        // fully transparent pixels divided by zero
+        result = vbicq_u32(result, vceqq_u32(a, vdupq_n_u32(0)));
+        vst1q_u32(dst + i, result);
+    }
+    unpremultiplyScalar(src + i, dst + i, count - i);
+}
+#endif
+
+static void setOpaqueNEON(const uint32_t *src, uint32_t *dst, int count)
+{
+    const uint32x4_t alpha = vdupq_n_u32(0xff000000);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(dst + i, vorrq_u32(vld1q_u32(src + i), alpha));
+    }
+    setOpaqueScalar(src + i, dst + i, count - i);
+}
+
+static const PixelKernels s_neonKernels = {
+    "NEON",
+    convertDepth30ToArgb32NEON,
+    premultiplyNEON,
+#if defined(__aarch64__)
+    unpremultiplyNEON,
+#else
+    unpremultiplyScalar,
+#endif
+    setOpaqueNEON
+};
+#endif
+
+QVector<const PixelKernels *> supportedPixelKernels()
+{
+    QVector<const PixelKernels *> kernels;
+    kernels << &s_scalarKernels;
+#if defined(__SSE2__)
+    kernels << &s_sse2Kernels;
+#endif
+#if KXPIXELS_HAVE_AVX2
+    if (cpuHasAVX2()) {
+        kernels << &s_avx2Kernels;
+    }
+#endif
+#if defined(__ARM_NEON)
+    kernels << &s_neonKernels;
+#endif
+    return kernels;
+}
+
+const PixelKernels &pixelKernels()
+{
+    // the best ones are last
+    static const PixelKernels *const s_kernels = supportedPixelKernels().last();
+    return *s_kernels;
+}
+
+void writeNetWmIcon(const QImage &image, uint32_t *out)
+{
+    const int width = image.width();
+    const int height = image.height();
+    *out++ = width;
+    *out++ = height;
+
+    const PixelKernels &kernels = pixelKernels();
+    switch (image.format()) {
+    case QImage::Format_ARGB32:
+        for (int y = 0; y < height; ++y, out += width) {
+            memcpy(out, image.constScanLine(y), width * sizeof(uint32_t));
+        }
+        break;
+    case QImage::Format_ARGB32_Premultiplied:
+        for (int y = 0; y < height; ++y, out += width) {
+            kernels.unpremultiply(reinterpret_cast<const uint32_t *>(image.constScanLine(y)), out, width);
+        }
+        break;
+    case QImage::Format_RGB32:
+        for (int y = 0; y < height; ++y, out += width) {
+            kernels.setOpaque(reinterpret_cast<const uint32_t *>(image.constScanLine(y)), out, width);
+        }
+        break;
+    default: {
+        const QImage converted = image.convertToFormat(QImage::Format_ARGB32);
+        for (int y = 0; y < height; ++y, out += width) {
+            memcpy(out, converted.constScanLine(y), width * sizeof(uint32_t));
+        }
+        break;
+    }
+    }
+}
+
+} // namespace
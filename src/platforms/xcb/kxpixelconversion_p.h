@@ -0,0 +1,74 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KXPIXELCONVERSION_P_H
+#define KXPIXELCONVERSION_P_H
+
+#include <QImage>
+#include <QVector>
+
+#include <stdint.h>
+
+namespace KXUtils
+{
+
+/**
+ * Conversion routines between the pixel formats used by X11 and Qt.
+ *
+ * All routines work on @p count pixels of 32 bit each. Source and
+ * destination may be the same buffer.
+ */
+struct PixelKernels {
+    /// Name of the instruction set, e.g. "SSE2"
+    const char *name;
+    /// Converts depth 30 pixels (2:10:10:10) in place to opaque ARGB32
+    void (*convertDepth30ToArgb32)(uint32_t *pixels, int count);
+    /// Converts ARGB32 to ARGB32_Premultiplied, with the same rounding as qPremultiply()
+    void (*premultiply)(const uint32_t *src, uint32_t *dst, int count);
+    /// Converts ARGB32_Premultiplied to ARGB32, with the same rounding as qUnpremultiply()
+    void (*unpremultiply)(const uint32_t *src, uint32_t *dst, int count);
+    /// Converts RGB32 to ARGB32 by setting the alpha channel to 0xff
+    void (*setOpaque)(const uint32_t *src, uint32_t *dst, int count);
+};
+
+/**
+ * @return the fastest kernels supported by the CPU, chosen once at first use
+ */
+const PixelKernels &pixelKernels();
+
+/**
+ * @return all kernels supported by the CPU, the portable implementation first
+ */
+QVector<const PixelKernels *> supportedPixelKernels();
+
+/**
+ * @return the number of CARDINALs needed for @p image in a _NET_WM_ICON property
+ */
+inline int netWmIconLength(const QImage &image)
+{
+    return 2 + image.width() * image.height();
+}
+
+/**
+ * Writes @p image in the _NET_WM_ICON layout (width, height, non premultiplied
+ * ARGB32 pixels) to @p out, which has to hold netWmIconLength() values.
+ */
+void writeNetWmIcon(const QImage &image, uint32_t *out);
+
+} // namespace
+
+#endif
@@ -18,33 +18,113 @@
 */
 
 #include "kxutils_p.h"
+#include "kxpixelconversion_p.h"
 #include "kwindowsystem_xcb_debug.h"
 #include <qbitmap.h>
+#include <QMutex>
+#include <QSet>
 #include <QX11Info>
 
 #include <xcb/xcb.h>
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+#include <xcb/shm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
 
 namespace KXUtils
 {
 
-template <typename T> T fromNative(xcb_pixmap_t pixmap, xcb_connection_t *c)
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+// Smaller images are cheaper to read through the socket than to set up
+// and tear down a shared memory segment for
+static const int s_minShmImageSize = 64 * 1024;
+
+namespace {
+// Connections which announce MIT-SHM but can't use it, e.g. remote displays,
+// and those where attaching a segment is known to work
+struct ShmBlacklist {
+    QMutex mutex;
+    QSet<xcb_connection_t *> connections;
+    QSet<xcb_connection_t *> attachVerified;
+};
+}
+Q_GLOBAL_STATIC(ShmBlacklist, s_shmBlacklist)
+
+static bool shmUsable(xcb_connection_t *c)
 {
-    const xcb_get_geometry_cookie_t geoCookie = xcb_get_geometry_unchecked(c,  pixmap);
-    ScopedCPointer<xcb_get_geometry_reply_t> geo(xcb_get_geometry_reply(c, geoCookie, nullptr));
-    if (geo.isNull()) {
-        // getting geometry for the pixmap failed
-        return T();
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(c, &xcb_shm_id);
+    if (!extension || !extension->present) {
+        return false;
     }
+    ShmBlacklist *blacklist = s_shmBlacklist();
+    if (!blacklist) {
+        return false;
+    }
+    QMutexLocker locker(&blacklist->mutex);
+    return !blacklist->connections.contains(c);
+}
 
-    const xcb_get_image_cookie_t imageCookie = xcb_get_image_unchecked(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap,
-            0, 0, geo->width, geo->height, ~0);
-    ScopedCPointer<xcb_get_image_reply_t> xImage(xcb_get_image_reply(c, imageCookie, nullptr));
-    if (xImage.isNull()) {
-        // request for image data failed
-        return T();
+static void setShmUnusable(xcb_connection_t *c)
+{
+    if (ShmBlacklist *blacklist = s_shmBlacklist()) {
+        QMutexLocker locker(&blacklist->mutex);
+        blacklist->connections.insert(c);
     }
+}
+
+// Attaches the segment @p shmId as @p segment. The first attach on a connection
+// is checked, so that a failure doesn't end up as an error in the event queue.
+static bool attachShm(xcb_connection_t *c, xcb_shm_seg_t segment, int shmId)
+{
+    ShmBlacklist *blacklist = s_shmBlacklist();
+    if (!blacklist) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&blacklist->mutex);
+        if (blacklist->attachVerified.contains(c)) {
+            locker.unlock();
+            xcb_shm_attach(c, segment, shmId, false);
+            return true;
+        }
+    }
+    xcb_generic_error_t *error = xcb_request_check(c, xcb_shm_attach_checked(c, segment, shmId, false));
+    QMutexLocker locker(&blacklist->mutex);
+    if (error) {
+        free(error);
+        blacklist->connections.insert(c);
+        return false;
+    }
+    blacklist->attachVerified.insert(c);
+    return true;
+}
+
+static void detachShm(void *address)
+{
+    shmdt(address);
+}
+
+// Bytes per line of a ZPixmap image with the given depth, 0 if the depth is unknown
+static int zPixmapBytesPerLine(xcb_connection_t *c, uint8_t depth, uint16_t width)
+{
+    const xcb_setup_t *setup = xcb_get_setup(c);
+    for (xcb_format_iterator_t it = xcb_setup_pixmap_formats_iterator(setup); it.rem; xcb_format_next(&it)) {
+        if (it.data->depth == depth) {
+            const int pad = it.data->scanline_pad;
+            return ((width * it.data->bits_per_pixel + pad - 1) / pad) * pad / 8;
+        }
+    }
+    return 0;
+}
+#endif
+
+// Wraps image data in a QImage which calls cleanup once it's done with the data
+static QImage imageFromData(uchar *data, uint16_t width, uint16_t height, int bytesPerLine, uint8_t depth,
+                            QImageCleanupFunction cleanup, void *cleanupInfo)
+{
     QImage::Format format = QImage::Format_Invalid;
-    switch (xImage->depth) {
+    switch (depth) {
     case 1:
         format = QImage::Format_MonoLSB;
         break;
@@ -56,14 +136,7 @@ template <typename T> T fromNative(xcb_pixmap_t pixmap, xcb_connection_t *c)
         break;
     case 30: {
         // Qt doesn't have a matching image format. We need to convert manually
-        uint32_t *pixels = reinterpret_cast<uint32_t *>(xcb_get_image_data(xImage.data()));
-        for (uint i = 0; i < xImage.data()->length; ++i) {
-            int r = (pixels[i] >> 22) & 0xff;
-            int g = (pixels[i] >> 12) & 0xff;
-            int b = (pixels[i] >>  2) & 0xff;
-
-            pixels[i] = qRgba(r, g, b, 0xff);
-        }
+        pixelKernels().convertDepth30ToArgb32(reinterpret_cast<uint32_t *>(data), bytesPerLine / 4 * height);
         // fall through, Qt format is still Format_ARGB32_Premultiplied
         Q_FALLTHROUGH();
     }
@@ -71,13 +144,12 @@ template <typename T> T fromNative(xcb_pixmap_t pixmap, xcb_connection_t *c)
         format = QImage::Format_ARGB32_Premultiplied;
         break;
     default:
-        return T(); // we don't know
+        cleanup(cleanupInfo);
+        return QImage(); // we don't know
     }
-    QImage image(xcb_get_image_data(xImage.data()), geo->width, geo->height,
-                 xcb_get_image_data_length(xImage.data()) / geo->height, format, free, xImage.data());
-    xImage.take();
+    QImage image(data, width, height, bytesPerLine, format, cleanup, cleanupInfo);
     if (image.isNull()) {
-        return T();
+        return QImage();
     }
     if (image.format() == QImage::Format_MonoLSB) {
         // work around an abort in QImage::color
@@ -85,6 +157,199 @@ template <typename T> T fromNative(xcb_pixmap_t pixmap, xcb_connection_t *c)
         image.setColor(0, QColor(Qt::white).rgb());
         image.setColor(1, QColor(Qt::black).rgb());
     }
+    return image;
+}
+
+/**
+ * Reads the contents of an X pixmap. The work is split into steps, so that
+ * the requests for several pixmaps can be in flight together: the constructor
+ * asks for the geometry, fetch() asks for the image data and image() waits
+ * for it.
+ *
+ * If the server supports MIT-SHM the image is read into a shared memory
+ * segment instead of being streamed through the socket.
+ */
+class PixmapReader
+{
+public:
+    PixmapReader(xcb_connection_t *c, xcb_pixmap_t pixmap)
+        : m_connection(c)
+        , m_pixmap(pixmap)
+        , m_geometryCookie(xcb_get_geometry_unchecked(c, pixmap))
+    {
+    }
+    ~PixmapReader();
+
+    void fetch();
+    QImage image();
+
+private:
+    void fetchThroughSocket();
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+    bool fetchThroughShm();
+    void releaseShm();
+#endif
+
+    enum State {
+        WaitingForGeometry,
+        WaitingForImage,
+        WaitingForShmImage,
+        Done
+    };
+    xcb_connection_t *m_connection;
+    xcb_pixmap_t m_pixmap;
+    State m_state = WaitingForGeometry;
+    xcb_get_geometry_cookie_t m_geometryCookie;
+    uint16_t m_width = 0;
+    uint16_t m_height = 0;
+    xcb_get_image_cookie_t m_imageCookie;
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+    xcb_shm_get_image_cookie_t m_shmImageCookie;
+    xcb_shm_seg_t m_shmSegment = XCB_NONE;
+    int m_shmId = -1;
+    void *m_shmAddress = nullptr;
+    int m_shmBytesPerLine = 0;
+#endif
+};
+
+PixmapReader::~PixmapReader()
+{
+    switch (m_state) {
+    case WaitingForGeometry:
+        xcb_discard_reply(m_connection, m_geometryCookie.sequence);
+        break;
+    case WaitingForImage:
+        xcb_discard_reply(m_connection, m_imageCookie.sequence);
+        break;
+    case WaitingForShmImage:
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+        // the server has to be done with the segment before it can go away
+        free(xcb_shm_get_image_reply(m_connection, m_shmImageCookie, nullptr));
+        releaseShm();
+        shmdt(m_shmAddress);
+#endif
+        break;
+    case Done:
+        break;
+    }
+}
+
+void PixmapReader::fetch()
+{
+    ScopedCPointer<xcb_get_geometry_reply_t> geo(xcb_get_geometry_reply(m_connection, m_geometryCookie, nullptr));
+    m_state = Done;
+    if (geo.isNull() || geo->width == 0 || geo->height == 0) {
+        // getting geometry for the pixmap failed
+        return;
+    }
+    m_width = geo->width;
+    m_height = geo->height;
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+    m_shmBytesPerLine = zPixmapBytesPerLine(m_connection, geo->depth, m_width);
+    if (fetchThroughShm()) {
+        return;
+    }
+#endif
+    fetchThroughSocket();
+}
+
+void PixmapReader::fetchThroughSocket()
+{
+    m_imageCookie = xcb_get_image_unchecked(m_connection, XCB_IMAGE_FORMAT_Z_PIXMAP, m_pixmap,
+                                            0, 0, m_width, m_height, ~0);
+    m_state = WaitingForImage;
+}
+
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+bool PixmapReader::fetchThroughShm()
+{
+    if (m_shmBytesPerLine == 0 || m_shmBytesPerLine * m_height < s_minShmImageSize || !shmUsable(m_connection)) {
+        return false;
+    }
+    m_shmId = shmget(IPC_PRIVATE, size_t(m_shmBytesPerLine) * m_height, IPC_CREAT | 0600);
+    if (m_shmId < 0) {
+        qCDebug(LOG_KKEYSERVER_X11) << "Creating a shared memory segment failed, falling back to reading images through the socket";
+        return false;
+    }
+    m_shmAddress = shmat(m_shmId, nullptr, 0);
+    if (m_shmAddress == reinterpret_cast<void *>(-1)) {
+        qCDebug(LOG_KKEYSERVER_X11) << "Attaching a shared memory segment failed, falling back to reading images through the socket";
+        m_shmAddress = nullptr;
+        shmctl(m_shmId, IPC_RMID, nullptr);
+        m_shmId = -1;
+        return false;
+    }
+    m_shmSegment = xcb_generate_id(m_connection);
+    if (!attachShm(m_connection, m_shmSegment, m_shmId)) {
+        // most likely a remote display, don't try again
+        qCDebug(LOG_KKEYSERVER_X11) << "MIT-SHM attach failed, falling back to reading images through the socket";
+        shmdt(m_shmAddress);
+        m_shmAddress = nullptr;
+        shmctl(m_shmId, IPC_RMID, nullptr);
+        m_shmId = -1;
+        m_shmSegment = XCB_NONE;
+        return false;
+    }
+    m_shmImageCookie = xcb_shm_get_image(m_connection, m_pixmap, 0, 0, m_width, m_height, ~0,
+                                         XCB_IMAGE_FORMAT_Z_PIXMAP, m_shmSegment, 0);
+    m_state = WaitingForShmImage;
+    return true;
+}
+
+void PixmapReader::releaseShm()
+{
+    // the server has attached the segment once a later request got answered,
+    // so it can be marked for removal, it goes away with the last detach
+    xcb_shm_detach(m_connection, m_shmSegment);
+    shmctl(m_shmId, IPC_RMID, nullptr);
+    m_shmSegment = XCB_NONE;
+    m_shmId = -1;
+}
+#endif
+
+QImage PixmapReader::image()
+{
+#if KWINDOWSYSTEM_HAVE_XCB_SHM
+    if (m_state == WaitingForShmImage) {
+        xcb_generic_error_t *error = nullptr;
+        ScopedCPointer<xcb_shm_get_image_reply_t> reply(xcb_shm_get_image_reply(m_connection, m_shmImageCookie, &error));
+        releaseShm();
+        void *address = m_shmAddress;
+        m_shmAddress = nullptr;
+        m_state = Done;
+        if (!reply.isNull()) {
+            return imageFromData(static_cast<uchar *>(address), m_width, m_height, m_shmBytesPerLine, reply->depth,
+                                 detachShm, address);
+        }
+        // most likely a remote display, don't try again
+        qCDebug(LOG_KKEYSERVER_X11) << "MIT-SHM failed, falling back to reading images through the socket";
+        free(error);
+        shmdt(address);
+        setShmUnusable(m_connection);
+        fetchThroughSocket();
+    }
+#endif
+    if (m_state != WaitingForImage) {
+        return QImage();
+    }
+    m_state = Done;
+    ScopedCPointer<xcb_get_image_reply_t> xImage(xcb_get_image_reply(m_connection, m_imageCookie, nullptr));
+    if (xImage.isNull()) {
+        // request for image data failed
+        return QImage();
+    }
+    QImage image = imageFromData(xcb_get_image_data(xImage.data()), m_width, m_height,
+                                 xcb_get_image_data_length(xImage.data()) / m_height, xImage->depth, free, xImage.data());
+    xImage.take();
+    return image;
+}
+
+template <typename T> T fromNative(PixmapReader &reader)
+{
+    const QImage image = reader.image();
+    if (image.isNull()) {
+        return T();
+    }
     return T::fromImage(image);
 }
 
@@ -106,9 +371,20 @@ QPixmap createPixmapFromHandle(xcb_connection_t *c, WId pixmap, WId pixmap_mask)
         return QPixmap();
     }
 
-    QPixmap pix = fromNative<QPixmap>(pixmap, c);
+    // pipeline the requests for the pixmap and its mask
+    PixmapReader pixReader(c, pixmap);
+    QScopedPointer<PixmapReader> maskReader;
     if (pixmap_mask != XCB_PIXMAP_NONE) {
-        QBitmap mask = fromNative<QBitmap>(pixmap_mask, c);
+        maskReader.reset(new PixmapReader(c, pixmap_mask));
+    }
+    pixReader.fetch();
+    if (maskReader) {
+        maskReader->fetch();
+    }
+
+    QPixmap pix = fromNative<QPixmap>(pixReader);
+    if (maskReader) {
+        QBitmap mask = fromNative<QBitmap>(*maskReader);
         if (mask.size() != pix.size()) {
             return QPixmap();
         }
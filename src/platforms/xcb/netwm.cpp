@@ -2734,10 +2734,15 @@ const NETWinInfo &NETWinInfo::operator=(const NETWinInfo &wininfo)
 
 void NETWinInfo::setIcon(NETIcon icon, bool replace)
 {
-    setIconInternal(p->icons, p->icon_count, p->atom(_NET_WM_ICON), icon, replace);
+    setIconsInternal(p->icons, p->icon_count, p->atom(_NET_WM_ICON), &icon, 1, replace);
 }
 
-void NETWinInfo::setIconInternal(NETRArray<NETIcon> &icons, int &icon_count, xcb_atom_t property, NETIcon icon, bool replace)
+void NETWinInfo::setIcons(const NETIcon *icons, int count)
+{
+    setIconsInternal(p->icons, p->icon_count, p->atom(_NET_WM_ICON), icons, count, true);
+}
+
+void NETWinInfo::setIconsInternal(NETRArray<NETIcon> &icons, int &icon_count, xcb_atom_t property, const NETIcon *newIcons, int count, bool replace)
 {
     if (p->role != Client) {
         return;
@@ -2755,16 +2760,18 @@ void NETWinInfo::setIconInternal(NETRArray<NETIcon> &icons, int &icon_count, xcb
         icon_count = 0;
     }
 
-    // assign icon
-    icons[icon_count] = icon;
-    icon_count++;
+    for (int i = 0; i < count; i++) {
+        // assign icon
+        icons[icon_count] = newIcons[i];
+        icon_count++;
 
-    // do a deep copy, we want to own the data
-    NETIcon &ni = icons[icon_count - 1];
-    int sz = ni.size.width * ni.size.height;
-    uint32_t *d = new uint32_t[sz];
-    ni.data = (unsigned char *) d;
-    memcpy(d, icon.data, sz * sizeof(uint32_t));
+        // do a deep copy, we want to own the data
+        NETIcon &ni = icons[icon_count - 1];
+        int sz = ni.size.width * ni.size.height;
+        uint32_t *d = new uint32_t[sz];
+        ni.data = (unsigned char *) d;
+        memcpy(d, newIcons[i].data, sz * sizeof(uint32_t));
+    }
 
     // compute property length
     int proplen = 0;
@@ -2780,11 +2787,9 @@ void NETWinInfo::setIconInternal(NETRArray<NETIcon> &icons, int &icon_count, xcb
         *pprop++ = icons[i].size.height;
 
         // copy data into property
-        sz = (icons[i].size.width * icons[i].size.height);
-        uint32_t *d32 = (uint32_t *) icons[i].data;
-        for (int j = 0; j < sz; j++) {
-            *pprop++ = *d32++;
-        }
+        const int sz = (icons[i].size.width * icons[i].size.height);
+        memcpy(pprop, icons[i].data, sz * sizeof(uint32_t));
+        pprop += sz;
     }
 
     xcb_change_property(p->conn, XCB_PROP_MODE_REPLACE, p->window, property,
@@ -1175,6 +1175,18 @@ public:
     **/
     void setIcon(NETIcon icon, bool replace = true);
 
+    /**
+       Set all icons for the application window at once, replacing any
+       previously set icons.  Unlike calling setIcon() for each size, the
+       property is written only once.
+
+       @param icons pointer to the first of @p count icons
+       @param count the number of icons
+
+       @since 5.65
+    **/
+    void setIcons(const NETIcon *icons, int count);
+
     /**
        Set the icon geometry for the application window.
 
@@ -1676,7 +1688,7 @@ protected:
 private:
     void update(NET::Properties dirtyProperties, NET::Properties2 dirtyProperties2 = NET::Properties2());
     void updateWMState();
-    void setIconInternal(NETRArray<NETIcon> &icons, int &icon_count, xcb_atom_t property, NETIcon icon, bool replace);
+    void setIconsInternal(NETRArray<NETIcon> &icons, int &icon_count, xcb_atom_t property, const NETIcon *newIcons, int count, bool replace);
     NETIcon iconInternal(NETRArray<NETIcon> &icons, int icon_count, int width, int height) const;
 
 protected:
@@ -0,0 +1,238 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pluginindex_p.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QLibrary>
+#include <QPluginLoader>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// bump whenever the layout of the index file changes
+static const int s_indexVersion = 2;
+
+struct KnownPlugin {
+    const char *platform;
+    const char *baseName;
+};
+
+// The plugins shipped with KWindowSystem and kwayland-integration, in the
+// order a listing of the plugin directory returns them
+static const KnownPlugin s_knownPlugins[] = {
+    {"xcb", "KF5WindowSystemX11Plugin"},
+    {"wayland", "KF5WindowSystemKWaylandPlugin"},
+    {"wayland", "KF5WindowSystemWaylandPlugin"},
+};
+
+static QString pluginFileName(const char *baseName)
+{
+#if defined(Q_OS_WIN)
+    return QLatin1String(baseName) + QLatin1String(".dll");
+#else
+    // CMake uses .so for MODULE libraries on macOS as well
+    return QLatin1String(baseName) + QLatin1String(".so");
+#endif
+}
+
+static bool containsPlatform(const QJsonArray &platforms, const QString &platformName)
+{
+    for (auto it = platforms.begin(); it != platforms.end(); ++it) {
+        if (QString::compare(platformName, (*it).toString(), Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Plugins can be overwritten in place, which leaves the modification time of
+// their directory alone
+static bool pluginFilesUnchanged(const QString &directory, const QJsonArray &plugins)
+{
+    for (auto it = plugins.begin(); it != plugins.end(); ++it) {
+        const QJsonObject plugin = (*it).toObject();
+        const QFileInfo info(directory + QLatin1Char('/') + plugin.value(QStringLiteral("file")).toString());
+        if (!info.exists()
+            || double(info.lastModified().toMSecsSinceEpoch()) != plugin.value(QStringLiteral("modified")).toDouble()
+            || double(info.size()) != plugin.value(QStringLiteral("size")).toDouble()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+KWindowSystemPluginIndex::KWindowSystemPluginIndex(const QStringList &directories, const QString &indexFile)
+    : m_directories(directories)
+    , m_indexFile(indexFile)
+{
+}
+
+QStringList KWindowSystemPluginIndex::defaultDirectories()
+{
+    QStringList ret;
+    const auto paths = QCoreApplication::libraryPaths();
+    for (const QString &path : paths) {
+        QDir pluginDir(path + QLatin1String("/kf5/org.kde.kwindowsystem.platforms"));
+        if (pluginDir.exists()) {
+            ret << pluginDir.absolutePath();
+        }
+    }
+    return ret;
+}
+
+QString KWindowSystemPluginIndex::defaultIndexFile()
+{
+    if (qEnvironmentVariableIntValue("KWINDOWSYSTEM_PLUGIN_INDEX") == 0) {
+        return QString();
+    }
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    if (cacheDir.isEmpty()) {
+        return QString();
+    }
+    return cacheDir + QLatin1String("/kwindowsystem5-platformplugins.json");
+}
+
+bool KWindowSystemPluginIndex::providesPlatform(const QJsonObject &metaData, const QString &platformName)
+{
+    const QJsonArray platforms = metaData.value(QStringLiteral("MetaData")).toObject().value(QStringLiteral("platforms")).toArray();
+    return containsPlatform(platforms, platformName);
+}
+
+QStringList KWindowSystemPluginIndex::preferredCandidates(const QString &platformName) const
+{
+    QStringList ret;
+    for (const QString &directory : m_directories) {
+        for (const KnownPlugin &plugin : s_knownPlugins) {
+            if (platformName.compare(QLatin1String(plugin.platform), Qt::CaseInsensitive) != 0) {
+                continue;
+            }
+            const QString path = directory + QLatin1Char('/') + pluginFileName(plugin.baseName);
+            if (QFile::exists(path)) {
+                ret << path;
+            }
+        }
+    }
+    return ret;
+}
+
+QStringList KWindowSystemPluginIndex::candidates(const QString &platformName)
+{
+    QJsonObject index = readIndex();
+    bool changed = false;
+
+    QStringList ret;
+    for (const QString &directory : m_directories) {
+        // installing or removing a plugin changes the modification time of the directory
+        const double modified = QFileInfo(directory).lastModified().toMSecsSinceEpoch();
+        QJsonObject entry = index.value(directory).toObject();
+        if (entry.isEmpty() || entry.value(QStringLiteral("modified")).toDouble() != modified
+            || !pluginFilesUnchanged(directory, entry.value(QStringLiteral("plugins")).toArray())) {
+            entry = QJsonObject{
+                {QStringLiteral("modified"), modified},
+                {QStringLiteral("plugins"), scanDirectory(directory)}
+            };
+            index.insert(directory, entry);
+            changed = true;
+        }
+
+        const QJsonArray plugins = entry.value(QStringLiteral("plugins")).toArray();
+        for (auto it = plugins.begin(); it != plugins.end(); ++it) {
+            const QJsonObject plugin = (*it).toObject();
+            if (containsPlatform(plugin.value(QStringLiteral("platforms")).toArray(), platformName)) {
+                ret << directory + QLatin1Char('/') + plugin.value(QStringLiteral("file")).toString();
+            }
+        }
+    }
+
+    // directories which are not looked in anymore, e.g. as they are no longer
+    // in QCoreApplication::libraryPaths(), would otherwise stay forever
+    const QStringList indexed = index.keys();
+    for (const QString &directory : indexed) {
+        if (!m_directories.contains(directory)) {
+            index.remove(directory);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        writeIndex(index);
+    }
+    return ret;
+}
+
+QJsonObject KWindowSystemPluginIndex::readIndex() const
+{
+    if (m_indexFile.isEmpty()) {
+        return QJsonObject();
+    }
+    QFile file(m_indexFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    const QJsonObject index = QJsonDocument::fromJson(file.readAll()).object();
+    if (index.value(QStringLiteral("version")).toInt() != s_indexVersion) {
+        return QJsonObject();
+    }
+    return index.value(QStringLiteral("directories")).toObject();
+}
+
+void KWindowSystemPluginIndex::writeIndex(const QJsonObject &directories) const
+{
+    if (m_indexFile.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(QFileInfo(m_indexFile).absolutePath());
+    // several applications may start at the same time, never leave a partial file behind
+    QSaveFile file(m_indexFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    const QJsonObject index{
+        {QStringLiteral("version"), s_indexVersion},
+        {QStringLiteral("directories"), directories}
+    };
+    file.write(QJsonDocument(index).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
+QJsonArray KWindowSystemPluginIndex::scanDirectory(const QString &directory)
+{
+    QJsonArray plugins;
+    const QDir pluginDir(directory);
+    const auto entries = pluginDir.entryList(QDir::Files | QDir::NoDotAndDotDot);
+    for (const QString &entry : entries) {
+        const QString path = pluginDir.absoluteFilePath(entry);
+        if (!QLibrary::isLibrary(path)) {
+            continue;
+        }
+        const QFileInfo info(path);
+        QPluginLoader loader(path);
+        const QJsonArray platforms = loader.metaData().value(QStringLiteral("MetaData")).toObject().value(QStringLiteral("platforms")).toArray();
+        plugins.append(QJsonObject{
+            {QStringLiteral("file"), entry},
+            {QStringLiteral("modified"), double(info.lastModified().toMSecsSinceEpoch())},
+            {QStringLiteral("size"), double(info.size())},
+            {QStringLiteral("platforms"), platforms}
+        });
+    }
+    return plugins;
+}
@@ -0,0 +1,86 @@
+/*
+    This file is part of the KDE libraries
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLUGININDEX_P_H
+#define PLUGININDEX_P_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStringList>
+
+/**
+ * Finds the platform plugins in the "kf5/org.kde.kwindowsystem.platforms"
+ * directories without reading the metadata of every installed plugin.
+ *
+ * The metadata of all plugins in a directory is stored in an on-disk index
+ * together with the modification time of the directory and the modification
+ * time and size of every plugin, so it only has to be read again once plugins
+ * got installed, removed or replaced. The returned candidates still have to be
+ * checked with providesPlatform() before loading them.
+ */
+class KWindowSystemPluginIndex
+{
+public:
+    /**
+     * @param directories the plugin directories to look in, in order of preference
+     * @param indexFile the file to keep the index in, if empty every lookup reads
+     * the metadata of all plugins
+     */
+    KWindowSystemPluginIndex(const QStringList &directories = defaultDirectories(),
+                             const QString &indexFile = defaultIndexFile());
+
+    /**
+     * @return the platform plugin directories below QCoreApplication::libraryPaths()
+     */
+    static QStringList defaultDirectories();
+
+    /**
+     * @return the index file in the user's cache directory if the
+     * KWINDOWSYSTEM_PLUGIN_INDEX environment variable is set to 1, otherwise
+     * an empty string
+     */
+    static QString defaultIndexFile();
+
+    /**
+     * @return whether the plugin @p metaData lists @p platformName
+     */
+    static bool providesPlatform(const QJsonObject &metaData, const QString &platformName);
+
+    /**
+     * @return the existing plugins with the file name of a plugin known to
+     * support @p platformName, found without reading any metadata or the index
+     */
+    QStringList preferredCandidates(const QString &platformName) const;
+
+    /**
+     * @return all plugins supporting @p platformName according to the index,
+     * in the order a directory listing returns them. Directories which changed
+     * since the index was written, or contain changed plugins, are read again and the index is updated,
+     * directories which are not looked in anymore are removed from it.
+     */
+    QStringList candidates(const QString &platformName);
+
+private:
+    QJsonObject readIndex() const;
+    void writeIndex(const QJsonObject &directories) const;
+    static QJsonArray scanDirectory(const QString &directory);
+
+    QStringList m_directories;
+    QString m_indexFile;
+};
+
+#endif
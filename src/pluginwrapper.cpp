@@ -18,37 +18,36 @@
  * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "pluginwrapper_p.h"
+#include "pluginindex_p.h"
 #include "kwindowinfo_dummy_p.h"
 #include "kwindowsystemplugininterface_p.h"
 #include "kwindoweffects_dummy_p.h"
 #include "kwindowsystem_dummy_p.h"
 #include "kwindowsystem_debug.h"
+#include <config-kwindowsystem.h>
 
 #include <QDebug>
-#include <QDir>
 #include <QGlobalStatic>
 #include <QGuiApplication>
-#include <QJsonArray>
-#include <QLibrary>
 #include <QPluginLoader>
 
+#if KWINDOWSYSTEM_BUILTIN_X11_PLUGIN
+Q_IMPORT_PLUGIN(X11Plugin)
+#endif
+
 Q_GLOBAL_STATIC(KWindowSystemPluginWrapper, s_pluginWrapper)
 
-static QStringList pluginCandidates()
+static KWindowSystemPluginInterface *loadPluginFile(const QString &fileName, const QString &platformName)
 {
-    QStringList ret;
-    const auto paths = QCoreApplication::libraryPaths();
-    for (const QString &path : paths) {
-        QDir pluginDir(path + QLatin1String("/kf5/org.kde.kwindowsystem.platforms"));
-        if (!pluginDir.exists()) {
-            continue;
-        }
-        const auto entries = pluginDir.entryList(QDir::Files | QDir::NoDotAndDotDot);
-        for (const QString &entry : entries) {
-            ret << pluginDir.absoluteFilePath(entry);
-        }
+    QPluginLoader loader(fileName);
+    if (!KWindowSystemPluginIndex::providesPlatform(loader.metaData(), platformName)) {
+        return nullptr;
+    }
+    KWindowSystemPluginInterface *interface = qobject_cast< KWindowSystemPluginInterface* >(loader.instance());
+    if (interface) {
+        qCDebug(LOG_KWINDOWSYSTEM) << "Loaded plugin" << fileName << "for platform" << platformName;
     }
-    return ret;
+    return interface;
 }
 
 static KWindowSystemPluginInterface *loadPlugin()
@@ -61,22 +60,22 @@ static KWindowSystemPluginInterface *loadPlugin()
             platformName = flatpakPlatform;
         }
     }
-    const auto candidates = pluginCandidates();
-    for (const QString &candidate : candidates) {
-        if (!QLibrary::isLibrary(candidate)) {
-            continue;
+    if (KWindowSystemPluginInterface *interface = KWindowSystemPluginWrapper::loadStaticPlugin(platformName)) {
+        return interface;
+    }
+
+    KWindowSystemPluginIndex index;
+    // our own plugins can be found by their file name, without looking at any other plugin
+    const auto preferred = index.preferredCandidates(platformName);
+    for (const QString &candidate : preferred) {
+        if (KWindowSystemPluginInterface *interface = loadPluginFile(candidate, platformName)) {
+            return interface;
         }
-        QPluginLoader loader(candidate);
-        QJsonObject metaData = loader.metaData();
-        const QJsonArray platforms = metaData.value(QStringLiteral("MetaData")).toObject().value(QStringLiteral("platforms")).toArray();
-        for (auto it = platforms.begin(); it != platforms.end(); ++it) {
-            if (QString::compare(platformName, (*it).toString(), Qt::CaseInsensitive) == 0) {
-                KWindowSystemPluginInterface *interface = qobject_cast< KWindowSystemPluginInterface* >(loader.instance());
-                if (interface) {
-                    qCDebug(LOG_KWINDOWSYSTEM) << "Loaded plugin" << candidate << "for platform" << platformName;
-                    return interface;
-                }
-            }
+    }
+    const auto candidates = index.candidates(platformName);
+    for (const QString &candidate : candidates) {
+        if (KWindowSystemPluginInterface *interface = loadPluginFile(candidate, platformName)) {
+            return interface;
         }
     }
     qCWarning(LOG_KWINDOWSYSTEM) << "Could not find any platform plugin";
@@ -128,6 +127,26 @@ KWindowInfoPrivate *KWindowSystemPluginWrapper::createWindowInfo(WId window, NET
     return p;
 }
 
+KWindowSystemPluginInterface *KWindowSystemPluginWrapper::loadStaticPlugin(const QString &platformName)
+{
+    const auto plugins = QPluginLoader::staticPlugins();
+    for (const QStaticPlugin &plugin : plugins) {
+        const QJsonObject metaData = plugin.metaData();
+        if (metaData.value(QStringLiteral("IID")).toString() != QLatin1String(qobject_interface_iid<KWindowSystemPluginInterface *>())) {
+            continue;
+        }
+        if (!KWindowSystemPluginIndex::providesPlatform(metaData, platformName)) {
+            continue;
+        }
+        KWindowSystemPluginInterface *interface = qobject_cast< KWindowSystemPluginInterface* >(plugin.instance());
+        if (interface) {
+            qCDebug(LOG_KWINDOWSYSTEM) << "Using builtin plugin for platform" << platformName;
+            return interface;
+        }
+    }
+    return nullptr;
+}
+
 const KWindowSystemPluginWrapper &KWindowSystemPluginWrapper::self()
 {
     return *s_pluginWrapper;
@@ -25,6 +25,7 @@
 #include <QScopedPointer>
 #include <QWidgetList> //For WId
 
+class QString;
 class KWindowEffectsPrivate;
 class KWindowInfoPrivate;
 class KWindowSystemPluginInterface;
@@ -37,6 +38,12 @@ public:
     virtual ~KWindowSystemPluginWrapper();
     static const KWindowSystemPluginWrapper &self();
 
+    /**
+     * @return the plugin for @p platformName built into the library or
+     * application, or @c nullptr if there is none
+     */
+    static KWindowSystemPluginInterface *loadStaticPlugin(const QString &platformName);
+
     KWindowEffectsPrivate *effects() const;
     KWindowSystemPrivate *createWindowSystem() const;
     KWindowInfoPrivate *createWindowInfo(WId window, NET::Properties properties, NET::Properties2 properties2) const;